@@ -20,6 +20,8 @@
 #include <string>
 #include <string_view>
 
+#include "example_target.hpp"
+
 namespace asio = boost::asio;
 using boost::system::error_code;
 
@@ -42,7 +44,7 @@ asio::awaitable<error_code> handle_request_impl()
     constexpr auto tok = asio::as_tuple(asio::deferred);
 
     // Resolve the hostname and port into a set of endpoints
-    auto [ec1, endpoints] = co_await resolv.async_resolve("example.com", "80", tok);
+    auto [ec1, endpoints] = co_await resolv.async_resolve(example_host("example.com"), example_port(), tok);
     if (ec1)
         co_return ec1;
 
@@ -19,6 +19,9 @@
 #include <string>
 #include <string_view>
 
+#include "example_target.hpp"
+#include "pooled_allocator.hpp"
+
 namespace asio = boost::asio;
 
 // The GET HTTP request to send to the server
@@ -28,31 +31,6 @@ static constexpr std::string_view request =
     "User-Agent: Asio\r\n"
     "Accept: */*\r\n\r\n";
 
-// A custom allocator that logs allocation and deallocation requests
-template <class T>
-struct custom_allocator
-{
-    using value_type = T;
-
-    custom_allocator() = default;
-
-    template <class U>
-    constexpr custom_allocator(const custom_allocator<U>&) noexcept
-    {
-    }
-
-    T* allocate(std::size_t n)
-    {
-        std::cout << "Allocate " << n * sizeof(T) << " bytes\n";
-        return std::allocator<T>().allocate(n);
-    }
-    void deallocate(T* p, std::size_t n)
-    {
-        std::cout << "Deallocate " << n * sizeof(T) << "bytes\n";
-        return std::allocator<T>().deallocate(p, n);
-    }
-};
-
 asio::awaitable<void> handle_request_impl()
 {
     // Coroutines know which executor are using
@@ -62,11 +40,13 @@ asio::awaitable<void> handle_request_impl()
     asio::ip::tcp::socket sock(ex);
     asio::ip::tcp::resolver resolv(ex);
 
-    // A completion token with an associated allocator
-    auto tok = asio::bind_allocator(custom_allocator<void>(), asio::deferred);
+    // A completion token with an associated allocator. Asio uses it to allocate
+    // the state of each of the operations below. pooled_allocator recycles these
+    // allocations using per-thread free lists (see pooled_allocator.hpp)
+    auto tok = asio::bind_allocator(pooled_allocator<void>(), asio::deferred);
 
     // Resolve the hostname and port into a set of endpoints
-    auto endpoints = co_await resolv.async_resolve("example.com", "80", tok);
+    auto endpoints = co_await resolv.async_resolve(example_host("example.com"), example_port(), tok);
 
     // Connect to the server
     co_await asio::async_connect(sock, endpoints, tok);
@@ -95,4 +75,10 @@ int main()
     asio::io_context ctx;
     handle_request(ctx.get_executor());
     ctx.run();
+
+    // The allocator keeps counters instead of logging each allocation
+    const auto& stats = thread_allocation_stats();
+    std::cout << "Allocations: " << stats.allocations << ", deallocations: " << stats.deallocations
+              << ", served from the pool: " << stats.pool_hits
+              << ", heap allocations: " << stats.heap_allocations << std::endl;
 }
\ No newline at end of file
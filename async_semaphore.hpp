@@ -0,0 +1,303 @@
+#ifndef USINGSTDCPP_2024_ASYNC_SEMAPHORE_HPP
+#define USINGSTDCPP_2024_ASYNC_SEMAPHORE_HPP
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/append.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/cancellation_type.hpp>
+#include <boost/asio/compose.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+
+// Limits how many operations run at once. Calling handle_request in a loop starts every request
+// immediately, each with its own socket, buffers and coroutine frame. With an async_semaphore,
+// each request first acquires a permit, and waits without blocking the thread if there are none:
+//
+//     async_semaphore sem(ex, 100);
+//     semaphore_permit permit = co_await sem.async_acquire(asio::deferred);
+//     co_await handle_request_impl();
+//     // The permit is released when it goes out of scope, waking up the next waiter
+//
+// async_acquire works with any completion token, so composed operations can use it too.
+// Waiters are woken up in FIFO order, and a released permit goes straight to the first waiter,
+// so newcomers can't overtake coroutines that are already waiting.
+// Waits can be cancelled with per-operation cancellation (e.g. bind_cancellation_slot,
+// or a timeout with cancel_after). They complete with operation_aborted and leave the queue.
+//
+// admission_controller combines a global limit with per-host limits, like the browser rule
+// of 6 connections per host. Like connection_pool, waiters sleep on a timer that never expires,
+// which is cancelled to wake them up.
+//
+// Not thread-safe: the semaphore and its permits must be used from a single thread (or strand).
+
+class async_semaphore;
+
+// A permit acquired from a semaphore. Releases it on destruction, unless it's empty
+class semaphore_permit
+{
+    friend class async_semaphore;
+
+    async_semaphore* sem_{nullptr};
+
+    explicit semaphore_permit(async_semaphore& sem) noexcept : sem_(&sem) {}
+
+public:
+    semaphore_permit() = default;
+    semaphore_permit(semaphore_permit&& rhs) noexcept : sem_(std::exchange(rhs.sem_, nullptr)) {}
+    semaphore_permit& operator=(semaphore_permit&& rhs) noexcept
+    {
+        if (this != &rhs)
+        {
+            release();
+            sem_ = std::exchange(rhs.sem_, nullptr);
+        }
+        return *this;
+    }
+    ~semaphore_permit() { release(); }
+
+    explicit operator bool() const noexcept { return sem_ != nullptr; }
+
+    // Gives the permit back before the permit object is destroyed
+    inline void release() noexcept;
+};
+
+namespace detail {
+
+struct semaphore_waiter
+{
+    boost::asio::steady_timer timer;
+    bool queued{false};    // In the semaphore's queue
+    bool notified{false};  // The permit has been handed to us
+};
+
+}  // namespace detail
+
+class async_semaphore
+{
+    friend class semaphore_permit;
+    using waiter = detail::semaphore_waiter;
+
+    boost::asio::any_io_executor ex_;
+    std::size_t available_;
+    std::deque<waiter*> waiters_;
+
+    // Hands the permit to the first waiter, if any. Otherwise, it becomes available
+    void release_one() noexcept
+    {
+        if (waiters_.empty())
+        {
+            ++available_;
+            return;
+        }
+        waiter* w = waiters_.front();
+        waiters_.pop_front();
+        w->queued = false;
+        w->notified = true;
+        w->timer.cancel();
+    }
+
+    void remove_waiter(waiter& w) noexcept
+    {
+        if (w.queued)
+        {
+            waiters_.erase(std::find(waiters_.begin(), waiters_.end(), &w));
+            w.queued = false;
+        }
+    }
+
+    // A pending wait may be destroyed without completing, e.g. when the io_context is destroyed.
+    // Its waiter must leave the queue then, or release_one would use it after it's freed
+    struct waiter_deleter
+    {
+        async_semaphore* sem;
+
+        void operator()(waiter* w) const noexcept
+        {
+            sem->remove_waiter(*w);
+            delete w;
+        }
+    };
+
+    struct acquire_op
+    {
+        async_semaphore& sem;
+        std::unique_ptr<waiter, waiter_deleter> w{nullptr, waiter_deleter{&sem}};
+
+        template <class Self>
+        void operator()(Self& self)
+        {
+            if (sem.available_ > 0 && sem.waiters_.empty())
+            {
+                --sem.available_;
+                return boost::asio::post(
+                    sem.ex_,
+                    boost::asio::append(std::move(self), boost::system::error_code())
+                );
+            }
+
+            // Waiting has no side effects, so any kind of cancellation can interrupt it
+            self.reset_cancellation_state(boost::asio::enable_total_cancellation());
+
+            // The waiter must not move while it's in the queue, and self does
+            w.reset(new waiter{boost::asio::steady_timer(sem.ex_)});
+            w->timer.expires_at(boost::asio::steady_timer::time_point::max());
+            sem.waiters_.push_back(w.get());
+            w->queued = true;
+            w->timer.async_wait(std::move(self));
+        }
+
+        template <class Self>
+        void operator()(Self& self, boost::system::error_code)
+        {
+            // A permit that was handed to us is ours, even if we were also cancelled
+            if (w && !w->notified)
+            {
+                sem.remove_waiter(*w);
+                return self.complete(boost::asio::error::operation_aborted, semaphore_permit());
+            }
+            self.complete(boost::system::error_code(), semaphore_permit(sem));
+        }
+    };
+
+public:
+    async_semaphore(boost::asio::any_io_executor ex, std::size_t permits)
+        : ex_(std::move(ex)), available_(permits)
+    {
+    }
+
+    async_semaphore(const async_semaphore&) = delete;
+    async_semaphore& operator=(const async_semaphore&) = delete;
+
+    // Pending waits hold a pointer to the semaphore, so they must be finished by now
+    ~async_semaphore() { assert(waiters_.empty()); }
+
+    using executor_type = boost::asio::any_io_executor;
+    executor_type get_executor() const noexcept { return ex_; }
+
+    std::size_t available() const noexcept { return available_; }
+    std::size_t num_waiters() const noexcept { return waiters_.size(); }
+
+    // Returns an empty permit if there are none available, or somebody is already waiting for one
+    semaphore_permit try_acquire() noexcept
+    {
+        if (available_ == 0 || !waiters_.empty())
+            return semaphore_permit();
+        --available_;
+        return semaphore_permit(*this);
+    }
+
+    // Signature: void(error_code, semaphore_permit)
+    using acquire_signature = void(boost::system::error_code, semaphore_permit);
+
+    template <boost::asio::completion_token_for<acquire_signature> CompletionToken>
+    auto async_acquire(CompletionToken&& token)
+    {
+        return boost::asio::async_compose<CompletionToken, acquire_signature>(acquire_op{*this}, token, ex_);
+    }
+};
+
+inline void semaphore_permit::release() noexcept
+{
+    if (sem_)
+        std::exchange(sem_, nullptr)->release_one();
+}
+
+// Permission to send a request, under both the per-host and the global limit
+struct admission_ticket
+{
+    semaphore_permit host_permit;
+    semaphore_permit global_permit;
+
+    explicit operator bool() const noexcept { return static_cast<bool>(global_permit); }
+};
+
+struct admission_limits
+{
+    std::size_t max_in_flight{1000};
+    std::size_t max_in_flight_per_host{6};
+};
+
+class admission_controller
+{
+    boost::asio::any_io_executor ex_;
+    admission_limits limits_;
+    async_semaphore global_;
+
+    // Never erased, so the semaphores don't move while there are waiters or permits
+    std::unordered_map<std::string, std::unique_ptr<async_semaphore>> hosts_;
+
+    async_semaphore& host_semaphore(std::string_view host)
+    {
+        auto it = hosts_.find(std::string(host));
+        if (it == hosts_.end())
+        {
+            auto sem = std::make_unique<async_semaphore>(ex_, limits_.max_in_flight_per_host);
+            it = hosts_.emplace(std::string(host), std::move(sem)).first;
+        }
+        return *it->second;
+    }
+
+    // Waits for the host first: a coroutine waiting for a busy host shouldn't hold a global permit
+    struct admit_op
+    {
+        admission_controller& ctrl;
+        async_semaphore& host_sem;
+        semaphore_permit host_permit{};
+
+        template <class Self>
+        void operator()(Self& self)
+        {
+            host_sem.async_acquire(std::move(self));
+        }
+
+        template <class Self>
+        void operator()(Self& self, boost::system::error_code ec, semaphore_permit permit)
+        {
+            if (ec)
+                return self.complete(ec, admission_ticket{});
+            if (!host_permit)
+            {
+                host_permit = std::move(permit);
+                return ctrl.global_.async_acquire(std::move(self));
+            }
+            self.complete(ec, admission_ticket{std::move(host_permit), std::move(permit)});
+        }
+    };
+
+public:
+    admission_controller(boost::asio::any_io_executor ex, admission_limits limits = {})
+        : ex_(ex), limits_(limits), global_(std::move(ex), limits.max_in_flight)
+    {
+    }
+
+    const admission_limits& limits() const noexcept { return limits_; }
+    async_semaphore& global() noexcept { return global_; }
+
+    // Signature: void(error_code, admission_ticket). Completes when a request to host may start.
+    // If cancelled, completes with operation_aborted and an empty ticket
+    using admit_signature = void(boost::system::error_code, admission_ticket);
+
+    template <boost::asio::completion_token_for<admit_signature> CompletionToken>
+    auto async_admit(std::string_view host, CompletionToken&& token)
+    {
+        return boost::asio::async_compose<CompletionToken, admit_signature>(
+            admit_op{*this, host_semaphore(host)},
+            token,
+            ex_
+        );
+    }
+};
+
+#endif
@@ -0,0 +1,328 @@
+#include <boost/asio/as_tuple.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/address.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+
+// Compares Asio's I/O backends on the request workloads. Build with -DENABLE_IO_URING=ON and
+// run both backend_bench (epoll) and backend_bench_uring (io_uring) on the same machine:
+//
+//   - Small requests: many keep-alive connections sending small requests and reading small responses.
+//     Dominated by the cost of each read and write.
+//   - Large responses: a few connections reading big bodies, like streaming_response_reader does.
+//   - Idle connections: opens many connections that stay idle with a read pending, as a client
+//     keeping a large connection pool would, then runs the small request workload again.
+//
+// The server runs in the same process, in its own thread and io_context, so it uses the same backend.
+// Usage: backend_bench [options]
+//   --requests <n>      Small requests per run (default: 200000)
+//   --connections <n>   Connections making small requests (default: 64)
+//   --large-mb <n>      Size of each large response, in MB (default: 64)
+//   --idle <n>          Idle connections (default: 10000, limited by the open files limit)
+
+namespace asio = boost::asio;
+using boost::system::error_code;
+using asio::ip::tcp;
+using clock_type = std::chrono::steady_clock;
+
+#if defined(BOOST_ASIO_HAS_IO_URING) && defined(BOOST_ASIO_DISABLE_EPOLL)
+static constexpr std::string_view backend_name = "io_uring";
+#else
+static constexpr std::string_view backend_name = "epoll";
+#endif
+
+struct bench_config
+{
+    std::size_t requests{200000};
+    std::size_t connections{64};
+    std::size_t large_mb{64};
+    std::size_t idle{10000};
+};
+
+// Response bodies are slices of this buffer
+static const std::string& body_pattern()
+{
+    static const std::string res(64 * 1024, 'x');
+    return res;
+}
+
+//
+// Server
+//
+
+// Serves "GET /<body size> HTTP/1.1" requests over a keep-alive connection
+static asio::awaitable<void> serve_session(tcp::socket sock)
+{
+    constexpr auto tok = asio::as_tuple(asio::deferred);
+    const std::string& pattern = body_pattern();
+    sock.set_option(tcp::no_delay(true));
+    std::string buff;
+
+    while (true)
+    {
+        auto [ec, header_size] = co_await asio::async_read_until(
+            sock,
+            asio::dynamic_buffer(buff),
+            "\r\n\r\n",
+            tok
+        );
+        if (ec)
+            co_return;  // Closed by the client
+        std::size_t body_size = 0;
+        std::from_chars(buff.data() + 5, buff.data() + header_size, body_size);
+        buff.erase(0, header_size);
+
+        // The header and the first chunk of the body in a single write
+        std::string header = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body_size) + "\r\n\r\n";
+        std::size_t chunk = std::min(body_size, pattern.size());
+        std::array<asio::const_buffer, 2> first{asio::buffer(header), asio::buffer(pattern, chunk)};
+        auto [ec2, written] = co_await asio::async_write(sock, first, tok);
+        if (ec2)
+            co_return;
+        for (std::size_t remaining = body_size - chunk; remaining > 0; remaining -= chunk)
+        {
+            chunk = std::min(remaining, pattern.size());
+            auto [ec3, n] = co_await asio::async_write(sock, asio::buffer(pattern, chunk), tok);
+            if (ec3)
+                co_return;
+        }
+    }
+}
+
+static asio::awaitable<void> run_acceptor(tcp::acceptor& acceptor)
+{
+    auto ex = co_await asio::this_coro::executor;
+    while (true)
+    {
+        auto [ec, sock] = co_await acceptor.async_accept(asio::as_tuple(asio::deferred));
+        if (ec == asio::error::operation_aborted)
+            co_return;
+        if (!ec)
+            asio::co_spawn(ex, serve_session(std::move(sock)), asio::detached);
+    }
+}
+
+//
+// Client
+//
+
+// Shared by the connections of a run
+struct load_state
+{
+    std::size_t remaining_requests;
+    std::size_t body_size;
+    std::size_t running_connections{0};
+    std::function<void()> on_done;  // Called when the last connection finishes
+    std::uint64_t bytes{0};
+};
+
+// Makes requests over a single connection until there are none left
+static asio::awaitable<void> run_connection(tcp::endpoint ep, load_state& st)
+{
+    tcp::socket sock(co_await asio::this_coro::executor);
+    co_await sock.async_connect(ep, asio::deferred);
+    sock.set_option(tcp::no_delay(true));
+
+    const std::string req = "GET /" + std::to_string(st.body_size) + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    std::string buff;
+    std::vector<char> chunk(64 * 1024);
+
+    while (st.remaining_requests > 0)
+    {
+        --st.remaining_requests;
+        co_await asio::async_write(sock, asio::buffer(req), asio::deferred);
+        std::size_t header_size = co_await asio::async_read_until(
+            sock,
+            asio::dynamic_buffer(buff),
+            "\r\n\r\n",
+            asio::deferred
+        );
+
+        // Only the body follows the header, so whatever read_until read past it is body
+        std::size_t body_read = buff.size() - header_size;
+        buff.clear();
+        while (body_read < st.body_size)
+            body_read += co_await sock.async_read_some(asio::buffer(chunk), asio::deferred);
+        st.bytes += st.body_size;
+    }
+}
+
+// Starts connections making requests of body_size bytes, until all the requests are done
+static void start_load(asio::io_context& ctx, tcp::endpoint ep, std::size_t connections, load_state& st)
+{
+    st.running_connections = connections;
+    for (std::size_t i = 0; i < connections; ++i)
+    {
+        asio::co_spawn(ctx, run_connection(ep, st), [&st](std::exception_ptr exc) {
+            if (exc)
+                std::rethrow_exception(exc);
+            if (--st.running_connections == 0 && st.on_done)
+                st.on_done();
+        });
+    }
+}
+
+// Runs a load to completion, returning the elapsed time
+static std::chrono::duration<double> run_load(tcp::endpoint ep, std::size_t connections, load_state& st)
+{
+    asio::io_context ctx(1);
+    start_load(ctx, ep, connections, st);
+    auto start = clock_type::now();
+    ctx.run();
+    return clock_type::now() - start;
+}
+
+// Connects n sockets, each with a read pending, so they're registered with the backend like
+// connections waiting for data. They're closed when the small requests are done
+static std::chrono::duration<double> run_with_idle_connections(
+    tcp::endpoint ep,
+    std::size_t num_idle,
+    std::size_t connections,
+    load_state& st,
+    std::chrono::duration<double>& connect_time
+)
+{
+    asio::io_context ctx(1);
+    std::vector<tcp::socket> idle;
+    idle.reserve(num_idle);
+    char unused;
+    clock_type::time_point load_start;
+
+    asio::co_spawn(
+        ctx,
+        [&]() -> asio::awaitable<void> {
+            auto connect_start = clock_type::now();
+            for (std::size_t i = 0; i < num_idle; ++i)
+            {
+                auto& sock = idle.emplace_back(ctx);
+                co_await sock.async_connect(ep, asio::deferred);
+                sock.async_read_some(asio::buffer(&unused, 1), [](error_code, std::size_t) {});
+            }
+            connect_time = clock_type::now() - connect_start;
+
+            st.on_done = [&idle] {
+                for (auto& sock : idle)
+                    sock.close();
+            };
+            load_start = clock_type::now();
+            start_load(ctx, ep, connections, st);
+        },
+        [](std::exception_ptr exc) {
+            if (exc)
+                std::rethrow_exception(exc);
+        }
+    );
+
+    ctx.run();
+    return clock_type::now() - load_start;
+}
+
+// Each idle connection uses two descriptors, as the server is in the same process
+static std::size_t max_idle_connections(std::size_t requested)
+{
+    rlimit lim{};
+    getrlimit(RLIMIT_NOFILE, &lim);
+    lim.rlim_cur = lim.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &lim);
+    getrlimit(RLIMIT_NOFILE, &lim);
+    std::size_t reserved = 256;  // The active connections, the acceptor, io_uring...
+    std::size_t available = lim.rlim_cur > reserved ? (lim.rlim_cur - reserved) / 2 : 0;
+    return std::min(requested, available);
+}
+
+static void usage(const char* program)
+{
+    std::cerr << "Usage: " << program
+              << " [--requests <n>] [--connections <n>] [--large-mb <n>] [--idle <n>]\n";
+    std::exit(1);
+}
+
+int main(int argc, char** argv)
+{
+    bench_config cfg;
+    for (int i = 1; i < argc; i += 2)
+    {
+        if (i + 1 >= argc)
+            usage(argv[0]);
+        std::string_view opt = argv[i];
+        std::size_t value = std::stoul(argv[i + 1]);
+        if (opt == "--requests")
+            cfg.requests = value;
+        else if (opt == "--connections")
+            cfg.connections = std::max<std::size_t>(value, 1u);
+        else if (opt == "--large-mb")
+            cfg.large_mb = value;
+        else if (opt == "--idle")
+            cfg.idle = value;
+        else
+            usage(argv[0]);
+    }
+    std::size_t num_idle = max_idle_connections(cfg.idle);
+
+    // The server
+    asio::io_context server_ctx(1);
+    tcp::acceptor acceptor(server_ctx, tcp::endpoint(asio::ip::make_address("127.0.0.1"), 0));
+    acceptor.listen(asio::socket_base::max_listen_connections);
+    tcp::endpoint ep = acceptor.local_endpoint();
+    asio::co_spawn(server_ctx, run_acceptor(acceptor), asio::detached);
+    std::thread server_thread([&server_ctx] { server_ctx.run(); });
+
+    std::cout << "Backend: " << backend_name << std::endl;
+
+    // Small requests
+    {
+        load_state st{cfg.requests, 128};
+        auto elapsed = run_load(ep, cfg.connections, st);
+        std::cout << "Small requests (" << cfg.connections << " connections, 128 byte responses): "
+                  << static_cast<long>(cfg.requests / elapsed.count()) << " requests/s" << std::endl;
+    }
+
+    // Large responses
+    {
+        constexpr std::size_t num_large = 16, large_connections = 4;
+        load_state st{num_large, cfg.large_mb * 1024 * 1024};
+        auto elapsed = run_load(ep, large_connections, st);
+        std::cout << "Large responses (" << large_connections << " connections, " << num_large << " x "
+                  << cfg.large_mb << "MB): " << static_cast<long>(st.bytes / elapsed.count() / (1024 * 1024))
+                  << " MB/s" << std::endl;
+    }
+
+    // Idle connections
+    {
+        load_state st{cfg.requests, 128};
+        std::chrono::duration<double> connect_time{};
+        auto elapsed = run_with_idle_connections(ep, num_idle, cfg.connections, st, connect_time);
+        std::cout << "Idle connections: " << num_idle << " connected in "
+                  << static_cast<long>(connect_time.count() * 1000) << " ms" << std::endl;
+        std::cout << "Small requests with " << num_idle << " idle connections: "
+                  << static_cast<long>(cfg.requests / elapsed.count()) << " requests/s" << std::endl;
+    }
+
+    server_ctx.stop();
+    server_thread.join();
+}
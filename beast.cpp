@@ -16,6 +16,8 @@
 #include <exception>
 #include <iostream>
 
+#include "example_target.hpp"
+
 namespace asio = boost::asio;
 namespace beast = boost::beast;
 namespace http = beast::http;
@@ -30,7 +32,11 @@ asio::awaitable<void> handle_request_impl()
     asio::ip::tcp::resolver resolv(ex);
 
     // Resolve the hostname and port into a set of endpoints
-    auto endpoints = co_await resolv.async_resolve("python.org", "80", asio::deferred);
+    auto endpoints = co_await resolv.async_resolve(
+        example_host("python.org"),
+        example_port(),
+        asio::deferred
+    );
 
     // Connect to the server
     co_await asio::async_connect(sock, endpoints, asio::deferred);
@@ -0,0 +1,86 @@
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/beast/http/empty_body.hpp>
+#include <boost/beast/http/field.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/beast/http/write.hpp>
+
+#include <cstdint>
+#include <exception>
+#include <iostream>
+
+#include "content_coding.hpp"
+#include "example_target.hpp"
+#include "streaming_response.hpp"
+
+// The client from beast.cpp, asking for a compressed response with Accept-Encoding.
+// The body is read with a streaming_response_reader and inflated with a content_decoder as it arrives,
+// so neither the compressed nor the decoded body are ever in memory as a whole.
+// The decoded body goes to stdout, and the sizes to stderr. For example, with the local server:
+//   EXAMPLES_HOST=127.0.0.1 EXAMPLES_PORT=8080 ./beast_compressed > body.txt
+
+namespace asio = boost::asio;
+namespace beast = boost::beast;
+namespace http = beast::http;
+
+asio::awaitable<void> handle_request_impl()
+{
+    auto ex = co_await asio::this_coro::executor;
+    asio::ip::tcp::socket sock(ex);
+    asio::ip::tcp::resolver resolv(ex);
+
+    auto endpoints = co_await resolv.async_resolve(
+        example_host("python.org"),
+        example_port(),
+        asio::deferred
+    );
+    co_await asio::async_connect(sock, endpoints, asio::deferred);
+
+    // Ask for a compressed body
+    http::request<http::empty_body> req{http::verb::get, "/", 11};
+    req.set(http::field::host, "python.org");
+    req.set(http::field::user_agent, "Beast");
+    req.set(http::field::accept_encoding, accepted_content_codings);
+    co_await http::async_write(sock, req, asio::deferred);
+
+    // Read the headers, then inflate the body chunk by chunk
+    streaming_response_reader<asio::ip::tcp::socket> reader(sock);
+    co_await reader.async_read_header(asio::deferred);
+    content_decoder decoder;
+    std::uint64_t decoded_size = co_await async_read_decoded_body(
+        reader,
+        decoder,
+        [](asio::const_buffer decoded) {
+            std::cout.write(static_cast<const char*>(decoded.data()), decoded.size());
+        },
+        asio::deferred
+    );
+
+    auto encoding = reader.header()[http::field::content_encoding];
+    std::cerr << "Status " << reader.header().result_int() << ", Content-Encoding: "
+              << (encoding.empty() ? "identity" : encoding) << ", "
+              << reader.header()[http::field::content_length] << " bytes on the wire, " << decoded_size
+              << " bytes decoded" << std::endl;
+}
+
+void handle_request(asio::any_io_executor ex)
+{
+    asio::co_spawn(ex, handle_request_impl, [](std::exception_ptr exc) {
+        if (exc)
+            std::rethrow_exception(exc);
+    });
+}
+
+int main()
+{
+    asio::io_context ctx;
+    handle_request(ctx.get_executor());
+    ctx.run();
+}
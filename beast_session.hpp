@@ -0,0 +1,146 @@
+#ifndef USINGSTDCPP_2024_BEAST_SESSION_HPP
+#define USINGSTDCPP_2024_BEAST_SESSION_HPP
+
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/compose.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http/fields.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/beast/http/read.hpp>
+#include <boost/beast/http/string_body.hpp>
+#include <boost/beast/http/verb.hpp>
+#include <boost/beast/http/write.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <cassert>
+#include <cstddef>
+#include <string_view>
+
+#include "pooled_allocator.hpp"
+
+// A keep-alive HTTP client connection that reuses its memory between requests.
+// beast.cpp creates a flat_buffer, a request and a response for each request, so the buffer
+// grows from zero, and all the header fields and the body are allocated and freed every time.
+// A beast_session is created once per connection and keeps them instead:
+//
+//   - The flat_buffer keeps its capacity. Consuming data doesn't free memory.
+//   - Messages are cleared, rather than destroyed, before each request. The body strings keep their capacity.
+//   - Header fields are allocated with pooled_allocator, so fields that are freed when a message
+//     is cleared are recycled by the next request.
+//
+// Bind pooled_allocator<void> to the completion token, so the state of the write and read operations
+// is also recycled. With both, the steady state doesn't call operator new at all
+// (beast_session_check measures this):
+//
+//     beast_session<asio::ip::tcp::socket> session(sock);
+//     auto& req = session.new_request(http::verb::get, "/");
+//     req.set(http::field::host, "example.com");
+//     co_await async_request(session, asio::bind_allocator(pooled_allocator<void>(), asio::deferred));
+//     use(session.response());
+//
+// The stream must outlive the session. Not thread-safe, and one request at a time.
+
+template <class AsyncStream>
+class beast_session
+{
+public:
+    using fields_type = boost::beast::http::basic_fields<pooled_allocator<char>>;
+    using request_type = boost::beast::http::request<boost::beast::http::string_body, fields_type>;
+    using response_type = boost::beast::http::response<boost::beast::http::string_body, fields_type>;
+
+private:
+    AsyncStream& stream_;
+    boost::beast::flat_buffer buffer_;  // May hold the start of the next response between requests
+    request_type req_;
+    response_type res_;
+
+    // Removes the contents of a message, keeping its memory
+    template <class Message>
+    static void clear_message(Message& msg)
+    {
+        msg.clear();  // The header fields, which go back to the pool
+        msg.body().clear();
+    }
+
+    template <class>
+    friend struct beast_session_request_op;
+
+public:
+    explicit beast_session(AsyncStream& stream) : stream_(stream) {}
+
+    beast_session(const beast_session&) = delete;
+    beast_session& operator=(const beast_session&) = delete;
+
+    AsyncStream& stream() noexcept { return stream_; }
+
+    // Clears the previous request and returns it, ready to be filled in
+    request_type& new_request(boost::beast::http::verb method, std::string_view target)
+    {
+        clear_message(req_);
+        req_.method(method);
+        req_.target(target);
+        req_.version(11);
+        return req_;
+    }
+
+    request_type& request() noexcept { return req_; }
+
+    // The response to the last request. Valid until the next request starts
+    const response_type& response() const noexcept { return res_; }
+};
+
+template <class AsyncStream>
+struct beast_session_request_op
+{
+    beast_session<AsyncStream>& session;
+
+    enum class state_t
+    {
+        initial,
+        writing,
+        reading,
+    } state{state_t::initial};
+
+    template <class Self>
+    void operator()(Self& self)
+    {
+        assert(state == state_t::initial);
+        state = state_t::writing;
+        session.req_.prepare_payload();
+        boost::beast::http::async_write(session.stream_, session.req_, std::move(self));
+    }
+
+    template <class Self>
+    void operator()(Self& self, boost::system::error_code ec, std::size_t)
+    {
+        if (ec)
+            return self.complete(ec);
+
+        if (state == state_t::writing)
+        {
+            state = state_t::reading;
+            beast_session<AsyncStream>::clear_message(session.res_);
+            boost::beast::http::async_read(session.stream_, session.buffer_, session.res_, std::move(self));
+        }
+        else
+        {
+            assert(state == state_t::reading);
+            self.complete(ec);
+        }
+    }
+};
+
+// Writes session.request() and reads the response into session.response()
+template <
+    class AsyncStream,
+    boost::asio::completion_token_for<void(boost::system::error_code)> CompletionToken>
+auto async_request(beast_session<AsyncStream>& session, CompletionToken&& token)
+{
+    return boost::asio::async_compose<CompletionToken, void(boost::system::error_code)>(
+        beast_session_request_op<AsyncStream>{session},
+        token,
+        session.stream()
+    );
+}
+
+#endif
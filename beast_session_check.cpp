@@ -0,0 +1,174 @@
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/bind_allocator.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/beast/http/read.hpp>
+#include <boost/beast/http/string_body.hpp>
+#include <boost/beast/http/write.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include "beast_session.hpp"
+#include "pooled_allocator.hpp"
+
+// Checks that a beast_session doesn't allocate in the steady state.
+// A client sends requests over a keep-alive connection to a server running in another thread,
+// and counts the calls to operator new made by the client thread after a warm-up period.
+// For comparison, it does the same creating a fresh buffer and messages per request, like beast.cpp.
+//
+// Exits with a non-zero status if beast_session allocates.
+// Usage: beast_session_check [requests]
+
+namespace asio = boost::asio;
+namespace beast = boost::beast;
+namespace http = beast::http;
+using boost::system::error_code;
+using asio::ip::tcp;
+
+// Per thread, so the server thread's allocations don't count
+static thread_local std::uint64_t thread_allocations = 0;
+
+void* operator new(std::size_t size)
+{
+    ++thread_allocations;
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+static constexpr std::size_t warmup_requests = 100;
+
+// Answers every request on a single connection with the same response
+static void serve(tcp::acceptor& acceptor)
+{
+    const std::string response = "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nServer: check\r\n"
+                                 "Content-Length: 1024\r\n\r\n" +
+                                 std::string(1024, 'x');
+    tcp::socket sock = acceptor.accept();
+    std::string buff;
+    error_code ec;
+    while (true)
+    {
+        std::size_t n = asio::read_until(sock, asio::dynamic_buffer(buff), "\r\n\r\n", ec);
+        if (ec)
+            return;  // The client closed the connection
+        buff.erase(0, n);
+        asio::write(sock, asio::buffer(response), ec);
+        if (ec)
+            return;
+    }
+}
+
+static void check_response(http::status status, std::size_t body_size)
+{
+    if (status != http::status::ok || body_size != 1024)
+        throw std::runtime_error("Unexpected response");
+}
+
+static asio::awaitable<std::uint64_t> run_session(tcp::endpoint ep, std::size_t num_requests)
+{
+    tcp::socket sock(co_await asio::this_coro::executor);
+    co_await sock.async_connect(ep, asio::deferred);
+    beast_session<tcp::socket> session(sock);
+    auto tok = asio::bind_allocator(pooled_allocator<void>(), asio::deferred);
+
+    std::uint64_t allocs_before = 0;
+    for (std::size_t i = 0; i < warmup_requests + num_requests; ++i)
+    {
+        if (i == warmup_requests)
+            allocs_before = thread_allocations;
+        auto& req = session.new_request(http::verb::get, "/");
+        req.set(http::field::host, "127.0.0.1");
+        req.set(http::field::user_agent, "Beast");
+        co_await async_request(session, tok);
+        check_response(session.response().result(), session.response().body().size());
+    }
+    co_return thread_allocations - allocs_before;
+}
+
+static asio::awaitable<std::uint64_t> run_fresh_messages(tcp::endpoint ep, std::size_t num_requests)
+{
+    tcp::socket sock(co_await asio::this_coro::executor);
+    co_await sock.async_connect(ep, asio::deferred);
+
+    std::uint64_t allocs_before = 0;
+    for (std::size_t i = 0; i < warmup_requests + num_requests; ++i)
+    {
+        if (i == warmup_requests)
+            allocs_before = thread_allocations;
+        http::request<http::string_body> req{http::verb::get, "/", 11};
+        req.set(http::field::host, "127.0.0.1");
+        req.set(http::field::user_agent, "Beast");
+        co_await http::async_write(sock, req, asio::deferred);
+
+        beast::flat_buffer buff;
+        http::response<http::string_body> res;
+        co_await http::async_read(sock, buff, res, asio::deferred);
+        check_response(res.result(), res.body().size());
+    }
+    co_return thread_allocations - allocs_before;
+}
+
+// Returns the number of allocations per request
+template <class Client>
+static double run(std::string_view name, std::size_t num_requests, Client client)
+{
+    asio::io_context ctx;
+    tcp::acceptor acceptor(ctx, tcp::endpoint(asio::ip::make_address("127.0.0.1"), 0));
+    std::thread server([&acceptor] { serve(acceptor); });
+
+    std::uint64_t allocs = 0;
+    asio::co_spawn(
+        ctx,
+        client(acceptor.local_endpoint(), num_requests),
+        [&allocs](std::exception_ptr exc, std::uint64_t res) {
+            if (exc)
+                std::rethrow_exception(exc);
+            allocs = res;
+        }
+    );
+    ctx.run();
+    server.join();
+
+    double res = static_cast<double>(allocs) / num_requests;
+    std::cout << name << ": " << allocs << " allocations in " << num_requests << " requests (" << res
+              << " per request)" << std::endl;
+    return res;
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t num_requests = argc > 1 ? std::stoul(argv[1]) : 10000;
+
+    run("fresh buffer and messages per request", num_requests, run_fresh_messages);
+    double allocs_per_request = run("beast_session", num_requests, run_session);
+
+    if (allocs_per_request != 0.0)
+    {
+        std::cout << "FAILED: beast_session allocated in the steady state" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::cout << "OK: beast_session didn't allocate in the steady state" << std::endl;
+}
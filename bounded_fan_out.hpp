@@ -0,0 +1,122 @@
+#ifndef USINGSTDCPP_2024_BOUNDED_FAN_OUT_HPP
+#define USINGSTDCPP_2024_BOUNDED_FAN_OUT_HPP
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/this_coro.hpp>
+
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "async_semaphore.hpp"
+
+// Runs n coroutines with at most max_in_flight of them at once, and collects their results.
+// It's the bounded version of calling handle_request in a loop:
+//
+//     auto results = co_await bounded_fan_out(urls.size(), 100, [&](std::size_t i) {
+//         return fetch(urls[i]);  // Returns asio::awaitable<T>
+//     });
+//
+// The i-th coroutine is only created once a permit is available, so at most max_in_flight
+// coroutine frames, sockets and buffers exist at any time. results[i] holds the result of make_task(i),
+// or the exception it threw. Coroutines start in index order, and may complete in any order.
+// Completes when all of them have finished. T must be default constructible, as for co_spawn.
+// Coroutines returning asio::awaitable<void>, like handle_request_impl, are supported too:
+// their results only hold the exception.
+
+template <class T>
+struct fan_out_result
+{
+    std::exception_ptr error;
+    T value{};
+};
+
+template <>
+struct fan_out_result<void>
+{
+    std::exception_ptr error;
+};
+
+namespace detail {
+
+// The T in the asio::awaitable<T> returned by MakeTask
+template <class MakeTask>
+using fan_out_value_t = typename std::invoke_result_t<MakeTask&, std::size_t>::value_type;
+
+// Coroutines that are still running if bounded_fan_out is cancelled outlive its frame
+template <class T>
+struct fan_out_state
+{
+    async_semaphore sem;
+    std::vector<fan_out_result<T>> results;
+
+    fan_out_state(boost::asio::any_io_executor ex, std::size_t max_in_flight, std::size_t n)
+        : sem(std::move(ex), max_in_flight), results(n)
+    {
+    }
+};
+
+// Stores the result of a coroutine and releases its permit. The permit is declared last,
+// so it's released before the state is destroyed, even if the handler never runs
+template <class T>
+struct fan_out_handler
+{
+    std::shared_ptr<fan_out_state<T>> st;
+    std::size_t index;
+    semaphore_permit permit;
+
+    void operator()(std::exception_ptr exc, T value)
+    {
+        st->results[index] = {std::move(exc), std::move(value)};
+        permit.release();
+    }
+};
+
+template <>
+struct fan_out_handler<void>
+{
+    std::shared_ptr<fan_out_state<void>> st;
+    std::size_t index;
+    semaphore_permit permit;
+
+    void operator()(std::exception_ptr exc)
+    {
+        st->results[index] = {std::move(exc)};
+        permit.release();
+    }
+};
+
+}  // namespace detail
+
+template <class MakeTask>
+auto bounded_fan_out(std::size_t n, std::size_t max_in_flight, MakeTask make_task)
+    -> boost::asio::awaitable<std::vector<fan_out_result<detail::fan_out_value_t<MakeTask>>>>
+{
+    using value_type = detail::fan_out_value_t<MakeTask>;
+
+    auto ex = co_await boost::asio::this_coro::executor;
+    max_in_flight = max_in_flight ? max_in_flight : 1;
+    auto st = std::make_shared<detail::fan_out_state<value_type>>(ex, max_in_flight, n);
+
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        semaphore_permit permit = co_await st->sem.async_acquire(boost::asio::deferred);
+        detail::fan_out_handler<value_type> handler{st, i, std::move(permit)};
+        boost::asio::co_spawn(ex, make_task(i), std::move(handler));
+    }
+
+    // Once we hold all the permits, every coroutine has finished
+    std::vector<semaphore_permit> all;
+    all.reserve(max_in_flight);
+    for (std::size_t i = 0; i < max_in_flight; ++i)
+        all.push_back(co_await st->sem.async_acquire(boost::asio::deferred));
+    co_return std::move(st->results);
+}
+
+#endif
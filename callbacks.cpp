@@ -15,6 +15,8 @@
 #include <string>
 #include <string_view>
 
+#include "example_target.hpp"
+
 namespace asio = boost::asio;
 using boost::system::error_code;
 
@@ -40,12 +42,16 @@ public:
     // Start the async chain. We capture this as a shared_ptr to ensure correct lifetimes
     void start_resolve()
     {
-        resolv.async_resolve("example.com", "80", [self = shared_from_this()](error_code ec, auto endpoints) {
-            if (ec)
-                std::cerr << "Error resolving endpoints: " << ec.message() << std::endl;
-            else
-                self->start_connect(std::move(endpoints));
-        });
+        resolv.async_resolve(
+            example_host("example.com"),
+            example_port(),
+            [self = shared_from_this()](error_code ec, auto endpoints) {
+                if (ec)
+                    std::cerr << "Error resolving endpoints: " << ec.message() << std::endl;
+                else
+                    self->start_connect(std::move(endpoints));
+            }
+        );
     }
 
     void start_connect(const asio::ip::tcp::resolver::results_type& endpoints)
@@ -0,0 +1,124 @@
+#ifndef USINGSTDCPP_2024_CANCELLATION_GROUP_HPP
+#define USINGSTDCPP_2024_CANCELLATION_GROUP_HPP
+
+#include <boost/asio/cancellation_signal.hpp>
+#include <boost/asio/cancellation_type.hpp>
+
+#include <cstddef>
+
+// Cancels whole cohorts of operations at once, e.g. every request for a tenant
+// or every request to a failing upstream.
+// cancellation_composed.cpp binds one cancellation_signal to one co_spawn. Here, each operation
+// gets a cancellation_group::member, which contains the signal and is linked into the group
+// when constructed. Binding the member's slot works like binding a signal's slot:
+//
+//     cancellation_group::member m(group);
+//     asio::co_spawn(ex, handle_request(), asio::bind_cancellation_slot(m.slot(), handler));
+//     ...
+//     group.emit(asio::cancellation_type::terminal);  // Cancels all the members' operations
+//
+// Members are intrusive: the group doesn't allocate, and they're kept wherever the caller
+// already keeps per-request state. Joining and leaving the group are O(1), and emit() is O(members).
+// A member must outlive the operations bound to its slot, and unlinks itself when destroyed.
+// Members may be destroyed while emit() runs (e.g. because an operation completed inline).
+//
+// Not thread-safe: the group and its members must be used from a single thread (or strand).
+
+class cancellation_group
+{
+public:
+    class member
+    {
+        friend class cancellation_group;
+
+        cancellation_group* group_;
+        member* prev_{nullptr};
+        member* next_{nullptr};
+        boost::asio::cancellation_signal sig_;
+
+    public:
+        explicit member(cancellation_group& group) : group_(&group) { group.link(*this); }
+        member(const member&) = delete;
+        member& operator=(const member&) = delete;
+        ~member() { leave(); }
+
+        // Bind this to the operation's completion token with asio::bind_cancellation_slot
+        boost::asio::cancellation_slot slot() noexcept { return sig_.slot(); }
+
+        // Cancels only this member's operation
+        void emit(boost::asio::cancellation_type type) { sig_.emit(type); }
+
+        // Stops receiving the group's cancellations. Called by the destructor
+        void leave() noexcept
+        {
+            if (group_)
+            {
+                group_->unlink(*this);
+                group_ = nullptr;
+            }
+        }
+    };
+
+private:
+    member* head_{nullptr};
+    member* tail_{nullptr};
+    member* next_to_emit_{nullptr};  // Kept valid while emit() runs, if members leave the group
+    std::size_t size_{0};
+
+    void link(member& m) noexcept
+    {
+        m.prev_ = tail_;
+        m.next_ = nullptr;
+        if (tail_)
+            tail_->next_ = &m;
+        else
+            head_ = &m;
+        tail_ = &m;
+        ++size_;
+    }
+
+    void unlink(member& m) noexcept
+    {
+        if (next_to_emit_ == &m)
+            next_to_emit_ = m.next_;
+        if (m.prev_)
+            m.prev_->next_ = m.next_;
+        else
+            head_ = m.next_;
+        if (m.next_)
+            m.next_->prev_ = m.prev_;
+        else
+            tail_ = m.prev_;
+        m.prev_ = m.next_ = nullptr;
+        --size_;
+    }
+
+public:
+    cancellation_group() = default;
+    cancellation_group(const cancellation_group&) = delete;
+    cancellation_group& operator=(const cancellation_group&) = delete;
+
+    // Members can't outlive the group
+    ~cancellation_group()
+    {
+        while (head_)
+            head_->leave();
+    }
+
+    std::size_t size() const noexcept { return size_; }
+
+    // Delivers type (terminal, partial or total) to the operations of all members.
+    // Members that join while this runs are also cancelled
+    void emit(boost::asio::cancellation_type type)
+    {
+        next_to_emit_ = head_;
+        while (next_to_emit_)
+        {
+            member& m = *next_to_emit_;
+            next_to_emit_ = m.next_;
+            m.sig_.emit(type);
+        }
+    }
+};
+
+#endif
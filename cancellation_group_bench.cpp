@@ -0,0 +1,151 @@
+
+#include <boost/asio/as_tuple.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/bind_cancellation_slot.hpp>
+#include <boost/asio/cancellation_signal.hpp>
+#include <boost/asio/cancellation_type.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/this_coro.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "cancellation_group.hpp"
+
+// Measures the time to cancel N pending requests (100k by default): a cancellation_group
+// against keeping a heap-allocated cancellation_signal per request.
+// Each request is a coroutine waiting on a timer that would expire in an hour, bound to
+// the member's (or signal's) slot. We measure the time to emit the cancellation, and the time
+// until all the coroutines have finished.
+// Usage: cancellation_group_bench [requests]
+
+namespace asio = boost::asio;
+using clock_type = std::chrono::steady_clock;
+
+// Count every call to the global operator new
+static std::atomic<std::uint64_t> num_global_allocations{0};
+
+void* operator new(std::size_t size)
+{
+    num_global_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+static asio::awaitable<void> pending_request(std::size_t& finished)
+{
+    asio::steady_timer timer(co_await asio::this_coro::executor, std::chrono::hours(1));
+    co_await timer.async_wait(asio::as_tuple(asio::deferred));
+    ++finished;
+}
+
+static void print_results(
+    std::string_view name,
+    std::size_t n,
+    std::uint64_t setup_allocations,
+    clock_type::duration emit,
+    clock_type::duration drain
+)
+{
+    using ms = std::chrono::duration<double, std::milli>;
+    using ns = std::chrono::duration<double, std::nano>;
+    std::cout << name << ":\n  allocations to set up cancellation: " << setup_allocations
+              << "\n  emit: " << ms(emit).count() << "ms (" << ns(emit).count() / n
+              << " ns/request)\n  until all requests finished: " << ms(emit + drain).count() << "ms"
+              << std::endl;
+}
+
+// Spawns the requests with the given slots, and lets them start waiting
+template <class GetSlot>
+static void spawn_requests(asio::io_context& ctx, std::size_t n, std::size_t& finished, GetSlot get_slot)
+{
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        asio::co_spawn(
+            ctx,
+            pending_request(finished),
+            asio::bind_cancellation_slot(get_slot(i), [](std::exception_ptr exc) {
+                if (exc)
+                    std::rethrow_exception(exc);
+            })
+        );
+    }
+    ctx.poll();
+}
+
+static void bench_group(std::size_t n)
+{
+    asio::io_context ctx;
+    std::size_t finished = 0;
+    cancellation_group group;
+
+    // A deque doesn't move its elements, and allocates them in blocks
+    auto allocs_before = num_global_allocations.load();
+    std::deque<cancellation_group::member> members;
+    for (std::size_t i = 0; i < n; ++i)
+        members.emplace_back(group);
+    auto setup_allocations = num_global_allocations.load() - allocs_before;
+
+    spawn_requests(ctx, n, finished, [&members](std::size_t i) { return members[i].slot(); });
+
+    auto start = clock_type::now();
+    group.emit(asio::cancellation_type::terminal);
+    auto emit = clock_type::now() - start;
+    ctx.run();
+    auto drain = clock_type::now() - start - emit;
+
+    if (finished != n)
+        std::cerr << "cancellation_group: only " << finished << " requests finished\n";
+    print_results("cancellation_group", n, setup_allocations, emit, drain);
+}
+
+static void bench_signal_per_request(std::size_t n)
+{
+    asio::io_context ctx;
+    std::size_t finished = 0;
+
+    auto allocs_before = num_global_allocations.load();
+    std::vector<std::unique_ptr<asio::cancellation_signal>> signals;
+    signals.reserve(n);
+    for (std::size_t i = 0; i < n; ++i)
+        signals.push_back(std::make_unique<asio::cancellation_signal>());
+    auto setup_allocations = num_global_allocations.load() - allocs_before;
+
+    spawn_requests(ctx, n, finished, [&signals](std::size_t i) { return signals[i]->slot(); });
+
+    auto start = clock_type::now();
+    for (auto& sig : signals)
+        sig->emit(asio::cancellation_type::terminal);
+    auto emit = clock_type::now() - start;
+    ctx.run();
+    auto drain = clock_type::now() - start - emit;
+
+    if (finished != n)
+        std::cerr << "signal per request: only " << finished << " requests finished\n";
+    print_results("signal per request", n, setup_allocations, emit, drain);
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t n = argc > 1 ? std::stoul(argv[1]) : 100000;
+    bench_signal_per_request(n);
+    bench_group(n);
+}
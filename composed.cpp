@@ -14,10 +14,14 @@
 #include <boost/system/error_code.hpp>
 
 #include <cstddef>
+#include <fstream>
 #include <iostream>
 #include <string>
 #include <string_view>
 
+#include "example_target.hpp"
+#include "request_tracing.hpp"
+
 namespace asio = boost::asio;
 using boost::system::error_code;
 
@@ -37,6 +41,9 @@ struct handle_request_op
     std::string_view req;
     std::string& buff;
 
+    // Timestamps each state transition. Empty unless tracing is enabled
+    [[no_unique_address]] request_trace trace;
+
     enum class state_t
     {
         initial,
@@ -52,7 +59,8 @@ struct handle_request_op
     {
         assert(state == state_t::initial);
         state = state_t::resolving;
-        resolv.async_resolve("example.com", "80", std::move(self));
+        trace.enter(request_stage::resolve);
+        resolv.async_resolve(example_host("example.com"), example_port(), std::move(self));
     }
 
     // Called when async_resolve completes
@@ -63,6 +71,7 @@ struct handle_request_op
             return self.complete(ec, 0u);
         assert(state == state_t::resolving);
         state = state_t::connecting;
+        trace.enter(request_stage::connect);
         asio::async_connect(sock, endpoints, std::move(self));
     }
 
@@ -74,6 +83,7 @@ struct handle_request_op
             return self.complete(ec, 0u);
         assert(state == state_t::connecting);
         state = state_t::writing;
+        trace.enter(request_stage::write);
         asio::async_write(sock, asio::buffer(request), std::move(self));
     }
 
@@ -87,11 +97,13 @@ struct handle_request_op
         if (state == state_t::writing)
         {
             state = state_t::reading;
+            trace.enter(request_stage::read);
             asio::async_read_until(sock, asio::dynamic_buffer(buff), "\r\n\r\n", std::move(self));
         }
         else
         {
             assert(state == state_t::reading);
+            trace.enter(request_stage::done);
             self.complete(error_code(), bytes_transferred);
         }
     }
@@ -144,4 +156,13 @@ int main()
     asio::io_context ctx;
     handle_request(ctx.get_executor());
     ctx.run();
+
+    // With -DENABLE_REQUEST_TRACING=ON, export the time spent in each stage.
+    // The JSON file can be opened in chrome://tracing or https://ui.perfetto.dev
+    if constexpr (request_tracing_enabled)
+    {
+        write_stage_histograms(std::cout);
+        std::ofstream trace_file("composed_trace.json");
+        write_chrome_trace(trace_file);
+    }
 }
\ No newline at end of file
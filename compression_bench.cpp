@@ -0,0 +1,216 @@
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/beast/http/empty_body.hpp>
+#include <boost/beast/http/field.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/beast/http/write.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "content_coding.hpp"
+#include "latency_histogram.hpp"
+#include "streaming_response.hpp"
+
+// Bytes on the wire and latency of responses with and without compression.
+// For each body size, sends requests over a keep-alive connection to the local server in server.cpp,
+// which must be running, without Accept-Encoding, and asking for gzip and for deflate.
+// Bodies are read with streaming_response_reader and decoded with a single content_decoder per connection.
+//
+// Loopback is much faster than any real network, so the latency measured here is mostly
+// the cost of compressing (once per size, cached by the server) and decoding. The estimate adds
+// the time it takes to transfer the bytes on the wire over a link of --link-mbps.
+// Usage: compression_bench [options]
+//   --host <host>          Server to connect to (default: 127.0.0.1)
+//   --port <port>          Port to connect to (default: 8080)
+//   --requests <n>         Requests per body size and coding (default: 200)
+//   --sizes <a,b,...>      Body sizes, in bytes (default: 1024,16384,262144,4194304)
+//   --link-mbps <n>        Bandwidth for the estimated latency, in Mbit/s (default: 100)
+
+namespace asio = boost::asio;
+namespace http = boost::beast::http;
+using boost::system::error_code;
+using asio::ip::tcp;
+
+struct bench_config
+{
+    std::string host{"127.0.0.1"};
+    std::string port{"8080"};
+    std::size_t requests{200};
+    std::vector<std::size_t> sizes{1024, 16 * 1024, 256 * 1024, 4 * 1024 * 1024};
+    double link_mbps{100};
+};
+
+// Forwards to a socket, counting the bytes read: the bytes on the wire, including the headers
+class counting_socket
+{
+    tcp::socket sock_;
+
+public:
+    using executor_type = tcp::socket::executor_type;
+    using lowest_layer_type = tcp::socket::lowest_layer_type;
+
+    std::uint64_t bytes_read{0};
+
+    explicit counting_socket(executor_type ex) : sock_(std::move(ex)) {}
+
+    executor_type get_executor() { return sock_.get_executor(); }
+    lowest_layer_type& lowest_layer() { return sock_.lowest_layer(); }
+    tcp::socket& socket() { return sock_; }
+
+    template <class MutableBufferSequence, class CompletionToken>
+    auto async_read_some(const MutableBufferSequence& buffers, CompletionToken&& token)
+    {
+        return sock_.async_read_some(buffers, asio::deferred([this](error_code ec, std::size_t n) {
+                   bytes_read += n;
+                   return asio::deferred.values(ec, n);
+               }))(std::forward<CompletionToken>(token));
+    }
+
+    template <class ConstBufferSequence, class CompletionToken>
+    auto async_write_some(const ConstBufferSequence& buffers, CompletionToken&& token)
+    {
+        return sock_.async_write_some(buffers, std::forward<CompletionToken>(token));
+    }
+};
+
+static std::string_view coding_name(content_coding coding)
+{
+    switch (coding)
+    {
+    case content_coding::gzip: return "gzip";
+    case content_coding::deflate: return "deflate";
+    default: return "identity";
+    }
+}
+
+static asio::awaitable<void> run_requests(
+    const bench_config& cfg,
+    std::size_t body_size,
+    content_coding coding,
+    tcp::resolver::results_type endpoints
+)
+{
+    counting_socket sock(co_await asio::this_coro::executor);
+    co_await asio::async_connect(sock.socket(), endpoints, asio::deferred);
+
+    http::request<http::empty_body> req{http::verb::get, "/?size=" + std::to_string(body_size), 11};
+    req.set(http::field::host, cfg.host);
+    if (coding != content_coding::identity)
+        req.set(http::field::accept_encoding, coding_name(coding));
+
+    content_decoder decoder;
+    latency_histogram hist;
+    std::uint64_t wire_bytes = 0;
+
+    // The first request is a warm-up, so the server compresses the body before we measure
+    for (std::size_t i = 0; i <= cfg.requests; ++i)
+    {
+        auto start = std::chrono::steady_clock::now();
+        std::uint64_t read_before = sock.bytes_read;
+        co_await http::async_write(sock, req, asio::deferred);
+
+        // Responses are not pipelined, so a reader never reads past the end of its response
+        streaming_response_reader<counting_socket> reader(sock);
+        co_await reader.async_read_header(asio::deferred);
+        std::uint64_t decoded = co_await async_read_decoded_body(
+            reader,
+            decoder,
+            [](asio::const_buffer) {},
+            asio::deferred
+        );
+        if (decoded != body_size || decoder.coding() != coding)
+            throw std::runtime_error("Unexpected response from the server");
+
+        if (i > 0)
+        {
+            hist.record(std::chrono::steady_clock::now() - start);
+            wire_bytes += sock.bytes_read - read_before;
+        }
+    }
+
+    double bytes_per_request = static_cast<double>(wire_bytes) / cfg.requests;
+    std::chrono::duration<double, std::micro> transfer(bytes_per_request * 8 / cfg.link_mbps);
+    auto mean = std::chrono::duration<double, std::micro>(hist.mean());
+    std::cout << "  " << coding_name(coding) << ": " << static_cast<std::uint64_t>(bytes_per_request)
+              << " bytes on the wire (" << 100.0 * bytes_per_request / body_size << "% of the body), "
+              << "estimated latency " << static_cast<std::uint64_t>((mean + transfer).count()) << "us at "
+              << cfg.link_mbps << "Mbit/s\n"
+              << "    loopback latency: " << hist << std::endl;
+}
+
+static std::vector<std::size_t> parse_sizes(std::string_view value)
+{
+    std::vector<std::size_t> res;
+    while (!value.empty())
+    {
+        std::string_view item = value.substr(0, value.find(','));
+        value.remove_prefix(std::min(item.size() + 1, value.size()));
+        res.push_back(std::stoul(std::string(item)));
+    }
+    return res;
+}
+
+static void usage(const char* program)
+{
+    std::cerr << "Usage: " << program
+              << " [--host <host>] [--port <port>] [--requests <n>] [--sizes <a,b,...>] [--link-mbps <n>]\n";
+    std::exit(1);
+}
+
+int main(int argc, char** argv)
+{
+    bench_config cfg;
+    for (int i = 1; i < argc; i += 2)
+    {
+        if (i + 1 >= argc)
+            usage(argv[0]);
+        std::string_view opt = argv[i];
+        const char* value = argv[i + 1];
+        if (opt == "--host")
+            cfg.host = value;
+        else if (opt == "--port")
+            cfg.port = value;
+        else if (opt == "--requests")
+            cfg.requests = std::max<std::size_t>(std::stoul(value), 1u);
+        else if (opt == "--sizes")
+            cfg.sizes = parse_sizes(value);
+        else if (opt == "--link-mbps")
+            cfg.link_mbps = std::stod(value);
+        else
+            usage(argv[0]);
+    }
+
+    asio::io_context ctx;
+    auto endpoints = tcp::resolver(ctx).resolve(cfg.host, cfg.port);
+    for (std::size_t size : cfg.sizes)
+    {
+        std::cout << "Body size " << size << ":\n";
+        for (auto coding : {content_coding::identity, content_coding::gzip, content_coding::deflate})
+        {
+            asio::co_spawn(ctx, run_requests(cfg, size, coding, endpoints), [](std::exception_ptr exc) {
+                if (exc)
+                    std::rethrow_exception(exc);
+            });
+            ctx.run();
+            ctx.restart();
+        }
+    }
+}
@@ -0,0 +1,346 @@
+#ifndef USINGSTDCPP_2024_CONNECTION_POOL_HPP
+#define USINGSTDCPP_2024_CONNECTION_POOL_HPP
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/as_tuple.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/socket_base.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/system/error_code.hpp>
+#include <boost/system/system_error.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+
+// An async pool of HTTP/1.1 keep-alive connections, keyed by host:port.
+// Instead of resolving and connecting for every request, coroutines ask the pool
+// for a connection, use it, and hand it back so the next request can skip the handshake.
+//
+// The pool is not thread-safe: all its functions must be called from the same thread
+// (or strand) as the executor it was constructed with.
+
+struct connection_pool_params
+{
+    // Maximum number of connections (idle + in use) open to a single host:port.
+    // Coroutines requesting a connection when the limit is reached wait until one is returned.
+    std::size_t max_connections_per_host{16};
+
+    // Idle connections older than this are closed, since servers tend to close them anyway
+    std::chrono::steady_clock::duration idle_timeout{std::chrono::seconds(30)};
+};
+
+namespace detail {
+
+// A coroutine waiting for a connection to a host that reached its limit.
+// We use a timer that never expires as a condition variable: cancelling it wakes the waiter up.
+// Waiters are served in order: a returned connection, or the slot of a closed one,
+// is handed to the first waiter directly, so callers arriving later can't take it first.
+struct pool_waiter
+{
+    boost::asio::steady_timer timer;
+    bool notified{false};
+    std::optional<boost::asio::ip::tcp::socket> sock;  // Unset if we were handed a slot to connect
+};
+
+struct pool_idle_connection
+{
+    boost::asio::ip::tcp::socket sock;
+    std::chrono::steady_clock::time_point idle_since;
+};
+
+// Per host:port state
+struct pool_host_entry
+{
+    std::string host;
+    std::string port;
+    std::deque<pool_idle_connection> idle;
+    std::deque<pool_waiter*> waiters;
+    std::size_t num_open{0};  // idle + in use + being connected
+};
+
+}  // namespace detail
+
+class connection_pool;
+
+// A connection checked out from the pool. Returns the connection on destruction.
+// The connection is only put back to the idle list if set_reusable() was called, which
+// signals that the previous response was read completely and the server didn't ask to close.
+// Otherwise, the socket is closed. Like the pool, this must be used from the pool's thread.
+class pooled_connection
+{
+    friend class connection_pool;
+
+    connection_pool* pool_{};
+    detail::pool_host_entry* entry_{};
+    std::optional<boost::asio::ip::tcp::socket> sock_;
+    bool reusable_{false};
+
+    pooled_connection(
+        connection_pool& pool,
+        detail::pool_host_entry& entry,
+        boost::asio::ip::tcp::socket sock
+    ) noexcept
+        : pool_(&pool), entry_(&entry), sock_(std::move(sock))
+    {
+    }
+
+    void reset() noexcept;
+
+public:
+    pooled_connection(pooled_connection&& rhs) noexcept
+        : pool_(std::exchange(rhs.pool_, nullptr)),
+          entry_(rhs.entry_),
+          sock_(std::move(rhs.sock_)),
+          reusable_(rhs.reusable_)
+    {
+    }
+    pooled_connection& operator=(pooled_connection&& rhs) noexcept
+    {
+        if (this != &rhs)
+        {
+            reset();
+            pool_ = std::exchange(rhs.pool_, nullptr);
+            entry_ = rhs.entry_;
+            sock_ = std::move(rhs.sock_);
+            reusable_ = rhs.reusable_;
+        }
+        return *this;
+    }
+    ~pooled_connection() { reset(); }
+
+    boost::asio::ip::tcp::socket& socket() noexcept { return *sock_; }
+
+    // Call this once the response has been fully read and the connection can be reused
+    void set_reusable() noexcept { reusable_ = true; }
+};
+
+class connection_pool
+{
+    friend class pooled_connection;
+
+    using clock = std::chrono::steady_clock;
+
+    using error_code = boost::system::error_code;
+    using host_entry = detail::pool_host_entry;
+    using waiter = detail::pool_waiter;
+
+    boost::asio::any_io_executor ex_;
+    connection_pool_params params_;
+    // unordered_map never invalidates references to its elements, and we never erase,
+    // so host_entry& remain valid across suspension points
+    std::unordered_map<std::string, host_entry> entries_;
+    boost::asio::steady_timer sweep_timer_;
+
+    host_entry& get_entry(std::string_view host, std::string_view port)
+    {
+        std::string key;
+        key.reserve(host.size() + port.size() + 1);
+        key.append(host).append(":").append(port);
+        auto it = entries_.find(key);
+        if (it == entries_.end())
+            it = entries_.emplace(std::move(key), host_entry{std::string(host), std::string(port)}).first;
+        return it->second;
+    }
+
+    // Wakes up the first coroutine waiting for a connection to this host, if any.
+    // If sock is passed, the waiter gets it. Otherwise, it can open a connection itself
+    static bool notify_one(host_entry& entry, boost::asio::ip::tcp::socket* sock = nullptr) noexcept
+    {
+        if (entry.waiters.empty())
+            return false;
+        waiter* w = entry.waiters.front();
+        entry.waiters.pop_front();
+        if (sock)
+            w->sock.emplace(std::move(*sock));
+        w->notified = true;
+        w->timer.cancel();
+        return true;
+    }
+
+    // Called when a connection is closed. Its slot goes to the first waiter, if any
+    static void release_slot(host_entry& entry) noexcept
+    {
+        if (!notify_one(entry))
+            --entry.num_open;
+    }
+
+    // Closes idle connections that have been sitting in the pool for too long.
+    // The oldest connections are at the front of the idle list
+    void evict_expired(host_entry& entry, clock::time_point now)
+    {
+        while (!entry.idle.empty() && now - entry.idle.front().idle_since >= params_.idle_timeout)
+        {
+            error_code ignored;
+            entry.idle.front().sock.close(ignored);
+            entry.idle.pop_front();
+            release_slot(entry);
+        }
+    }
+
+    // Called by pooled_connection when it's destroyed
+    void release(host_entry& entry, boost::asio::ip::tcp::socket sock, bool reusable) noexcept
+    {
+        if (reusable && sock.is_open())
+        {
+            if (notify_one(entry, &sock))
+                return;
+            try
+            {
+                entry.idle.push_back(detail::pool_idle_connection{std::move(sock), clock::now()});
+                return;
+            }
+            catch (const std::exception&)
+            {
+                // Out of memory. Close the connection instead of pooling it
+            }
+        }
+        error_code ignored;
+        sock.close(ignored);
+        release_slot(entry);
+    }
+
+    // Opens a new connection, in a slot that the caller already accounted for in num_open
+    boost::asio::awaitable<pooled_connection> async_open_connection(host_entry& entry)
+    {
+        namespace asio = boost::asio;
+        constexpr auto tok = asio::as_tuple(asio::deferred);
+
+        asio::ip::tcp::resolver resolv(ex_);
+        asio::ip::tcp::socket sock(ex_);
+        auto [ec1, endpoints] = co_await resolv.async_resolve(entry.host, entry.port, tok);
+        error_code ec = ec1;
+        if (!ec)
+            std::tie(ec, std::ignore) = co_await asio::async_connect(sock, endpoints, tok);
+        if (ec)
+        {
+            release_slot(entry);
+            throw boost::system::system_error(ec);
+        }
+        co_return pooled_connection(*this, entry, std::move(sock));
+    }
+
+public:
+    connection_pool(boost::asio::any_io_executor ex, connection_pool_params params = {})
+        : ex_(std::move(ex)), params_(params), sweep_timer_(ex_)
+    {
+    }
+
+    const connection_pool_params& params() const noexcept { return params_; }
+
+    // Checks whether an idle connection is still usable, without blocking.
+    // An idle HTTP connection must have nothing to read: if the peer closed it, we read EOF,
+    // and if it sent unsolicited data, the connection is in an unknown state.
+    static bool is_healthy(boost::asio::ip::tcp::socket& sock)
+    {
+        error_code ec;
+        sock.non_blocking(true, ec);
+        if (ec)
+            return false;
+        char c;
+        sock.receive(boost::asio::buffer(&c, 1), boost::asio::socket_base::message_peek, ec);
+        error_code ignored;
+        sock.non_blocking(false, ignored);
+        return ec == boost::asio::error::would_block;
+    }
+
+    // Gets a connection to host:port, either by reusing an idle one or by creating a new one.
+    // If max_connections_per_host are already open, suspends until one is returned.
+    // Throws on resolve or connect errors.
+    boost::asio::awaitable<pooled_connection> async_get_connection(
+        std::string_view host,
+        std::string_view port
+    )
+    {
+        namespace asio = boost::asio;
+        constexpr auto tok = asio::as_tuple(asio::deferred);
+
+        host_entry& entry = get_entry(host, port);
+
+        // Reuse the most recently returned connection, since it's the least likely to be closed.
+        // Connections are handed to waiters before becoming idle, so there are none if there are waiters
+        evict_expired(entry, clock::now());
+        while (!entry.idle.empty())
+        {
+            asio::ip::tcp::socket sock = std::move(entry.idle.back().sock);
+            entry.idle.pop_back();
+            if (is_healthy(sock))
+                co_return pooled_connection(*this, entry, std::move(sock));
+            error_code ignored;
+            sock.close(ignored);
+            --entry.num_open;
+        }
+
+        // Create a new connection if we're allowed to, and nobody is waiting before us.
+        // Reserve the slot before suspending, so concurrent callers see it
+        if (entry.waiters.empty() && entry.num_open < params_.max_connections_per_host)
+        {
+            ++entry.num_open;
+            co_return co_await async_open_connection(entry);
+        }
+
+        // Wait until somebody hands us a connection, or the slot of a closed one
+        waiter w{asio::steady_timer(ex_, asio::steady_timer::time_point::max())};
+        entry.waiters.push_back(&w);
+        co_await w.timer.async_wait(tok);
+        if (!w.notified)
+        {
+            // We've been cancelled. Remove ourselves from the list and propagate the error
+            entry.waiters.erase(std::find(entry.waiters.begin(), entry.waiters.end(), &w));
+            throw boost::system::system_error(asio::error::operation_aborted);
+        }
+        if (w.sock)
+        {
+            if (is_healthy(*w.sock))
+                co_return pooled_connection(*this, entry, std::move(*w.sock));
+            error_code ignored;
+            w.sock->close(ignored);
+        }
+        co_return co_await async_open_connection(entry);
+    }
+
+    // Periodically closes expired idle connections, so they don't hold file descriptors
+    // for hosts we're no longer talking to. co_spawn this and call cancel() to stop it.
+    boost::asio::awaitable<void> async_run()
+    {
+        namespace asio = boost::asio;
+        while (true)
+        {
+            sweep_timer_.expires_after(params_.idle_timeout / 2);
+            auto [ec] = co_await sweep_timer_.async_wait(asio::as_tuple(asio::deferred));
+            if (ec)
+                co_return;
+            auto now = clock::now();
+            for (auto& [key, entry] : entries_)
+                evict_expired(entry, now);
+        }
+    }
+
+    // Stops async_run
+    void cancel() { sweep_timer_.cancel(); }
+};
+
+inline void pooled_connection::reset() noexcept
+{
+    if (pool_ && sock_)
+    {
+        pool_->release(*entry_, std::move(*sock_), reusable_);
+        sock_.reset();
+    }
+    pool_ = nullptr;
+}
+
+#endif
@@ -0,0 +1,198 @@
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/completion_condition.hpp>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/write.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <charconv>
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "connection_pool.hpp"
+
+// Compares the throughput of the connect-per-request pattern used by the examples
+// against reusing keep-alive connections from a connection_pool.
+// Usage: connection_pool_bench [host] [port] [total-requests] [concurrency]
+
+namespace asio = boost::asio;
+
+struct bench_config
+{
+    std::string host{"127.0.0.1"};
+    std::string port{"8080"};
+    std::size_t total_requests{200};
+    std::size_t concurrency{8};
+    std::string request;  // Built at startup, since the Host header depends on the configuration
+};
+
+// Case-insensitive lookup of a header value. headers contains the status line and headers.
+static std::optional<std::string_view> find_header(std::string_view headers, std::string_view name)
+{
+    auto iequals = [](std::string_view a, std::string_view b) {
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char c1, char c2) {
+                   return std::tolower(static_cast<unsigned char>(c1)) ==
+                          std::tolower(static_cast<unsigned char>(c2));
+               });
+    };
+
+    // Skip the status line
+    std::size_t pos = headers.find("\r\n");
+    while (pos != std::string_view::npos && pos + 2 < headers.size())
+    {
+        pos += 2;
+        std::size_t end = headers.find("\r\n", pos);
+        std::string_view line = headers.substr(pos, end - pos);
+        std::size_t colon = line.find(':');
+        if (colon != std::string_view::npos && iequals(line.substr(0, colon), name))
+        {
+            std::string_view value = line.substr(colon + 1);
+            while (!value.empty() && value.front() == ' ')
+                value.remove_prefix(1);
+            return value;
+        }
+        pos = end;
+    }
+    return std::nullopt;
+}
+
+// Reads a full HTTP response: headers and a Content-Length delimited body.
+// The connection can only be reused if we know where the response ends,
+// so this returns false for chunked or close-delimited bodies and when the server asks to close.
+static asio::awaitable<bool> read_response(asio::ip::tcp::socket& sock, std::string& buff)
+{
+    std::size_t header_size = co_await asio::async_read_until(
+        sock,
+        asio::dynamic_buffer(buff),
+        "\r\n\r\n",
+        asio::deferred
+    );
+    std::string_view headers(buff.data(), header_size);
+
+    auto content_length_header = find_header(headers, "content-length");
+    if (!content_length_header)
+        co_return false;
+    std::size_t content_length = 0;
+    std::from_chars(
+        content_length_header->data(),
+        content_length_header->data() + content_length_header->size(),
+        content_length
+    );
+
+    bool keep_alive = find_header(headers, "connection") != "close";
+
+    // read_until may have read part of the body already
+    std::size_t total_size = header_size + content_length;
+    if (buff.size() < total_size)
+    {
+        co_await asio::async_read(
+            sock,
+            asio::dynamic_buffer(buff),
+            asio::transfer_exactly(total_size - buff.size()),
+            asio::deferred
+        );
+    }
+    co_return keep_alive;
+}
+
+// What the examples do: resolve, connect, send a single request and close
+static asio::awaitable<void> request_connect_per_request(const bench_config& cfg, std::string& buff)
+{
+    auto ex = co_await asio::this_coro::executor;
+    asio::ip::tcp::socket sock(ex);
+    asio::ip::tcp::resolver resolv(ex);
+    auto endpoints = co_await resolv.async_resolve(cfg.host, cfg.port, asio::deferred);
+    co_await asio::async_connect(sock, endpoints, asio::deferred);
+    co_await asio::async_write(sock, asio::buffer(cfg.request), asio::deferred);
+    co_await read_response(sock, buff);
+}
+
+// Same, but getting the connection from the pool
+static asio::awaitable<void> request_pooled(const bench_config& cfg, connection_pool& pool, std::string& buff)
+{
+    pooled_connection conn = co_await pool.async_get_connection(cfg.host, cfg.port);
+    co_await asio::async_write(conn.socket(), asio::buffer(cfg.request), asio::deferred);
+    if (co_await read_response(conn.socket(), buff))
+        conn.set_reusable();
+}
+
+// Each worker issues requests sequentially until the shared budget is exhausted.
+// All workers run in the same thread, so no synchronization is needed.
+static asio::awaitable<void> worker(const bench_config& cfg, connection_pool* pool, std::size_t& remaining)
+{
+    std::string buff;
+    while (remaining > 0)
+    {
+        --remaining;
+        buff.clear();
+        if (pool)
+            co_await request_pooled(cfg, *pool, buff);
+        else
+            co_await request_connect_per_request(cfg, buff);
+    }
+}
+
+static void run_benchmark(const bench_config& cfg, bool use_pool)
+{
+    asio::io_context ctx;
+    connection_pool pool(
+        ctx.get_executor(),
+        connection_pool_params{.max_connections_per_host = cfg.concurrency}
+    );
+    std::size_t remaining = cfg.total_requests;
+
+    for (std::size_t i = 0; i < cfg.concurrency; ++i)
+    {
+        asio::co_spawn(ctx, worker(cfg, use_pool ? &pool : nullptr, remaining), [](std::exception_ptr exc) {
+            if (exc)
+                std::rethrow_exception(exc);
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    ctx.run();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << (use_pool ? "pooled:              " : "connect-per-request: ")
+              << cfg.total_requests / elapsed.count() << " requests/s (" << cfg.total_requests
+              << " requests in " << elapsed.count() << "s)" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    bench_config cfg;
+    if (argc > 1)
+        cfg.host = argv[1];
+    if (argc > 2)
+        cfg.port = argv[2];
+    if (argc > 3)
+        cfg.total_requests = std::stoul(argv[3]);
+    if (argc > 4)
+        cfg.concurrency = std::stoul(argv[4]);
+
+    // HTTP/1.1 connections are persistent by default, so there is no need for a Connection header
+    cfg.request = "GET / HTTP/1.1\r\n"
+                  "Host: " +
+                  cfg.host +
+                  "\r\n"
+                  "User-Agent: Asio\r\n"
+                  "Accept: */*\r\n\r\n";
+
+    run_benchmark(cfg, false);
+    run_benchmark(cfg, true);
+}
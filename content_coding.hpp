@@ -0,0 +1,525 @@
+#ifndef USINGSTDCPP_2024_CONTENT_CODING_HPP
+#define USINGSTDCPP_2024_CONTENT_CODING_HPP
+
+#include <boost/asio/append.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/compose.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/beast/http/field.hpp>
+#include <boost/beast/zlib/deflate_stream.hpp>
+#include <boost/beast/zlib/error.hpp>
+#include <boost/beast/zlib/inflate_stream.hpp>
+#include <boost/beast/zlib/zlib.hpp>
+#include <boost/crc.hpp>
+#include <boost/system/error_category.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+#include "streaming_response.hpp"
+
+// Compressed HTTP response bodies (Content-Encoding: gzip or deflate), decoded as they arrive.
+// beast.cpp doesn't send Accept-Encoding, so every response crosses the wire uncompressed.
+// Text usually compresses several times over, so asking for gzip saves most of the bytes
+// on the wire, at the cost of some CPU to inflate them.
+//
+// content_decoder inflates with Beast's bundled zlib::inflate_stream, which only understands raw
+// deflate data. The gzip (RFC 1952) and zlib (RFC 1950, used by the deflate coding) framing
+// and their CRC-32 and Adler-32 checks are handled here. Input is decoded chunk by chunk into
+// a fixed-size output buffer, which is handed to a callback every time it fills up,
+// so the decoded body is never in memory as a whole:
+//
+//     content_decoder decoder;
+//     decoder.reset(content_coding::gzip);
+//     ec = decoder.write(chunk, [](asio::const_buffer decoded) { use(decoded); });  // For each chunk
+//     ec = decoder.finish();  // At the end of the body
+//
+// A decoder keeps its output buffer and inflate window between bodies, so it can be reused
+// for every response on a connection. async_read_decoded_body drives it from a streaming_response_reader.
+// compress_body does the opposite, for the local server.
+
+enum class content_coding
+{
+    identity,
+    gzip,
+    deflate,
+};
+
+// The Accept-Encoding value for the codings we can decode
+constexpr std::string_view accepted_content_codings = "gzip, deflate";
+
+// The coding named by a Content-Encoding value, or nullopt if we don't support it.
+// Several codings applied one after another (like "gzip, br") aren't supported
+inline std::optional<content_coding> parse_content_encoding(std::string_view value)
+{
+    auto is_space = [](char c) { return c == ' ' || c == '\t'; };
+    while (!value.empty() && is_space(value.front()))
+        value.remove_prefix(1);
+    while (!value.empty() && is_space(value.back()))
+        value.remove_suffix(1);
+
+    // other is lowercase
+    auto iequals = [value](std::string_view other) {
+        auto same_char = [](char a, char b) { return std::tolower(static_cast<unsigned char>(a)) == b; };
+        return value.size() == other.size() &&
+               std::equal(value.begin(), value.end(), other.begin(), same_char);
+    };
+    if (value.empty() || iequals("identity"))
+        return content_coding::identity;
+    if (iequals("gzip") || iequals("x-gzip"))
+        return content_coding::gzip;
+    if (iequals("deflate"))
+        return content_coding::deflate;
+    return std::nullopt;
+}
+
+enum class content_coding_errc
+{
+    unsupported_coding = 1,
+    bad_header,      // Malformed gzip or zlib header
+    bad_checksum,    // The decoded data doesn't match the CRC-32, Adler-32 or size in the trailer
+    truncated_body,  // The body ended before the compressed data did
+    trailing_data,   // There is data after the end of the compressed data
+};
+
+inline const boost::system::error_category& content_coding_category() noexcept
+{
+    struct category final : boost::system::error_category
+    {
+        const char* name() const noexcept override { return "content_coding"; }
+        std::string message(int ev) const override
+        {
+            switch (static_cast<content_coding_errc>(ev))
+            {
+            case content_coding_errc::unsupported_coding: return "unsupported Content-Encoding";
+            case content_coding_errc::bad_header: return "malformed gzip or zlib header";
+            case content_coding_errc::bad_checksum: return "the decoded body doesn't match its checksum";
+            case content_coding_errc::truncated_body: return "the compressed body is truncated";
+            case content_coding_errc::trailing_data: return "data after the end of the compressed body";
+            default: return "unknown content_coding error";
+            }
+        }
+    };
+    static const category cat;
+    return cat;
+}
+
+inline boost::system::error_code make_error_code(content_coding_errc e) noexcept
+{
+    return boost::system::error_code(static_cast<int>(e), content_coding_category());
+}
+
+template <>
+struct boost::system::is_error_code_enum<content_coding_errc> : std::true_type
+{
+};
+
+namespace detail {
+
+inline std::uint32_t update_adler32(std::uint32_t adler, const unsigned char* data, std::size_t size) noexcept
+{
+    constexpr std::uint32_t base = 65521;
+    constexpr std::size_t max_run = 5552;  // The most bytes we can add before the sums may overflow
+    std::uint32_t a = adler & 0xffff, b = adler >> 16;
+    while (size > 0)
+    {
+        std::size_t n = std::min(size, max_run);
+        size -= n;
+        for (; n > 0; --n)
+        {
+            a += *data++;
+            b += a;
+        }
+        a %= base;
+        b %= base;
+    }
+    return (b << 16) | a;
+}
+
+inline std::uint32_t load_le32(const unsigned char* p) noexcept
+{
+    return std::uint32_t(p[0]) | (std::uint32_t(p[1]) << 8) | (std::uint32_t(p[2]) << 16) |
+           (std::uint32_t(p[3]) << 24);
+}
+
+inline std::uint32_t load_be32(const unsigned char* p) noexcept
+{
+    return (std::uint32_t(p[0]) << 24) | (std::uint32_t(p[1]) << 16) | (std::uint32_t(p[2]) << 8) |
+           std::uint32_t(p[3]);
+}
+
+}  // namespace detail
+
+class content_decoder
+{
+    enum class state_t
+    {
+        header,   // Collecting the gzip or zlib header in framing_
+        body,     // Inflating
+        trailer,  // Collecting the gzip or zlib trailer in framing_
+        done,
+    };
+
+    static constexpr std::size_t max_header_size = 64 * 1024;  // gzip headers may contain a file name
+
+    content_coding coding_{content_coding::identity};
+    state_t state_{state_t::done};
+    bool zlib_wrapped_{false};  // Many servers send raw deflate data for the deflate coding
+    boost::beast::zlib::inflate_stream inflater_;
+    std::size_t output_size_;
+    std::unique_ptr<unsigned char[]> output_;
+    std::string framing_;
+    boost::crc_32_type crc_;
+    std::uint32_t adler_{1};
+    std::uint64_t decoded_size_{0};
+
+    void start_member()
+    {
+        state_ = state_t::header;
+        inflater_.reset();
+        framing_.clear();
+        crc_.reset();
+        adler_ = 1;
+        decoded_size_ = 0;
+    }
+
+    std::size_t trailer_size() const noexcept
+    {
+        if (coding_ == content_coding::gzip)
+            return 8;  // CRC-32 and size, little endian
+        return zlib_wrapped_ ? 4 : 0;  // Adler-32, big endian
+    }
+
+    // The size of the header at the start of framing_, or nullopt if it's incomplete
+    std::optional<std::size_t> parse_header(boost::system::error_code& ec)
+    {
+        const auto* p = reinterpret_cast<const unsigned char*>(framing_.data());
+        std::size_t size = framing_.size();
+
+        if (coding_ == content_coding::deflate)
+        {
+            // A zlib header has a deflate method, a window of at most 32KB, and a check value
+            if (size < 2)
+                return std::nullopt;
+            zlib_wrapped_ = (p[0] & 0x0f) == 8 && (p[0] >> 4) <= 7 && ((p[0] << 8) | p[1]) % 31 == 0;
+            if (zlib_wrapped_ && (p[1] & 0x20))
+                ec = content_coding_errc::bad_header;  // Preset dictionaries aren't used in HTTP
+            return zlib_wrapped_ ? 2 : 0;
+        }
+
+        // gzip: ID1, ID2, CM (deflate), FLG, MTIME, XFL, OS, then the optional fields announced in FLG
+        if (size < 10)
+            return std::nullopt;
+        unsigned char flags = p[3];
+        if (p[0] != 0x1f || p[1] != 0x8b || p[2] != 8 || (flags & 0xe0))
+        {
+            ec = content_coding_errc::bad_header;
+            return std::nullopt;
+        }
+        std::size_t pos = 10;
+        if (flags & 0x04)  // FEXTRA
+        {
+            if (size < pos + 2)
+                return std::nullopt;
+            pos += 2 + (p[pos] | (p[pos + 1] << 8));
+        }
+        for (unsigned char flag : {0x08, 0x10})  // FNAME and FCOMMENT, zero-terminated
+        {
+            if (!(flags & flag))
+                continue;
+            std::size_t end = pos < size ? framing_.find('\0', pos) : std::string::npos;
+            if (end == std::string::npos)
+                return std::nullopt;
+            pos = end + 1;
+        }
+        if (flags & 0x02)  // FHCRC
+            pos += 2;
+        if (pos > size)
+            return std::nullopt;
+        return pos;
+    }
+
+    boost::system::error_code check_trailer() const
+    {
+        const auto* p = reinterpret_cast<const unsigned char*>(framing_.data());
+        bool ok = coding_ == content_coding::gzip
+                      ? detail::load_le32(p) == crc_.checksum() &&
+                            detail::load_le32(p + 4) == static_cast<std::uint32_t>(decoded_size_)
+                      : !zlib_wrapped_ || detail::load_be32(p) == adler_;
+        return ok ? boost::system::error_code() : content_coding_errc::bad_checksum;
+    }
+
+    // Inflates from data, advancing it, until the input runs out or the compressed data ends
+    template <class OutputHandler>
+    boost::system::error_code inflate(const unsigned char*& data, std::size_t& size, OutputHandler& on_output)
+    {
+        namespace zlib = boost::beast::zlib;
+        zlib::z_params zs;
+        zs.next_in = data;
+        zs.avail_in = size;
+        boost::system::error_code ec;
+        while (true)
+        {
+            zs.next_out = output_.get();
+            zs.avail_out = output_size_;
+            inflater_.write(zs, zlib::Flush::none, ec);
+
+            std::size_t n = output_size_ - zs.avail_out;
+            if (n > 0)
+            {
+                if (coding_ == content_coding::gzip)
+                    crc_.process_bytes(output_.get(), n);
+                else if (zlib_wrapped_)
+                    adler_ = detail::update_adler32(adler_, output_.get(), n);
+                decoded_size_ += n;
+                on_output(boost::asio::const_buffer(output_.get(), n));
+            }
+
+            if (ec == zlib::error::end_of_stream)
+            {
+                ec.clear();
+                state_ = trailer_size() ? state_t::trailer : state_t::done;
+                break;
+            }
+            if (ec == zlib::error::need_buffers)
+            {
+                ec.clear();
+                break;
+            }
+            if (ec || (zs.avail_in == 0 && zs.avail_out > 0))
+                break;
+        }
+        data += size - zs.avail_in;
+        size = zs.avail_in;
+        return ec;
+    }
+
+public:
+    explicit content_decoder(std::size_t output_size = 64 * 1024)
+        : output_size_(output_size), output_(new unsigned char[output_size])
+    {
+    }
+
+    content_decoder(const content_decoder&) = delete;
+    content_decoder& operator=(const content_decoder&) = delete;
+
+    content_coding coding() const noexcept { return coding_; }
+
+    // Prepares the decoder for a new body
+    void reset(content_coding coding)
+    {
+        coding_ = coding;
+        start_member();
+    }
+
+    // Decodes input, calling on_output(asio::const_buffer) with each piece of decoded data.
+    // Pieces point into the decoder, and are only valid during the call. Identity bodies are passed through
+    template <class OutputHandler>
+    boost::system::error_code write(boost::asio::const_buffer input, OutputHandler&& on_output)
+    {
+        if (coding_ == content_coding::identity)
+        {
+            if (input.size())
+                on_output(input);
+            return {};
+        }
+
+        const auto* data = static_cast<const unsigned char*>(input.data());
+        std::size_t size = input.size();
+        while (size > 0)
+        {
+            switch (state_)
+            {
+            case state_t::done:
+            {
+                // gzip bodies may be several members one after another
+                if (coding_ != content_coding::gzip)
+                    return content_coding_errc::trailing_data;
+                start_member();
+                break;
+            }
+            case state_t::header:
+            {
+                std::size_t old_size = framing_.size();
+                framing_.append(reinterpret_cast<const char*>(data), size);
+                boost::system::error_code ec;
+                auto header_size = parse_header(ec);
+                if (ec)
+                    return ec;
+                if (!header_size)
+                {
+                    if (framing_.size() > max_header_size)
+                        return content_coding_errc::bad_header;
+                    return {};
+                }
+
+                state_ = state_t::body;
+                if (*header_size < old_size)
+                {
+                    // Raw deflate data, whose first byte came in the previous call
+                    const auto* early = reinterpret_cast<const unsigned char*>(framing_.data());
+                    ec = inflate(early, old_size, on_output);
+                    if (ec)
+                        return ec;
+                }
+                else
+                {
+                    data += *header_size - old_size;
+                    size -= *header_size - old_size;
+                }
+                framing_.clear();
+                break;
+            }
+            case state_t::body:
+            {
+                auto ec = inflate(data, size, on_output);
+                if (ec)
+                    return ec;
+                break;
+            }
+            case state_t::trailer:
+            {
+                std::size_t n = std::min(size, trailer_size() - framing_.size());
+                framing_.append(reinterpret_cast<const char*>(data), n);
+                data += n;
+                size -= n;
+                if (framing_.size() == trailer_size())
+                {
+                    auto ec = check_trailer();
+                    if (ec)
+                        return ec;
+                    framing_.clear();
+                    state_ = state_t::done;
+                }
+                break;
+            }
+            }
+        }
+        return {};
+    }
+
+    // Call at the end of the body. Fails if the compressed data was incomplete
+    boost::system::error_code finish() const
+    {
+        if (coding_ == content_coding::identity || state_ == state_t::done)
+            return {};
+        return content_coding_errc::truncated_body;
+    }
+};
+
+// Compresses data with coding, in one go
+inline std::string compress_body(std::string_view data, content_coding coding)
+{
+    namespace zlib = boost::beast::zlib;
+    if (coding == content_coding::identity)
+        return std::string(data);
+
+    // gzip: deflate, no flags, no timestamp, unknown OS. zlib: deflate with a 32KB window, default level
+    std::string res = coding == content_coding::gzip ? std::string("\x1f\x8b\x08\0\0\0\0\0\0\xff", 10)
+                                                     : std::string("\x78\x9c", 2);
+
+    zlib::deflate_stream deflater;
+    std::size_t header_size = res.size();
+    res.resize(header_size + deflater.upper_bound(data.size()));
+    zlib::z_params zs;
+    zs.next_in = data.data();
+    zs.avail_in = data.size();
+    zs.next_out = res.data() + header_size;
+    zs.avail_out = res.size() - header_size;
+    boost::system::error_code ec;
+    deflater.write(zs, zlib::Flush::finish, ec);
+    assert(ec == zlib::error::end_of_stream);  // The output buffer is large enough
+    res.resize(res.size() - zs.avail_out);
+
+    auto append32 = [&res](std::uint32_t value, bool little_endian) {
+        for (int i = 0; i < 4; ++i)
+            res.push_back(static_cast<char>(value >> (little_endian ? 8 * i : 24 - 8 * i)));
+    };
+    const auto* bytes = reinterpret_cast<const unsigned char*>(data.data());
+    if (coding == content_coding::gzip)
+    {
+        boost::crc_32_type crc;
+        crc.process_bytes(bytes, data.size());
+        append32(crc.checksum(), true);
+        append32(static_cast<std::uint32_t>(data.size()), true);
+    }
+    else
+    {
+        append32(detail::update_adler32(1, bytes, data.size()), false);
+    }
+    return res;
+}
+
+// Reads the rest of the body, decoding it according to its Content-Encoding and calling
+// on_chunk(asio::const_buffer) with the decoded data. The decoder is reset for this body
+template <class AsyncStream, class ChunkHandler>
+struct read_decoded_body_op
+{
+    streaming_response_reader<AsyncStream>& reader;
+    content_decoder& decoder;
+    ChunkHandler on_chunk;
+    std::uint64_t total{0};
+
+    template <class Self>
+    void operator()(Self& self)
+    {
+        auto coding = parse_content_encoding(reader.header()[boost::beast::http::field::content_encoding]);
+        if (!coding)
+        {
+            boost::system::error_code ec = content_coding_errc::unsupported_coding;
+            return boost::asio::post(boost::asio::append(std::move(self), ec, boost::asio::const_buffer()));
+        }
+        decoder.reset(*coding);
+        reader.async_read_chunk(std::move(self));
+    }
+
+    template <class Self>
+    void operator()(Self& self, boost::system::error_code ec, boost::asio::const_buffer chunk)
+    {
+        if (!ec)
+        {
+            ec = decoder.write(chunk, [this](boost::asio::const_buffer decoded) {
+                total += decoded.size();
+                on_chunk(decoded);
+            });
+        }
+        if (!ec && reader.done())
+            ec = decoder.finish();
+        if (ec || reader.done())
+            return self.complete(ec, total);
+        reader.async_read_chunk(std::move(self));
+    }
+};
+
+// Completes with the number of decoded bytes delivered to on_chunk.
+// The headers must have been read with reader.async_read_header
+template <
+    class AsyncStream,
+    class ChunkHandler,
+    boost::asio::completion_token_for<void(boost::system::error_code, std::uint64_t)> CompletionToken>
+auto async_read_decoded_body(
+    streaming_response_reader<AsyncStream>& reader,
+    content_decoder& decoder,
+    ChunkHandler on_chunk,
+    CompletionToken&& token
+)
+{
+    return boost::asio::async_compose<CompletionToken, void(boost::system::error_code, std::uint64_t)>(
+        read_decoded_body_op<AsyncStream, ChunkHandler>{reader, decoder, std::move(on_chunk)},
+        token,
+        reader.stream()
+    );
+}
+
+#endif
@@ -0,0 +1,292 @@
+#ifndef USINGSTDCPP_2024_COROUTINE_FRAME_POOL_HPP
+#define USINGSTDCPP_2024_COROUTINE_FRAME_POOL_HPP
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/execution_context.hpp>
+#include <boost/asio/io_context.hpp>
+
+#include <algorithm>
+#include <array>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <ostream>
+#include <stdexcept>
+#include <utility>
+
+#include "io_context_of.hpp"
+
+// Recycles the frames of asio::awaitable coroutines through a size-class pool owned by the io_context.
+// Every co_spawn'ed request handler (as in coroutines.cpp) allocates a frame big enough for all its
+// locals: the socket, the resolver, the buffer... Asio caches a couple of freed frames per thread,
+// but with many coroutines in flight, most frames come from the heap.
+//
+// A coroutine opts in by taking a pooled_frame as its first parameter:
+//
+//     asio::awaitable<void> handle_request(pooled_frame, std::string_view host);
+//     asio::co_spawn(ctx, handle_request(pooled_frame(ctx), host), handler);
+//
+// Its frame is then allocated from the coroutine_frame_pool service of that io_context,
+// which keeps freed frames in per-size-class free lists, and records the sizes of the frames it serves.
+// The pool is configured per io_context by creating it before its first use:
+//
+//     asio::make_service<coroutine_frame_pool>(ctx, frame_pool_options{.max_cached_per_class = 1024});
+//
+// Only free functions can opt in: for member functions and lambdas, the first parameter is the object.
+// Like timer_wheel, the pool is not thread-safe: frames must be created and destroyed
+// by the thread running the io_context (or before it runs), and before the io_context is destroyed.
+//
+// This relies on Asio internals, and is formally undefined behavior: the promise type derives
+// from boost::asio::detail::awaitable_frame, and awaiting another awaitable calls
+// coroutine_handle<Base>::from_promise on the derived promise, which the standard only allows
+// for the coroutine's actual promise type.
+// It works because the derived promise adds no data members. Checked against Boost 1.84;
+// coroutine_frame_pool_bench checks that nested co_awaits still behave like with asio::awaitable.
+
+struct frame_pool_options
+{
+    // Frames are rounded up to a multiple of granularity. Larger ones bypass the pool
+    std::size_t granularity{64};
+    std::size_t max_pooled_size{4096};
+
+    // Freed frames beyond this are returned to the heap. 0 disables the pool, but keeps the statistics
+    std::size_t max_cached_per_class{std::numeric_limits<std::size_t>::max()};
+};
+
+struct frame_pool_stats
+{
+    std::uint64_t allocations{0};
+    std::uint64_t pool_hits{0};         // Allocations served from a free list
+    std::uint64_t heap_allocations{0};  // Allocations that had to call operator new
+    std::size_t live_frames{0};
+    std::size_t max_live_frames{0};
+    std::size_t min_frame_size{std::numeric_limits<std::size_t>::max()};
+    std::size_t max_frame_size{0};
+};
+
+class coroutine_frame_pool : public boost::asio::execution_context::service
+{
+    static constexpr std::size_t max_classes = 256;
+
+    struct free_block
+    {
+        free_block* next;
+    };
+
+    // Stored before each frame, so operator delete can find the pool and the size
+    struct alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) frame_header
+    {
+        coroutine_frame_pool* pool;
+        std::size_t size;
+    };
+
+    frame_pool_options opts_;
+    std::size_t num_classes_;
+    std::array<free_block*, max_classes> free_lists_{};
+    std::array<std::size_t, max_classes> num_cached_{};
+    std::array<std::uint64_t, max_classes + 1> allocations_per_class_{};  // The last one is for large frames
+    frame_pool_stats stats_;
+    bool shut_down_{false};
+
+    std::size_t size_class(std::size_t size) const noexcept { return (size - 1) / opts_.granularity; }
+
+    void* allocate_block(std::size_t size)
+    {
+        ++stats_.allocations;
+        stats_.max_live_frames = std::max(stats_.max_live_frames, ++stats_.live_frames);
+        stats_.min_frame_size = std::min(stats_.min_frame_size, size);
+        stats_.max_frame_size = std::max(stats_.max_frame_size, size);
+
+        std::size_t total = size + sizeof(frame_header);
+        std::size_t cls = size_class(total);
+        if (cls >= num_classes_)
+        {
+            ++allocations_per_class_[max_classes];
+            ++stats_.heap_allocations;
+            return ::operator new(total);
+        }
+        ++allocations_per_class_[cls];
+        if (free_block* b = free_lists_[cls])
+        {
+            free_lists_[cls] = b->next;
+            --num_cached_[cls];
+            ++stats_.pool_hits;
+            return b;
+        }
+        ++stats_.heap_allocations;
+        return ::operator new((cls + 1) * opts_.granularity);
+    }
+
+    void deallocate_block(void* p, std::size_t total) noexcept
+    {
+        --stats_.live_frames;
+        std::size_t cls = size_class(total);
+        if (!shut_down_ && cls < num_classes_ && num_cached_[cls] < opts_.max_cached_per_class)
+        {
+            free_lists_[cls] = ::new (p) free_block{free_lists_[cls]};
+            ++num_cached_[cls];
+        }
+        else
+        {
+            ::operator delete(p);
+        }
+    }
+
+    void release_cached() noexcept
+    {
+        for (std::size_t cls = 0; cls < num_classes_; ++cls)
+        {
+            while (free_block* b = free_lists_[cls])
+            {
+                free_lists_[cls] = b->next;
+                ::operator delete(b);
+            }
+            num_cached_[cls] = 0;
+        }
+    }
+
+    // Frames destroyed while the io_context shuts down go back to the heap
+    void shutdown() override
+    {
+        shut_down_ = true;
+        release_cached();
+    }
+
+public:
+    static inline boost::asio::execution_context::id id;
+
+    // Called by use_service, or by make_service with the options
+    explicit coroutine_frame_pool(boost::asio::execution_context& ctx, const frame_pool_options& opts = {})
+        : boost::asio::execution_context::service(ctx),
+          opts_(opts),
+          num_classes_(std::min(opts.max_pooled_size / opts.granularity, max_classes))
+    {
+        if (opts.granularity < sizeof(free_block) || opts.granularity % __STDCPP_DEFAULT_NEW_ALIGNMENT__ != 0)
+            throw std::invalid_argument("coroutine_frame_pool: invalid granularity");
+    }
+
+    coroutine_frame_pool(const coroutine_frame_pool&) = delete;
+    coroutine_frame_pool& operator=(const coroutine_frame_pool&) = delete;
+
+    ~coroutine_frame_pool() { release_cached(); }
+
+    // The pool for the io_context running ex. ex must be an io_context executor,
+    // or a polymorphic executor holding one. Throws otherwise
+    template <class Executor>
+    static coroutine_frame_pool& use(const Executor& ex)
+    {
+        return boost::asio::use_service<coroutine_frame_pool>(io_context_of(ex));
+    }
+
+    // Returns memory for a frame of the given size
+    void* allocate(std::size_t size)
+    {
+        void* block = allocate_block(size);
+        auto* header = ::new (block) frame_header{this, size};
+        return header + 1;
+    }
+
+    static void deallocate(void* frame) noexcept
+    {
+        auto* header = static_cast<frame_header*>(frame) - 1;
+        header->pool->deallocate_block(header, header->size + sizeof(frame_header));
+    }
+
+    const frame_pool_stats& stats() const noexcept { return stats_; }
+
+    // The number of frames allocated per size class, as ranges of sizes
+    void write_size_histogram(std::ostream& os) const
+    {
+        for (std::size_t cls = 0; cls < num_classes_; ++cls)
+        {
+            if (allocations_per_class_[cls] == 0)
+                continue;
+            // Sizes without the header
+            std::size_t hi = (cls + 1) * opts_.granularity - sizeof(frame_header);
+            std::size_t lo = cls == 0 ? 1 : hi - opts_.granularity + 1;
+            os << "  " << lo << "-" << hi << " bytes: " << allocations_per_class_[cls] << " frames\n";
+        }
+        if (allocations_per_class_[max_classes])
+            os << "  larger: " << allocations_per_class_[max_classes] << " frames\n";
+    }
+};
+
+// Pass as the first argument of a coroutine to allocate its frame from ctx's coroutine_frame_pool
+struct pooled_frame
+{
+    coroutine_frame_pool* pool;
+
+    explicit pooled_frame(boost::asio::io_context& ctx)
+        : pool(&boost::asio::use_service<coroutine_frame_pool>(ctx))
+    {
+    }
+
+    template <class Executor>
+    explicit pooled_frame(const Executor& ex) : pool(&coroutine_frame_pool::use(ex))
+    {
+    }
+};
+
+namespace detail {
+
+// asio::awaitable's promise type, with a different allocation function
+template <class T, class Executor>
+class pooled_awaitable_frame : public boost::asio::detail::awaitable_frame<T, Executor>
+{
+    using base_type = boost::asio::detail::awaitable_frame<T, Executor>;
+
+public:
+    template <class... Args>
+    static void* operator new(std::size_t size, pooled_frame f, Args&&...)
+    {
+        return f.pool->allocate(size);
+    }
+
+    static void operator delete(void* frame, std::size_t) noexcept
+    {
+        coroutine_frame_pool::deallocate(frame);
+    }
+
+    // awaitable::await_suspend expects the handle of a coroutine with Asio's promise type,
+    // so awaiting another awaitable needs to pass it one
+    template <class U>
+    struct awaitable_adapter
+    {
+        boost::asio::awaitable<U, Executor> a;
+
+        bool await_ready() const noexcept { return a.await_ready(); }
+
+        void await_suspend(std::coroutine_handle<pooled_awaitable_frame> h)
+        {
+            using base_handle = std::coroutine_handle<boost::asio::detail::awaitable_frame<T, Executor>>;
+            a.await_suspend(base_handle::from_promise(h.promise()));
+        }
+
+        U await_resume() { return a.await_resume(); }
+    };
+
+    using base_type::await_transform;
+
+    // Goes through Asio's own await_transform first, which throws operation_aborted
+    // if the coroutine has been cancelled (throw_if_cancelled, on by default)
+    template <class U>
+    auto await_transform(boost::asio::awaitable<U, Executor> a) const
+    {
+        return awaitable_adapter<U>{base_type::await_transform(std::move(a))};
+    }
+};
+
+}  // namespace detail
+
+// Asio selects its promise type for any coroutine returning asio::awaitable. This specialization
+// is more specialized, so it wins for those whose first parameter is a pooled_frame.
+// The promise adds no data members, so it's laid out exactly like the one it derives from
+template <class T, class Executor, class... Args>
+struct std::coroutine_traits<boost::asio::awaitable<T, Executor>, pooled_frame, Args...>
+{
+    using promise_type = detail::pooled_awaitable_frame<T, Executor>;
+};
+
+#endif
@@ -0,0 +1,202 @@
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/bind_cancellation_slot.hpp>
+#include <boost/asio/cancellation_signal.hpp>
+#include <boost/asio/cancellation_type.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/execution_context.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/system/system_error.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "coroutine_frame_pool.hpp"
+
+// Measures the cost of creating and destroying request handler coroutines, with Asio's default
+// frame allocation and with coroutine_frame_pool, as the number of coroutines in flight grows.
+// Each coroutine has the locals of handle_request_impl in coroutines.cpp (a socket, a resolver
+// and a string) and suspends twice, without doing any I/O. When one finishes, another one is spawned,
+// until the total number of coroutines has been run.
+// First checks that awaiting other coroutines from a pooled coroutine behaves like with the default
+// frames: results and exceptions propagate, and a cancelled coroutine can't await any more.
+// Usage: coroutine_frame_pool_bench [total coroutines]
+
+namespace asio = boost::asio;
+
+static asio::awaitable<void> default_request()
+{
+    auto ex = co_await asio::this_coro::executor;
+    asio::ip::tcp::socket sock(ex);
+    asio::ip::tcp::resolver resolv(ex);
+    std::string buff;
+    co_await asio::post(ex, asio::deferred);
+    co_await asio::post(ex, asio::deferred);
+}
+
+// The same, with a pooled frame
+static asio::awaitable<void> pooled_request(pooled_frame)
+{
+    auto ex = co_await asio::this_coro::executor;
+    asio::ip::tcp::socket sock(ex);
+    asio::ip::tcp::resolver resolv(ex);
+    std::string buff;
+    co_await asio::post(ex, asio::deferred);
+    co_await asio::post(ex, asio::deferred);
+}
+
+static asio::awaitable<int> child_value() { co_return 42; }
+
+static asio::awaitable<void> child_throws()
+{
+    throw std::runtime_error("child failed");
+    co_return;
+}
+
+// With an empty Frame pack the coroutine uses the default frame, and with a pooled_frame a pooled one.
+// Describes what happened to each nested co_await
+template <class... Frame>
+static asio::awaitable<std::string> nested_awaits(Frame...)
+{
+    std::string res = "value " + std::to_string(co_await child_value());
+    try
+    {
+        co_await child_throws();
+        res += ", no exception";
+    }
+    catch (const std::runtime_error& err)
+    {
+        res += std::string(", exception: ") + err.what();
+    }
+
+    // The coroutine is cancelled while waiting. Awaiting a child afterwards throws operation_aborted
+    asio::steady_timer timer(co_await asio::this_coro::executor, std::chrono::hours(1));
+    try
+    {
+        co_await timer.async_wait(asio::deferred);
+    }
+    catch (const boost::system::system_error&)
+    {
+    }
+    try
+    {
+        co_await child_value();
+        res += ", awaited after cancellation";
+    }
+    catch (const boost::system::system_error& err)
+    {
+        res += ", after cancellation: " + err.code().message();
+    }
+    co_return res;
+}
+
+template <class... Frame>
+static std::string run_nested_awaits(asio::io_context& ctx, Frame... frame)
+{
+    asio::cancellation_signal sig;
+    std::string res;
+    asio::co_spawn(
+        ctx,
+        nested_awaits(frame...),
+        asio::bind_cancellation_slot(sig.slot(), [&res](std::exception_ptr exc, std::string value) {
+            if (exc)
+                std::rethrow_exception(exc);
+            res = std::move(value);
+        })
+    );
+    asio::post(ctx, [&sig] { sig.emit(asio::cancellation_type::terminal); });
+    ctx.run();
+    ctx.restart();
+    return res;
+}
+
+static bool check_nested_awaits()
+{
+    asio::io_context ctx;
+    std::string expected = run_nested_awaits(ctx);
+    std::string pooled = run_nested_awaits(ctx, pooled_frame(ctx));
+    bool ok = pooled == expected;
+    std::cout << (ok ? "Nested co_await check passed: " : "Nested co_await check FAILED:\n  default: ")
+              << expected << (ok ? "\n" : "\n  pooled:  " + pooled + "\n");
+    return ok;
+}
+
+// Keeps a fixed number of coroutines in flight
+struct driver
+{
+    asio::io_context& ctx;
+    std::size_t remaining;
+    bool pooled;
+
+    void spawn_one()
+    {
+        if (remaining == 0)
+            return;
+        --remaining;
+        auto on_done = [this](std::exception_ptr exc) {
+            if (exc)
+                std::rethrow_exception(exc);
+            spawn_one();
+        };
+        if (pooled)
+            asio::co_spawn(ctx, pooled_request(pooled_frame(ctx)), on_done);
+        else
+            asio::co_spawn(ctx, default_request(), on_done);
+    }
+};
+
+static void run(
+    std::string_view name,
+    bool pooled,
+    std::size_t concurrency,
+    std::size_t total,
+    bool print_stats
+)
+{
+    asio::io_context ctx;
+    if (pooled)
+        asio::make_service<coroutine_frame_pool>(ctx, frame_pool_options{});
+
+    driver d{ctx, total, pooled};
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < concurrency; ++i)
+        d.spawn_one();
+    ctx.run();
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "  " << name << ": " << elapsed.count() / total << " ns/coroutine\n";
+
+    if (print_stats)
+    {
+        const auto& pool = asio::use_service<coroutine_frame_pool>(ctx);
+        const auto& st = pool.stats();
+        std::cout << "  Frame statistics: " << st.allocations << " frames, " << st.pool_hits
+                  << " from the pool, " << st.heap_allocations << " from the heap, at most "
+                  << st.max_live_frames << " at once, sizes " << st.min_frame_size << "-" << st.max_frame_size
+                  << " bytes\n";
+        pool.write_size_histogram(std::cout);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t total = argc > 1 ? std::stoul(argv[1]) : 1000000;
+    if (!check_nested_awaits())
+        return EXIT_FAILURE;
+
+    for (std::size_t concurrency : {1, 10, 100, 1000, 10000, 100000})
+    {
+        std::cout << concurrency << " coroutines in flight:\n";
+        run("default", false, concurrency, total, false);
+        run("coroutine_frame_pool", true, concurrency, total, concurrency == 100000);
+    }
+}
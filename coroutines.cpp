@@ -18,6 +18,8 @@
 #include <string>
 #include <string_view>
 
+#include "example_target.hpp"
+
 namespace asio = boost::asio;
 
 // The GET HTTP request to send to the server
@@ -43,7 +45,11 @@ asio::awaitable<void> handle_request_impl()
     asio::ip::tcp::resolver resolv(ex);
 
     // Resolve the hostname and port into a set of endpoints
-    auto endpoints = co_await resolv.async_resolve("example.com", "80", asio::deferred);
+    auto endpoints = co_await resolv.async_resolve(
+        example_host("example.com"),
+        example_port(),
+        asio::deferred
+    );
 
     // Connect to the server
     co_await asio::async_connect(sock, endpoints, asio::deferred);
@@ -0,0 +1,78 @@
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/as_tuple.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/system/errc.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include "example_target.hpp"
+#include "request_deadline.hpp"
+
+namespace asio = boost::asio;
+
+// The GET HTTP request to send to the server
+static constexpr std::string_view request =
+    "GET / HTTP/1.1\r\n"
+    "Host: example.com\r\n"
+    "User-Agent: Asio\r\n"
+    "Accept: */*\r\n\r\n";
+
+asio::awaitable<void> handle_request_impl()
+{
+    // Coroutines know which executor are using
+    asio::any_io_executor ex = co_await asio::this_coro::executor;
+
+    // These variables need to remain valid until the operation completes
+    asio::ip::tcp::socket sock(ex);
+    asio::ip::tcp::resolver resolv(ex);
+    std::string buff;
+
+    // 5 seconds for the whole request, but give up if connecting takes more than 1 second,
+    // or if the server takes more than 2 seconds to answer
+    request_budget budget{
+        .total = std::chrono::seconds(5),
+        .connect = std::chrono::seconds(1),
+        .read = std::chrono::seconds(2),
+    };
+
+    // Call our operation
+    auto [ec, bytes_read] = co_await async_request_with_deadline(
+        resolv,
+        sock,
+        example_host("example.com"),
+        example_port(),
+        request,
+        buff,
+        budget,
+        asio::as_tuple(asio::deferred)
+    );
+
+    // The error code tells which stage ran out of time
+    if (ec == boost::system::errc::timed_out)
+        std::cout << "Timeout: " << ec.message() << std::endl;
+    else if (ec)
+        std::cout << "Error: " << ec.message() << std::endl;
+    else
+        std::cout << std::string_view(buff.data(), bytes_read) << std::endl;
+}
+
+int main()
+{
+    asio::io_context ctx;
+    asio::co_spawn(ctx, handle_request_impl, [](std::exception_ptr exc) {
+        if (exc)
+            std::rethrow_exception(exc);
+    });
+    ctx.run();
+}
@@ -0,0 +1,224 @@
+#ifndef USINGSTDCPP_2024_DNS_CACHE_HPP
+#define USINGSTDCPP_2024_DNS_CACHE_HPP
+
+#include <boost/asio/any_completion_handler.hpp>
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/append.hpp>
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/consign.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/execution/outstanding_work.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/prefer.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// A cache of tcp::resolver results, to avoid calling getaddrinfo for every request.
+// tcp::resolver::async_resolve runs the blocking getaddrinfo in a background thread,
+// one lookup at a time, so repeated lookups of the same name serialize and add latency.
+//
+// dns_cache::async_resolve is a drop-in replacement for tcp::resolver::async_resolve:
+// it's an initiating function with signature void(error_code, results_type), so it works
+// with any completion token (callbacks, deferred, as_tuple...).
+//
+//   - Entries live for positive_ttl. getaddrinfo doesn't expose record TTLs, so this is configurable.
+//   - Failed lookups are cached for negative_ttl, so a missing host doesn't cause a lookup storm.
+//   - Concurrent lookups for the same name are coalesced into a single resolve.
+//   - Entries used within the last refresh_ahead of their lifetime are refreshed in the background,
+//     while we keep serving the cached results. If the refresh fails, the old results are kept.
+//
+// The cache is thread-safe, and can be shared between io_contexts running in different threads.
+// Handlers are always invoked through their associated executor, never from within async_resolve.
+// The cache must outlive any operation started on it.
+
+struct dns_cache_params
+{
+    std::chrono::steady_clock::duration positive_ttl{std::chrono::seconds(60)};
+    std::chrono::steady_clock::duration negative_ttl{std::chrono::seconds(5)};
+    std::chrono::steady_clock::duration refresh_ahead{std::chrono::seconds(10)};
+};
+
+class dns_cache
+{
+public:
+    using results_type = boost::asio::ip::tcp::resolver::results_type;
+    using signature = void(boost::system::error_code, results_type);
+
+private:
+    using clock = std::chrono::steady_clock;
+    using error_code = boost::system::error_code;
+
+    // An operation waiting for a lookup in progress. We keep the handler's executor
+    // with outstanding work, so its io_context doesn't run out of work while we wait
+    struct waiter
+    {
+        boost::asio::any_completion_handler<signature> handler;
+        boost::asio::any_io_executor work;
+    };
+
+    struct entry
+    {
+        error_code ec;
+        results_type results;
+        clock::time_point expires_at{clock::time_point::min()};
+        bool in_flight{false};
+        std::vector<waiter> waiters;
+    };
+
+    boost::asio::any_io_executor ex_;
+    dns_cache_params params_;
+    std::mutex mtx_;
+    std::unordered_map<std::string, entry> entries_;
+
+    static std::string make_key(std::string_view host, std::string_view service)
+    {
+        std::string res;
+        res.reserve(host.size() + service.size() + 1);
+        res.append(host).append(":").append(service);
+        return res;
+    }
+
+    static void complete(waiter w, error_code ec, results_type results)
+    {
+        boost::asio::post(w.work, boost::asio::append(std::move(w.handler), ec, std::move(results)));
+    }
+
+    // Launches a getaddrinfo in the background. Must be called with in_flight set
+    void start_lookup(std::string key, std::string host, std::string service)
+    {
+        auto resolv = std::make_shared<boost::asio::ip::tcp::resolver>(ex_);
+        resolv->async_resolve(
+            host,
+            service,
+            boost::asio::consign(
+                [this, key = std::move(key)](error_code ec, results_type results) {
+                    on_lookup_complete(key, ec, std::move(results));
+                },
+                resolv
+            )
+        );
+    }
+
+    void on_lookup_complete(const std::string& key, error_code ec, results_type results)
+    {
+        std::vector<waiter> waiters;
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            entry& e = entries_[key];
+            e.in_flight = false;
+            waiters.swap(e.waiters);
+            auto now = clock::now();
+
+            if (!ec)
+            {
+                e.ec = error_code();
+                e.results = results;
+                e.expires_at = now + params_.positive_ttl;
+            }
+            else if (e.ec || e.expires_at <= now)
+            {
+                // Negative caching. If this was a background refresh of a valid entry,
+                // keep serving the old results until they expire instead.
+                // Cancellations are not a property of the name, so they're not cached
+                if (ec != boost::asio::error::operation_aborted)
+                {
+                    e.ec = ec;
+                    e.results = results_type();
+                    e.expires_at = now + params_.negative_ttl;
+                }
+            }
+        }
+
+        for (auto& w : waiters)
+            complete(std::move(w), ec, results);
+    }
+
+    void initiate(waiter w, std::string host, std::string service)
+    {
+        std::string key = make_key(host, service);
+        std::unique_lock<std::mutex> lock(mtx_);
+        entry& e = entries_[key];
+        auto now = clock::now();
+
+        if (now < e.expires_at)
+        {
+            // Cache hit. Refresh ahead of time if we're close to expiring
+            error_code ec = e.ec;
+            results_type results = e.results;
+            bool refresh = !ec && !e.in_flight && e.expires_at - now <= params_.refresh_ahead;
+            if (refresh)
+                e.in_flight = true;
+            lock.unlock();
+
+            if (refresh)
+                start_lookup(std::move(key), std::move(host), std::move(service));
+            complete(std::move(w), ec, std::move(results));
+        }
+        else
+        {
+            // Miss. Join the lookup in progress, if any
+            e.waiters.push_back(std::move(w));
+            if (!e.in_flight)
+            {
+                e.in_flight = true;
+                lock.unlock();
+                start_lookup(std::move(key), std::move(host), std::move(service));
+            }
+        }
+    }
+
+public:
+    // ex is used to run lookups. It must be an executor to an io_context that will be running
+    // as long as there are pending operations.
+    dns_cache(boost::asio::any_io_executor ex, dns_cache_params params = {})
+        : ex_(std::move(ex)), params_(params)
+    {
+    }
+
+    dns_cache(const dns_cache&) = delete;
+    dns_cache& operator=(const dns_cache&) = delete;
+
+    const dns_cache_params& params() const noexcept { return params_; }
+
+    // Removes all cached entries. Lookups in progress are not affected
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        for (auto it = entries_.begin(); it != entries_.end();)
+        {
+            if (it->second.in_flight)
+                (it++)->second.expires_at = clock::time_point::min();
+            else
+                it = entries_.erase(it);
+        }
+    }
+
+    template <boost::asio::completion_token_for<signature> CompletionToken>
+    auto async_resolve(std::string_view host, std::string_view service, CompletionToken&& token)
+    {
+        return boost::asio::async_initiate<CompletionToken, signature>(
+            [this](auto handler, std::string host, std::string service) {
+                auto work = boost::asio::prefer(
+                    boost::asio::get_associated_executor(handler, ex_),
+                    boost::asio::execution::outstanding_work.tracked
+                );
+                initiate(waiter{std::move(handler), std::move(work)}, std::move(host), std::move(service));
+            },
+            token,
+            std::string(host),
+            std::string(service)
+        );
+    }
+};
+
+#endif
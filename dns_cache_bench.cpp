@@ -0,0 +1,91 @@
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <string>
+
+#include "dns_cache.hpp"
+
+// Compares lookups/s of tcp::resolver::async_resolve against dns_cache::async_resolve.
+// Usage: dns_cache_bench [host] [total-lookups] [concurrency]
+
+namespace asio = boost::asio;
+using boost::system::error_code;
+
+struct bench_config
+{
+    std::string host{"example.com"};
+    std::size_t total_lookups{1000};
+    std::size_t concurrency{32};
+};
+
+static asio::awaitable<void> worker(const bench_config& cfg, dns_cache* cache, std::size_t& remaining)
+{
+    asio::ip::tcp::resolver resolv(co_await asio::this_coro::executor);
+    while (remaining > 0)
+    {
+        --remaining;
+
+        // dns_cache::async_resolve is a drop-in replacement for the resolver's
+        if (cache)
+            co_await cache->async_resolve(cfg.host, "80", asio::deferred);
+        else
+            co_await resolv.async_resolve(cfg.host, "80", asio::deferred);
+    }
+}
+
+static void run_benchmark(const bench_config& cfg, bool use_cache)
+{
+    asio::io_context ctx;
+    dns_cache cache(ctx.get_executor());
+    std::size_t remaining = cfg.total_lookups;
+
+    for (std::size_t i = 0; i < cfg.concurrency; ++i)
+    {
+        asio::co_spawn(ctx, worker(cfg, use_cache ? &cache : nullptr, remaining), [](std::exception_ptr exc) {
+            if (exc)
+                std::rethrow_exception(exc);
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    ctx.run();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << (use_cache ? "dns_cache: " : "resolver:  ") << cfg.total_lookups / elapsed.count()
+              << " lookups/s" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    bench_config cfg;
+    if (argc > 1)
+        cfg.host = argv[1];
+    if (argc > 2)
+        cfg.total_lookups = std::stoul(argv[2]);
+    if (argc > 3)
+        cfg.concurrency = std::stoul(argv[3]);
+
+    run_benchmark(cfg, false);
+    run_benchmark(cfg, true);
+
+    // Like any other initiating function, it can also be used with callbacks
+    asio::io_context ctx;
+    dns_cache cache(ctx.get_executor());
+    cache.async_resolve(cfg.host, "80", [](error_code ec, dns_cache::results_type endpoints) {
+        if (ec)
+            std::cerr << "Error resolving: " << ec.message() << std::endl;
+        else
+            std::cout << "Resolved " << endpoints.size() << " endpoints" << std::endl;
+    });
+    ctx.run();
+}
@@ -0,0 +1,698 @@
+#ifndef USINGSTDCPP_2024_DNS_RESOLVER_HPP
+#define USINGSTDCPP_2024_DNS_RESOLVER_HPP
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/append.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/cancellation_type.hpp>
+#include <boost/asio/compose.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/experimental/cancellation_condition.hpp>
+#include <boost/asio/experimental/parallel_group.hpp>
+#include <boost/asio/ip/address.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// A DNS stub resolver that runs on the io_context, as a replacement for tcp::resolver.
+// tcp::resolver::async_resolve runs the blocking getaddrinfo in a hidden background thread,
+// one lookup at a time, so under high churn lookups queue up behind each other (see dns_cache.hpp).
+// dns_resolver talks to the name servers itself, over udp::socket:
+//
+//   - The A and AAAA queries are sent concurrently, in an experimental::make_parallel_group.
+//   - Each query is sent to the name servers in turn, waiting up to timeout for each,
+//     for attempts rounds, like glibc does.
+//   - If the reply is truncated, the query is repeated over TCP.
+//   - The name servers, timeout and attempts are read from /etc/resolv.conf by default.
+//
+// async_resolve has the same signature as tcp::resolver::async_resolve: void(error_code, results_type),
+// so it's a drop-in replacement, and can be used with dns_cache-style wrappers and any completion token.
+// It supports per-operation cancellation.
+//
+// It's a stub resolver, not getaddrinfo: /etc/hosts, search domains and ndots are not used,
+// so names are looked up as given. IP addresses are returned as they are, without any query.
+// Services must be port numbers, "http" or "https". IPv6 addresses come first, like getaddrinfo
+// does on dual-stack hosts. Not thread-safe: use a resolver from a single thread (or strand).
+
+struct dns_resolver_config
+{
+    std::vector<boost::asio::ip::udp::endpoint> nameservers;
+    std::chrono::steady_clock::duration timeout{std::chrono::seconds(5)};  // Per query and server
+    unsigned attempts{2};  // Rounds over all the name servers
+};
+
+// Parses the nameserver lines and the timeout and attempts options. Missing values keep the glibc defaults:
+// if there are no name servers, the local one (127.0.0.1) is used.
+inline dns_resolver_config read_resolv_conf(const std::string& path = "/etc/resolv.conf")
+{
+    constexpr std::size_t max_nameservers = 3;  // glibc's MAXNS
+    dns_resolver_config res;
+    std::ifstream is(path);
+    std::string line;
+    while (std::getline(is, line))
+    {
+        std::istringstream words(line);
+        std::string keyword;
+        words >> keyword;
+        if (keyword == "nameserver")
+        {
+            std::string addr_str;
+            words >> addr_str;
+            boost::system::error_code ec;
+            auto addr = boost::asio::ip::make_address(addr_str, ec);
+            if (!ec && res.nameservers.size() < max_nameservers)
+                res.nameservers.emplace_back(addr, 53);
+        }
+        else if (keyword == "options")
+        {
+            std::string opt;
+            while (words >> opt)
+            {
+                // Invalid values are treated as 0, and clamped like glibc does
+                auto value = [&opt](std::size_t prefix_size, unsigned max) {
+                    unsigned res = 0;
+                    std::from_chars(opt.data() + prefix_size, opt.data() + opt.size(), res);
+                    return std::clamp(res, 1u, max);
+                };
+                if (opt.rfind("timeout:", 0) == 0)
+                    res.timeout = std::chrono::seconds(value(8, 30));
+                else if (opt.rfind("attempts:", 0) == 0)
+                    res.attempts = value(9, 5);
+            }
+        }
+    }
+    if (res.nameservers.empty())
+        res.nameservers.emplace_back(boost::asio::ip::address_v4::loopback(), 53);
+    return res;
+}
+
+namespace detail {
+
+// The wire format is described in RFC 1035, section 4
+constexpr std::uint16_t dns_type_a = 1;
+constexpr std::uint16_t dns_type_aaaa = 28;
+constexpr std::uint16_t dns_class_in = 1;
+constexpr std::size_t dns_header_size = 12;
+constexpr std::size_t dns_max_udp_size = 512;  // We don't use EDNS0, so replies are at most this size
+
+// A name we can query: dot-separated labels of 1 to 63 characters, optionally ending with a dot
+inline bool is_valid_dns_name(std::string_view name)
+{
+    if (!name.empty() && name.back() == '.')
+        name.remove_suffix(1);
+    if (name.empty() || name.size() > 253)
+        return false;
+    while (true)
+    {
+        auto dot = name.find('.');
+        auto label = name.substr(0, dot);
+        if (label.empty() || label.size() > 63)
+            return false;
+        if (dot == std::string_view::npos)
+            return true;
+        name.remove_prefix(dot + 1);
+    }
+}
+
+// A standard query with recursion desired. The ID is set before sending it. name must be valid
+inline std::vector<unsigned char> build_dns_query(std::string_view name, std::uint16_t qtype)
+{
+    std::vector<unsigned char> res;
+    auto put16 = [&res](std::uint16_t value) {
+        res.push_back(static_cast<unsigned char>(value >> 8));
+        res.push_back(static_cast<unsigned char>(value & 0xff));
+    };
+
+    // Header: ID, flags (RD), QDCOUNT, ANCOUNT, NSCOUNT, ARCOUNT
+    for (std::uint16_t value : {0, 0x0100, 1, 0, 0, 0})
+        put16(value);
+
+    // Question: QNAME as a sequence of labels, QTYPE, QCLASS
+    if (name.back() == '.')
+        name.remove_suffix(1);
+    while (true)
+    {
+        auto dot = name.find('.');
+        auto label = name.substr(0, dot);
+        res.push_back(static_cast<unsigned char>(label.size()));
+        res.insert(res.end(), label.begin(), label.end());
+        if (dot == std::string_view::npos)
+            break;
+        name.remove_prefix(dot + 1);
+    }
+    res.push_back(0);
+    put16(qtype);
+    put16(dns_class_in);
+    return res;
+}
+
+// Reads a message. Reading past the end sets ok to false and returns zeroes
+struct dns_message_reader
+{
+    const unsigned char* data;
+    std::size_t size;
+    std::size_t pos{0};
+    bool ok{true};
+
+    void skip(std::size_t n)
+    {
+        if (size - pos < n)
+        {
+            ok = false;
+            pos = size;
+        }
+        else
+        {
+            pos += n;
+        }
+    }
+
+    std::uint16_t read16()
+    {
+        if (size - pos < 2)
+        {
+            skip(2);
+            return 0;
+        }
+        auto res = static_cast<std::uint16_t>((data[pos] << 8) | data[pos + 1]);
+        pos += 2;
+        return res;
+    }
+
+    // Names may end with a pointer to a previous name (compression)
+    void skip_name()
+    {
+        while (ok)
+        {
+            if (pos == size)
+                return skip(1);
+            unsigned char len = data[pos];
+            if ((len & 0xc0) == 0xc0)
+                return skip(2);
+            if (len & 0xc0)
+                return skip(size);  // Reserved label types
+            skip(len + 1u);
+            if (len == 0)
+                return;
+        }
+    }
+};
+
+struct dns_reply
+{
+    boost::system::error_code ec;
+    bool truncated{false};
+    std::vector<boost::asio::ip::address> addresses;
+};
+
+// Interprets a reply to query. Answers that are not of the queried type,
+// like the CNAMEs leading to the addresses, are skipped
+inline dns_reply parse_dns_reply(
+    const std::vector<unsigned char>& query,
+    const unsigned char* data,
+    std::size_t size
+)
+{
+    namespace error = boost::asio::error;
+    dns_reply res;
+    dns_message_reader reader{data, size};
+    std::uint16_t id = reader.read16();
+    std::uint16_t flags = reader.read16();
+    std::uint16_t qdcount = reader.read16();
+    std::uint16_t ancount = reader.read16();
+    reader.skip(4);  // NSCOUNT, ARCOUNT
+
+    // Must be a reply (QR) to our query, with our question
+    std::size_t question_size = query.size() - dns_header_size;
+    auto same_char = [](unsigned char lhs, unsigned char rhs) {
+        return std::tolower(lhs) == std::tolower(rhs);
+    };
+    if (!reader.ok || id != ((query[0] << 8) | query[1]) || !(flags & 0x8000) || qdcount != 1 ||
+        size - reader.pos < question_size ||
+        !std::equal(query.begin() + dns_header_size, query.end(), data + reader.pos, same_char))
+    {
+        res.ec = error::no_recovery;
+        return res;
+    }
+    reader.skip(question_size);
+
+    if (flags & 0x0200)
+    {
+        res.truncated = true;
+        res.ec = error::no_recovery;
+        return res;
+    }
+    switch (flags & 0x000f)
+    {
+    case 0: break;
+    case 2: res.ec = error::host_not_found_try_again; return res;  // SERVFAIL
+    case 3: res.ec = error::host_not_found; return res;            // NXDOMAIN
+    default: res.ec = error::no_recovery; return res;               // REFUSED, FORMERR...
+    }
+
+    std::size_t qtype_pos = query.size() - 4;
+    auto qtype = static_cast<std::uint16_t>((query[qtype_pos] << 8) | query[qtype_pos + 1]);
+    for (std::uint16_t i = 0; i < ancount && reader.ok; ++i)
+    {
+        reader.skip_name();
+        std::uint16_t type = reader.read16();
+        std::uint16_t klass = reader.read16();
+        reader.skip(4);  // TTL
+        std::uint16_t rdlength = reader.read16();
+        std::size_t rdata_pos = reader.pos;
+        reader.skip(rdlength);
+        if (!reader.ok || type != qtype || klass != dns_class_in)
+            continue;
+
+        if (type == dns_type_a && rdlength == 4)
+        {
+            boost::asio::ip::address_v4::bytes_type bytes;
+            std::copy_n(data + rdata_pos, bytes.size(), bytes.begin());
+            res.addresses.emplace_back(boost::asio::ip::address_v4(bytes));
+        }
+        else if (type == dns_type_aaaa && rdlength == 16)
+        {
+            boost::asio::ip::address_v6::bytes_type bytes;
+            std::copy_n(data + rdata_pos, bytes.size(), bytes.begin());
+            res.addresses.emplace_back(boost::asio::ip::address_v6(bytes));
+        }
+    }
+
+    if (!reader.ok)
+        res.ec = error::no_recovery;
+    else if (res.addresses.empty())
+        res.ec = error::no_data;  // The name exists, but has no addresses of this family
+    return res;
+}
+
+// The I/O objects and buffers of a query. They don't move while operations are in progress
+struct dns_query_state
+{
+    boost::asio::ip::udp::socket udp_sock;
+    boost::asio::ip::tcp::socket tcp_sock;
+    boost::asio::steady_timer timer;
+    std::vector<unsigned char> query;
+    std::vector<unsigned char> reply;
+    std::array<unsigned char, 2> tcp_length{};  // Messages over TCP are prefixed by their length
+
+    dns_query_state(const boost::asio::any_io_executor& ex, std::vector<unsigned char> q)
+        : udp_sock(ex), tcp_sock(ex), timer(ex), query(std::move(q))
+    {
+    }
+};
+
+// Sends the query to server over UDP, and waits for the reply with the same ID
+struct dns_udp_exchange_op
+{
+    dns_query_state& st;
+    boost::asio::ip::udp::endpoint server;
+    bool sent{false};
+
+    template <class Self>
+    void operator()(Self& self)
+    {
+        // A fresh source port for every attempt. Connecting the socket filters out datagrams
+        // from other sources, and makes ICMP errors (like port unreachable) fail the receive
+        boost::system::error_code ec;
+        st.udp_sock.close(ec);
+        st.udp_sock.open(server.protocol(), ec);
+        if (!ec)
+            st.udp_sock.connect(server, ec);
+        if (ec)
+        {
+            return boost::asio::post(
+                st.udp_sock.get_executor(),
+                boost::asio::append(std::move(self), ec, std::size_t(0))
+            );
+        }
+        st.udp_sock.async_send(boost::asio::buffer(st.query), std::move(self));
+    }
+
+    template <class Self>
+    void operator()(Self& self, boost::system::error_code ec, std::size_t n)
+    {
+        if (ec)
+            return self.complete(ec, 0);
+
+        // Datagrams with another ID are forged, or replies to something else. Keep waiting
+        if (sent && n >= 2 && st.reply[0] == st.query[0] && st.reply[1] == st.query[1])
+            return self.complete(ec, n);
+        sent = true;
+        st.reply.resize(dns_max_udp_size);
+        st.udp_sock.async_receive(boost::asio::buffer(st.reply), std::move(self));
+    }
+};
+
+inline auto async_dns_udp_exchange(dns_query_state& st, const boost::asio::ip::udp::endpoint& server)
+{
+    return boost::asio::async_compose<
+        const boost::asio::deferred_t,
+        void(boost::system::error_code, std::size_t)>(
+        dns_udp_exchange_op{st, server},
+        boost::asio::deferred,
+        st.udp_sock
+    );
+}
+
+// Sends the query to server over TCP, and reads the reply
+struct dns_tcp_exchange_op
+{
+    dns_query_state& st;
+    boost::asio::ip::tcp::endpoint server;
+
+    enum class state_t
+    {
+        writing,
+        reading_length,
+        reading_message,
+    } state{state_t::writing};
+
+    template <class Self>
+    void operator()(Self& self)
+    {
+        boost::system::error_code ignored;
+        st.tcp_sock.close(ignored);
+        st.tcp_sock.async_connect(server, std::move(self));
+    }
+
+    // Connected
+    template <class Self>
+    void operator()(Self& self, boost::system::error_code ec)
+    {
+        if (ec)
+            return self.complete(ec, 0);
+        st.tcp_length[0] = static_cast<unsigned char>(st.query.size() >> 8);
+        st.tcp_length[1] = static_cast<unsigned char>(st.query.size() & 0xff);
+        std::array<boost::asio::const_buffer, 2> buffers{
+            boost::asio::buffer(st.tcp_length),
+            boost::asio::buffer(st.query),
+        };
+        boost::asio::async_write(st.tcp_sock, buffers, std::move(self));
+    }
+
+    template <class Self>
+    void operator()(Self& self, boost::system::error_code ec, std::size_t n)
+    {
+        if (ec)
+            return self.complete(ec, 0);
+        switch (state)
+        {
+        case state_t::writing:
+            state = state_t::reading_length;
+            return boost::asio::async_read(st.tcp_sock, boost::asio::buffer(st.tcp_length), std::move(self));
+        case state_t::reading_length:
+            state = state_t::reading_message;
+            st.reply.resize((st.tcp_length[0] << 8) | st.tcp_length[1]);
+            return boost::asio::async_read(st.tcp_sock, boost::asio::buffer(st.reply), std::move(self));
+        case state_t::reading_message:
+            st.tcp_sock.close(ec);
+            return self.complete(boost::system::error_code(), n);
+        }
+    }
+};
+
+inline auto async_dns_tcp_exchange(dns_query_state& st, const boost::asio::ip::udp::endpoint& server)
+{
+    return boost::asio::async_compose<
+        const boost::asio::deferred_t,
+        void(boost::system::error_code, std::size_t)>(
+        dns_tcp_exchange_op{st, boost::asio::ip::tcp::endpoint(server.address(), server.port())},
+        boost::asio::deferred,
+        st.tcp_sock
+    );
+}
+
+// Looks up the addresses of a single type. Each attempt races the exchange with a server against the timer.
+// Completes with a definitive answer (addresses, host_not_found or no_data), or the last error
+// once all the attempts have failed
+struct dns_query_op
+{
+    const dns_resolver_config& cfg;
+    std::mt19937& rng;
+    std::unique_ptr<dns_query_state> st;
+    std::size_t attempt{0};
+    std::size_t server_index{0};
+    bool over_tcp{false};
+    boost::system::error_code last_error{boost::asio::error::host_not_found_try_again};
+
+    template <class Self>
+    void start_attempt(Self& self)
+    {
+        if (attempt == cfg.attempts * cfg.nameservers.size())
+            return self.complete(last_error, std::vector<boost::asio::ip::address>());
+        server_index = attempt++ % cfg.nameservers.size();
+        over_tcp = false;
+
+        // A new random ID per attempt, so late replies to the previous ones are ignored
+        auto id = static_cast<std::uint16_t>(rng());
+        st->query[0] = static_cast<unsigned char>(id >> 8);
+        st->query[1] = static_cast<unsigned char>(id & 0xff);
+
+        st->timer.expires_after(cfg.timeout);
+        boost::asio::experimental::make_parallel_group(
+            async_dns_udp_exchange(*st, cfg.nameservers[server_index]),
+            st->timer.async_wait(boost::asio::deferred)
+        )
+            .async_wait(boost::asio::experimental::wait_for_one(), std::move(self));
+    }
+
+    template <class Self>
+    void operator()(Self& self)
+    {
+        start_attempt(self);
+    }
+
+    // The exchange finished, or the timer expired
+    template <class Self>
+    void operator()(
+        Self& self,
+        std::array<std::size_t, 2> completion_order,
+        boost::system::error_code exchange_ec,
+        std::size_t n,
+        boost::system::error_code
+    )
+    {
+        if (self.get_cancellation_state().cancelled() != boost::asio::cancellation_type::none)
+        {
+            return self.complete(
+                boost::asio::error::operation_aborted,
+                std::vector<boost::asio::ip::address>()
+            );
+        }
+        if (completion_order[0] == 1)
+        {
+            last_error = boost::asio::error::timed_out;
+            return start_attempt(self);
+        }
+        if (exchange_ec)
+        {
+            last_error = exchange_ec;
+            return start_attempt(self);
+        }
+
+        dns_reply reply = parse_dns_reply(st->query, st->reply.data(), n);
+        if (reply.truncated && !over_tcp)
+        {
+            // Ask the same server again, over TCP
+            over_tcp = true;
+            st->timer.expires_after(cfg.timeout);
+            boost::asio::experimental::make_parallel_group(
+                async_dns_tcp_exchange(*st, cfg.nameservers[server_index]),
+                st->timer.async_wait(boost::asio::deferred)
+            )
+                .async_wait(boost::asio::experimental::wait_for_one(), std::move(self));
+            return;
+        }
+
+        // A definitive answer. Other errors may be specific to this server, so try the next one
+        namespace error = boost::asio::error;
+        if (!reply.ec || reply.ec == error::host_not_found || reply.ec == error::no_data)
+            return self.complete(reply.ec, std::move(reply.addresses));
+        last_error = reply.ec;
+        start_attempt(self);
+    }
+};
+
+// Signature: void(error_code, std::vector<ip::address>). name must be valid
+inline auto async_dns_query(
+    const boost::asio::any_io_executor& ex,
+    const dns_resolver_config& cfg,
+    std::mt19937& rng,
+    std::string_view name,
+    std::uint16_t qtype
+)
+{
+    return boost::asio::async_compose<
+        const boost::asio::deferred_t,
+        void(boost::system::error_code, std::vector<boost::asio::ip::address>)>(
+        dns_query_op{cfg, rng, std::make_unique<dns_query_state>(ex, build_dns_query(name, qtype))},
+        boost::asio::deferred,
+        ex
+    );
+}
+
+// Port numbers, and the services used by the examples
+inline std::optional<unsigned short> parse_dns_service(std::string_view service)
+{
+    if (service.empty())
+        return 0;
+    if (service == "http")
+        return 80;
+    if (service == "https")
+        return 443;
+    unsigned short res = 0;
+    auto [ptr, ec] = std::from_chars(service.data(), service.data() + service.size(), res);
+    if (ec != std::errc() || ptr != service.data() + service.size())
+        return std::nullopt;
+    return res;
+}
+
+}  // namespace detail
+
+class dns_resolver
+{
+public:
+    using results_type = boost::asio::ip::tcp::resolver::results_type;
+    using signature = void(boost::system::error_code, results_type);
+    using executor_type = boost::asio::any_io_executor;
+
+private:
+    boost::asio::any_io_executor ex_;
+    dns_resolver_config cfg_;
+    std::mt19937 rng_{std::random_device{}()};
+
+    struct resolve_op
+    {
+        dns_resolver& resolv;
+        std::string host;
+        std::string service;
+        unsigned short port{0};
+        std::vector<boost::asio::ip::tcp::endpoint> endpoints{};
+
+        template <class Self>
+        void operator()(Self& self)
+        {
+            namespace error = boost::asio::error;
+            auto post_result = [&self, this](boost::system::error_code ec) {
+                boost::asio::post(resolv.ex_, boost::asio::append(std::move(self), ec));
+            };
+
+            auto parsed_port = detail::parse_dns_service(service);
+            if (!parsed_port)
+                return post_result(error::service_not_found);
+            port = *parsed_port;
+
+            // IP addresses don't need a lookup
+            boost::system::error_code ec;
+            auto addr = boost::asio::ip::make_address(host, ec);
+            if (!ec)
+            {
+                endpoints.emplace_back(addr, port);
+                return post_result(boost::system::error_code());
+            }
+            if (!detail::is_valid_dns_name(host))
+                return post_result(error::host_not_found);
+
+            boost::asio::experimental::make_parallel_group(
+                detail::async_dns_query(resolv.ex_, resolv.cfg_, resolv.rng_, host, detail::dns_type_aaaa),
+                detail::async_dns_query(resolv.ex_, resolv.cfg_, resolv.rng_, host, detail::dns_type_a)
+            )
+                .async_wait(boost::asio::experimental::wait_for_all(), std::move(self));
+        }
+
+        // Both queries finished. A name with addresses of a single family is fine
+        template <class Self>
+        void operator()(
+            Self& self,
+            std::array<std::size_t, 2>,
+            boost::system::error_code ec_v6,
+            std::vector<boost::asio::ip::address> addrs_v6,
+            boost::system::error_code ec_v4,
+            std::vector<boost::asio::ip::address> addrs_v4
+        )
+        {
+            namespace error = boost::asio::error;
+            for (const auto* addrs : {&addrs_v6, &addrs_v4})
+            {
+                for (const auto& addr : *addrs)
+                    endpoints.emplace_back(addr, port);
+            }
+
+            boost::system::error_code ec;
+            if (endpoints.empty())
+            {
+                if (ec_v6 == error::operation_aborted || ec_v4 == error::operation_aborted)
+                    ec = error::operation_aborted;
+                else if (ec_v6 == error::host_not_found || ec_v4 == error::host_not_found)
+                    ec = error::host_not_found;
+                else if (ec_v4 && ec_v4 != error::no_data)
+                    ec = ec_v4;
+                else if (ec_v6 && ec_v6 != error::no_data)
+                    ec = ec_v6;
+                else
+                    ec = error::host_not_found;  // Neither A nor AAAA records
+            }
+            (*this)(self, ec);
+        }
+
+        template <class Self>
+        void operator()(Self& self, boost::system::error_code ec)
+        {
+            if (ec)
+                return self.complete(ec, results_type());
+            self.complete(ec, results_type::create(endpoints.begin(), endpoints.end(), host, service));
+        }
+    };
+
+public:
+    // ex is used to run lookups. The configuration is read from /etc/resolv.conf by default
+    explicit dns_resolver(boost::asio::any_io_executor ex, dns_resolver_config cfg = read_resolv_conf())
+        : ex_(std::move(ex)), cfg_(std::move(cfg))
+    {
+        if (cfg_.nameservers.empty())
+            cfg_.nameservers.emplace_back(boost::asio::ip::address_v4::loopback(), 53);
+        cfg_.attempts = std::max(cfg_.attempts, 1u);
+    }
+
+    dns_resolver(const dns_resolver&) = delete;
+    dns_resolver& operator=(const dns_resolver&) = delete;
+
+    executor_type get_executor() const noexcept { return ex_; }
+    const dns_resolver_config& config() const noexcept { return cfg_; }
+
+    // The resolver must outlive the operation
+    template <boost::asio::completion_token_for<signature> CompletionToken>
+    auto async_resolve(std::string_view host, std::string_view service, CompletionToken&& token)
+    {
+        return boost::asio::async_compose<CompletionToken, signature>(
+            resolve_op{*this, std::string(host), std::string(service)},
+            token,
+            ex_
+        );
+    }
+};
+
+#endif
@@ -0,0 +1,356 @@
+#include <boost/asio/as_tuple.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/address.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <set>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "dns_resolver.hpp"
+
+// Checks dns_resolver against a stand-in DNS server, and compares its lookups/s with tcp::resolver.
+//
+// The stand-in server runs in another thread, on the same UDP and TCP port of 127.0.0.1.
+// It answers A queries with 127.0.0.1 and AAAA queries with ::1, unless the name starts with:
+//   - nx.: the name doesn't exist (NXDOMAIN).
+//   - tc.: replies over UDP are truncated, so the resolver must repeat the query over TCP.
+//   - drop.: the first query for each name and type gets no reply, so the resolver must retry.
+//   - blackhole.: queries never get a reply, so the lookup times out.
+//
+// Then it measures lookups/s of dns_resolver against the stand-in server, which is the cost
+// of the resolver itself, and of dns_resolver and tcp::resolver looking up --host with the name servers
+// in /etc/resolv.conf. tcp::resolver runs getaddrinfo in a background thread, one lookup at a time.
+// Exits with a non-zero status if a check fails.
+// Usage: dns_resolver_bench [options]
+//   --host <host>          Name to look up with the system's name servers (default: example.com)
+//   --lookups <n>          Lookups per benchmark (default: 1000)
+//   --concurrency <n>      Lookups in flight (default: 32)
+
+namespace asio = boost::asio;
+using boost::system::error_code;
+using asio::ip::tcp;
+using asio::ip::udp;
+
+class stand_in_dns_server
+{
+    asio::io_context ctx_{1};
+    udp::socket udp_sock_{ctx_, udp::endpoint(asio::ip::address_v4::loopback(), 0)};
+    udp::endpoint endpoint_{udp_sock_.local_endpoint()};
+    tcp::acceptor acceptor_{ctx_, tcp::endpoint(endpoint_.address(), endpoint_.port())};
+    std::set<std::string> dropped_;  // Name and type of the queries dropped so far
+    std::thread thread_;
+
+    static bool starts_with(std::string_view name, std::string_view prefix)
+    {
+        return name.rfind(prefix, 0) == 0;
+    }
+
+    // The reply to query, or an empty vector for no reply
+    std::vector<unsigned char> make_reply(const unsigned char* query, std::size_t size, bool over_udp)
+    {
+        // The header is followed by the question: the name as a sequence of labels, QTYPE and QCLASS
+        std::string name;
+        std::size_t pos = detail::dns_header_size;
+        while (pos < size && query[pos] != 0)
+        {
+            std::size_t len = query[pos];
+            if (size - pos - 1 < len)
+                return {};
+            name.append(reinterpret_cast<const char*>(query + pos + 1), len).push_back('.');
+            pos += len + 1;
+        }
+        if (pos >= size || size - pos < 5)
+            return {};
+        auto qtype = static_cast<std::uint16_t>((query[pos + 1] << 8) | query[pos + 2]);
+
+        if (starts_with(name, "blackhole."))
+            return {};
+        if (starts_with(name, "drop.") && dropped_.insert(name + std::to_string(qtype)).second)
+            return {};
+
+        // The header and the question, with QR, RD and RA set
+        bool truncate = over_udp && starts_with(name, "tc.");
+        bool nxdomain = starts_with(name, "nx.");
+        std::vector<unsigned char> res(query, query + pos + 5);
+        res[2] = 0x81 | (truncate ? 0x02 : 0);
+        res[3] = 0x80 | (nxdomain ? 3 : 0);
+        std::fill(res.begin() + 6, res.begin() + detail::dns_header_size, 0);
+        if (truncate || nxdomain)
+            return res;
+
+        std::vector<unsigned char> rdata;
+        if (qtype == detail::dns_type_a)
+        {
+            auto bytes = asio::ip::address_v4::loopback().to_bytes();
+            rdata.assign(bytes.begin(), bytes.end());
+        }
+        else if (qtype == detail::dns_type_aaaa)
+        {
+            auto bytes = asio::ip::address_v6::loopback().to_bytes();
+            rdata.assign(bytes.begin(), bytes.end());
+        }
+        else
+        {
+            return res;  // No records of this type
+        }
+
+        // A single answer. The name is a pointer to the one in the question, and the TTL is 60s
+        res[7] = 1;
+        unsigned char answer[] = {
+            0xc0,
+            static_cast<unsigned char>(detail::dns_header_size),
+            static_cast<unsigned char>(qtype >> 8),
+            static_cast<unsigned char>(qtype & 0xff),
+            0,
+            detail::dns_class_in,
+            0,
+            0,
+            0,
+            60,
+            0,
+            static_cast<unsigned char>(rdata.size()),
+        };
+        res.insert(res.end(), std::begin(answer), std::end(answer));
+        res.insert(res.end(), rdata.begin(), rdata.end());
+        return res;
+    }
+
+    asio::awaitable<void> serve_udp()
+    {
+        constexpr auto tok = asio::as_tuple(asio::deferred);
+        std::array<unsigned char, detail::dns_max_udp_size> buff;
+        udp::endpoint client;
+        while (true)
+        {
+            auto [ec, n] = co_await udp_sock_.async_receive_from(asio::buffer(buff), client, tok);
+            if (ec == asio::error::operation_aborted)
+                co_return;
+            if (ec)
+                continue;
+            auto reply = make_reply(buff.data(), n, true);
+            if (!reply.empty())
+                co_await udp_sock_.async_send_to(asio::buffer(reply), client, tok);
+        }
+    }
+
+    // Messages over TCP are prefixed by their length
+    asio::awaitable<void> serve_tcp_session(tcp::socket sock)
+    {
+        constexpr auto tok = asio::as_tuple(asio::deferred);
+        std::array<unsigned char, 2> length{};
+        std::vector<unsigned char> query;
+        while (true)
+        {
+            auto [ec, n] = co_await asio::async_read(sock, asio::buffer(length), tok);
+            if (ec)
+                co_return;
+            query.resize((length[0] << 8) | length[1]);
+            auto [ec2, n2] = co_await asio::async_read(sock, asio::buffer(query), tok);
+            if (ec2)
+                co_return;
+            auto reply = make_reply(query.data(), query.size(), false);
+            if (reply.empty())
+                continue;
+            length[0] = static_cast<unsigned char>(reply.size() >> 8);
+            length[1] = static_cast<unsigned char>(reply.size() & 0xff);
+            std::array<asio::const_buffer, 2> buffers{asio::buffer(length), asio::buffer(reply)};
+            auto [ec3, n3] = co_await asio::async_write(sock, buffers, tok);
+            if (ec3)
+                co_return;
+        }
+    }
+
+    asio::awaitable<void> serve_tcp()
+    {
+        while (true)
+        {
+            auto [ec, sock] = co_await acceptor_.async_accept(asio::as_tuple(asio::deferred));
+            if (ec)
+                co_return;
+            asio::co_spawn(ctx_, serve_tcp_session(std::move(sock)), asio::detached);
+        }
+    }
+
+public:
+    stand_in_dns_server()
+    {
+        asio::co_spawn(ctx_, serve_udp(), asio::detached);
+        asio::co_spawn(ctx_, serve_tcp(), asio::detached);
+        thread_ = std::thread([this] { ctx_.run(); });
+    }
+
+    ~stand_in_dns_server()
+    {
+        ctx_.stop();
+        thread_.join();
+    }
+
+    udp::endpoint endpoint() const { return endpoint_; }
+};
+
+struct check_case
+{
+    std::string_view host;
+    error_code expected;
+    std::size_t num_endpoints;
+};
+
+static bool run_checks(udp::endpoint server)
+{
+    const check_case cases[] = {
+        {"example.test", error_code(), 2},
+        {"tc.example.test", error_code(), 2},
+        {"drop.example.test", error_code(), 2},
+        {"nx.example.test", asio::error::host_not_found, 0},
+        {"blackhole.example.test", asio::error::timed_out, 0},
+        {"192.0.2.1", error_code(), 1},
+        {"bad..name", asio::error::host_not_found, 0},
+    };
+
+    asio::io_context ctx;
+    dns_resolver_config cfg;
+    cfg.nameservers = {server};
+    cfg.timeout = std::chrono::milliseconds(200);
+    dns_resolver resolv(ctx.get_executor(), cfg);
+    bool ok = true;
+
+    asio::co_spawn(
+        ctx,
+        [&]() -> asio::awaitable<void> {
+            for (const auto& c : cases)
+            {
+                constexpr auto tok = asio::as_tuple(asio::deferred);
+                auto [ec, results] = co_await resolv.async_resolve(c.host, "80", tok);
+                bool passed = ec == c.expected && results.size() == c.num_endpoints;
+                ok = ok && passed;
+                std::cout << (passed ? "  ok      " : "  FAILED  ") << c.host << ": " << ec.message() << ", "
+                          << results.size() << " endpoints" << std::endl;
+            }
+        },
+        [](std::exception_ptr exc) {
+            if (exc)
+                std::rethrow_exception(exc);
+        }
+    );
+    ctx.run();
+    return ok;
+}
+
+struct bench_config
+{
+    std::string host{"example.com"};
+    std::size_t total_lookups{1000};
+    std::size_t concurrency{32};
+};
+
+template <class Resolver>
+static asio::awaitable<void> worker(
+    Resolver& resolv,
+    std::string_view host,
+    std::size_t& remaining,
+    std::size_t& errors
+)
+{
+    while (remaining > 0)
+    {
+        --remaining;
+        auto [ec, results] = co_await resolv.async_resolve(host, "80", asio::as_tuple(asio::deferred));
+        if (ec)
+            ++errors;
+    }
+}
+
+// Resolver is tcp::resolver or dns_resolver. args are passed to its constructor after the executor
+template <class Resolver, class... Args>
+static void run_benchmark(
+    std::string_view name,
+    const bench_config& cfg,
+    std::string_view host,
+    Args&&... args
+)
+{
+    asio::io_context ctx;
+    Resolver resolv(ctx.get_executor(), std::forward<Args>(args)...);
+    std::size_t remaining = cfg.total_lookups;
+    std::size_t errors = 0;
+
+    for (std::size_t i = 0; i < cfg.concurrency; ++i)
+    {
+        asio::co_spawn(ctx, worker(resolv, host, remaining, errors), [](std::exception_ptr exc) {
+            if (exc)
+                std::rethrow_exception(exc);
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    ctx.run();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    auto lookups_per_second = static_cast<long>(cfg.total_lookups / elapsed.count());
+    std::cout << "  " << name << ": " << lookups_per_second << " lookups/s";
+    if (errors)
+        std::cout << " (" << errors << " errors)";
+    std::cout << std::endl;
+}
+
+static void usage(const char* program)
+{
+    std::cerr << "Usage: " << program << " [--host <host>] [--lookups <n>] [--concurrency <n>]\n";
+    std::exit(1);
+}
+
+int main(int argc, char** argv)
+{
+    bench_config cfg;
+    for (int i = 1; i < argc; i += 2)
+    {
+        if (i + 1 >= argc)
+            usage(argv[0]);
+        std::string_view opt = argv[i];
+        const char* value = argv[i + 1];
+        if (opt == "--host")
+            cfg.host = value;
+        else if (opt == "--lookups")
+            cfg.total_lookups = std::stoul(value);
+        else if (opt == "--concurrency")
+            cfg.concurrency = std::max<std::size_t>(std::stoul(value), 1u);
+        else
+            usage(argv[0]);
+    }
+
+    stand_in_dns_server server;
+    std::cout << "Checks against the stand-in server:\n";
+    bool ok = run_checks(server.endpoint());
+
+    dns_resolver_config stand_in_cfg;
+    stand_in_cfg.nameservers = {server.endpoint()};
+    std::cout << "Stand-in server:\n";
+    run_benchmark<dns_resolver>("dns_resolver ", cfg, "example.test", stand_in_cfg);
+
+    std::cout << "System name servers, looking up " << cfg.host << ":\n";
+    run_benchmark<dns_resolver>("dns_resolver ", cfg, cfg.host, read_resolv_conf());
+    run_benchmark<tcp::resolver>("tcp::resolver", cfg, cfg.host);
+
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,143 @@
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http/buffer_body.hpp>
+#include <boost/beast/http/empty_body.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/beast/http/parser.hpp>
+#include <boost/beast/http/read.hpp>
+#include <boost/beast/http/write.hpp>
+#include <boost/none.hpp>
+
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "example_target.hpp"
+#include "file_download.hpp"
+#include "http_response_parser.hpp"
+
+// Downloads a resource to a file. The body is written as it arrives, so it's never in memory as a whole.
+//   - asio: the client from coroutines.cpp, with http_response_parser and async_download_body.
+//   - beast: the client from beast.cpp. Beast parses the headers, and async_download_body does the rest.
+//   - splice: like asio, but with async_splice_body. The body isn't copied to user space.
+// For example, to download 1GB from the local server:
+//   EXAMPLES_HOST=127.0.0.1 EXAMPLES_PORT=8080 ./download asio out.bin "/?size=1073741824"
+//
+// Usage: download <asio|beast|splice> <output file> [target]
+
+namespace asio = boost::asio;
+namespace beast = boost::beast;
+namespace http = beast::http;
+
+struct download_config
+{
+    std::string mode;
+    std::string path;
+    std::string target{"/"};
+};
+
+static asio::awaitable<void> download_asio(const download_config& cfg)
+{
+    auto ex = co_await asio::this_coro::executor;
+    asio::ip::tcp::socket sock(ex);
+    asio::ip::tcp::resolver resolv(ex);
+    const char* host = example_host("example.com");
+
+    auto endpoints = co_await resolv.async_resolve(host, example_port(), asio::deferred);
+    co_await asio::async_connect(sock, endpoints, asio::deferred);
+    std::string req = "GET " + cfg.target + " HTTP/1.1\r\nHost: " + host + "\r\nUser-Agent: Asio\r\n\r\n";
+    co_await asio::async_write(sock, asio::buffer(req), asio::deferred);
+
+    // Read the headers
+    http_response_parser parser;
+    co_await async_read_response_header(sock, parser, asio::deferred);
+    if (!parser.content_length())
+        throw std::runtime_error("The response has no Content-Length");
+    std::uint64_t body_size = *parser.content_length();
+    asio::const_buffer prefix = asio::buffer(parser.body_prefix());
+
+    // Write the body to the file
+    download_file file = open_download_file(ex, cfg.path);
+    std::uint64_t written = 0;
+    if (cfg.mode == "splice")
+        written = co_await async_splice_body(sock, prefix, body_size, file.native_handle(), asio::deferred);
+    else
+        written = co_await async_download_body(sock, prefix, body_size, file, {}, asio::deferred);
+    std::cout << "Status " << parser.status_code() << ", " << written << " bytes written to " << cfg.path
+              << std::endl;
+}
+
+static asio::awaitable<void> download_beast(const download_config& cfg)
+{
+    auto ex = co_await asio::this_coro::executor;
+    asio::ip::tcp::socket sock(ex);
+    asio::ip::tcp::resolver resolv(ex);
+    const char* host = example_host("python.org");
+
+    auto endpoints = co_await resolv.async_resolve(host, example_port(), asio::deferred);
+    co_await asio::async_connect(sock, endpoints, asio::deferred);
+    http::request<http::empty_body> req{http::verb::get, cfg.target, 11};
+    req.set(http::field::host, host);
+    req.set(http::field::user_agent, "Beast");
+    co_await http::async_write(sock, req, asio::deferred);
+
+    // Beast parses the headers. The body limit applies to the Content-Length, so disable it
+    beast::flat_buffer buff;
+    http::response_parser<http::buffer_body> parser;
+    parser.body_limit(boost::none);
+    co_await http::async_read_header(sock, buff, parser, asio::deferred);
+    if (parser.chunked() || !parser.content_length())
+        throw std::runtime_error("The response has no Content-Length");
+
+    // The body bytes that Beast read after the headers are left in buff
+    download_file file = open_download_file(ex, cfg.path);
+    std::uint64_t written = co_await async_download_body(
+        sock,
+        buff.data(),
+        *parser.content_length(),
+        file,
+        download_options{},
+        asio::deferred
+    );
+    std::cout << "Status " << parser.get().result_int() << ", " << written << " bytes written to " << cfg.path
+              << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: " << argv[0] << " <asio|beast|splice> <output file> [target]\n";
+        return EXIT_FAILURE;
+    }
+
+    download_config cfg{argv[1], argv[2]};
+    if (argc > 3)
+        cfg.target = argv[3];
+
+    asio::io_context ctx;
+    auto on_done = [](std::exception_ptr exc) {
+        if (exc)
+            std::rethrow_exception(exc);
+    };
+    if (cfg.mode == "beast")
+        asio::co_spawn(ctx, download_beast(cfg), on_done);
+    else if (cfg.mode == "asio" || cfg.mode == "splice")
+        asio::co_spawn(ctx, download_asio(cfg), on_done);
+    else
+        return EXIT_FAILURE;
+    ctx.run();
+}
@@ -0,0 +1,241 @@
+#include <boost/asio/as_tuple.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/completion_condition.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/address.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/write.hpp>
+
+#if defined(BOOST_ASIO_HAS_FILE)
+#include <boost/asio/random_access_file.hpp>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+
+#include <sys/resource.h>
+
+#include "file_download.hpp"
+#include "http_response_parser.hpp"
+
+// Throughput and CPU cost of writing a large response body to disk:
+//
+//   - string: reads the whole body into a std::string, then writes it to the file.
+//   - double buffered: async_download_body, overlapping reads from the socket with writes to the file.
+//     Into a stream_file with io_uring, or a blocking_file with epoll (see file_download.hpp).
+//   - random_access_file: the same, writing with async_write_at. io_uring builds only.
+//   - splice: async_splice_body, which doesn't copy the body to user space.
+//
+// The server runs in another thread. CPU time is measured for the client thread only (user + system).
+// With io_uring, some of the work may happen in kernel threads, which isn't included.
+// Files are written to the page cache, and not flushed: this measures the cost of the client,
+// not the disk. Build with -DENABLE_IO_URING=ON to compare download_bench_uring.
+// Usage: download_bench [size in MB] [output file]
+
+namespace asio = boost::asio;
+using boost::system::error_code;
+using asio::ip::tcp;
+using clock_type = std::chrono::steady_clock;
+
+// CPU time used by the calling thread
+static std::chrono::duration<double> thread_cpu_time()
+{
+    rusage usage{};
+    getrusage(RUSAGE_THREAD, &usage);
+    auto to_seconds = [](timeval tv) { return tv.tv_sec + tv.tv_usec / 1e6; };
+    return std::chrono::duration<double>(to_seconds(usage.ru_utime) + to_seconds(usage.ru_stime));
+}
+
+// Answers every request on the connection with body_size bytes
+static asio::awaitable<void> serve_session(tcp::socket sock, std::uint64_t body_size)
+{
+    constexpr auto tok = asio::as_tuple(asio::deferred);
+    static const std::string pattern(256 * 1024, 'x');
+    std::string buff;
+    while (true)
+    {
+        auto [ec, n] = co_await asio::async_read_until(sock, asio::dynamic_buffer(buff), "\r\n\r\n", tok);
+        if (ec)
+            co_return;
+        buff.erase(0, n);
+        std::string header = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body_size) + "\r\n\r\n";
+        auto [ec2, written] = co_await asio::async_write(sock, asio::buffer(header), tok);
+        if (ec2)
+            co_return;
+        for (std::uint64_t remaining = body_size; remaining > 0;)
+        {
+            auto chunk = static_cast<std::size_t>(std::min<std::uint64_t>(remaining, pattern.size()));
+            auto [ec3, n3] = co_await asio::async_write(sock, asio::buffer(pattern, chunk), tok);
+            if (ec3)
+                co_return;
+            remaining -= n3;
+        }
+    }
+}
+
+static asio::awaitable<void> run_server(tcp::acceptor& acceptor, std::uint64_t body_size)
+{
+    while (true)
+    {
+        auto [ec, sock] = co_await acceptor.async_accept(asio::as_tuple(asio::deferred));
+        if (ec)
+            co_return;
+        asio::co_spawn(acceptor.get_executor(), serve_session(std::move(sock), body_size), asio::detached);
+    }
+}
+
+//
+// The variants. Each one gets a socket with the response headers already read
+//
+
+static asio::awaitable<std::uint64_t> download_string(
+    tcp::socket& sock,
+    http_response_parser& parser,
+    const std::string& path
+)
+{
+    std::uint64_t body_size = *parser.content_length();
+    std::string body(parser.body_prefix());
+    body.reserve(body_size);
+    co_await asio::async_read(
+        sock,
+        asio::dynamic_buffer(body),
+        asio::transfer_exactly(body_size - body.size()),
+        asio::deferred
+    );
+    download_file file = open_download_file(sock.get_executor(), path);
+    co_return co_await asio::async_write(file, asio::buffer(body), asio::deferred);
+}
+
+static asio::awaitable<std::uint64_t> download_double_buffered(
+    tcp::socket& sock,
+    http_response_parser& parser,
+    const std::string& path
+)
+{
+    download_file file = open_download_file(sock.get_executor(), path);
+    co_return co_await async_download_body(
+        sock,
+        asio::buffer(parser.body_prefix()),
+        *parser.content_length(),
+        file,
+        download_options{},
+        asio::deferred
+    );
+}
+
+#if defined(BOOST_ASIO_HAS_FILE)
+static asio::awaitable<std::uint64_t> download_random_access(
+    tcp::socket& sock,
+    http_response_parser& parser,
+    const std::string& path
+)
+{
+    asio::random_access_file file(
+        sock.get_executor(),
+        path,
+        asio::random_access_file::write_only | asio::random_access_file::create |
+            asio::random_access_file::truncate
+    );
+    co_return co_await async_download_body(
+        sock,
+        asio::buffer(parser.body_prefix()),
+        *parser.content_length(),
+        file,
+        download_options{},
+        asio::deferred
+    );
+}
+#endif
+
+static asio::awaitable<std::uint64_t> download_splice(
+    tcp::socket& sock,
+    http_response_parser& parser,
+    const std::string& path
+)
+{
+    download_file file = open_download_file(sock.get_executor(), path);
+    co_return co_await async_splice_body(
+        sock,
+        asio::buffer(parser.body_prefix()),
+        *parser.content_length(),
+        file.native_handle(),
+        asio::deferred
+    );
+}
+
+using download_function = asio::awaitable<std::uint64_t> (*)(
+    tcp::socket&,
+    http_response_parser&,
+    const std::string&
+);
+
+static void run(std::string_view name, tcp::endpoint ep, const std::string& path, download_function fn)
+{
+    asio::io_context ctx(1);
+    asio::co_spawn(
+        ctx,
+        [&]() -> asio::awaitable<void> {
+            tcp::socket sock(ctx);
+            co_await sock.async_connect(ep, asio::deferred);
+            constexpr std::string_view req = "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+
+            auto start = clock_type::now();
+            auto cpu_start = thread_cpu_time();
+            co_await asio::async_write(sock, asio::buffer(req), asio::deferred);
+            http_response_parser parser;
+            co_await async_read_response_header(sock, parser, asio::deferred);
+            std::uint64_t written = co_await fn(sock, parser, path);
+            std::chrono::duration<double> elapsed = clock_type::now() - start;
+            auto cpu = thread_cpu_time() - cpu_start;
+
+            double gb = written / (1024.0 * 1024.0 * 1024.0);
+            std::cout << "  " << name << ": " << gb / elapsed.count() << " GB/s, " << cpu.count() / gb
+                      << " CPU seconds/GB" << std::endl;
+        },
+        [](std::exception_ptr exc) {
+            if (exc)
+                std::rethrow_exception(exc);
+        }
+    );
+    ctx.run();
+    std::filesystem::remove(path);
+}
+
+int main(int argc, char** argv)
+{
+    std::uint64_t size_mb = argc > 1 ? std::stoull(argv[1]) : 1024;
+    std::string path = argc > 2 ? argv[2] : "download_bench.tmp";
+
+    asio::io_context server_ctx(1);
+    tcp::acceptor acceptor(server_ctx, tcp::endpoint(asio::ip::make_address("127.0.0.1"), 0));
+    asio::co_spawn(server_ctx, run_server(acceptor, size_mb * 1024 * 1024), asio::detached);
+    std::thread server_thread([&server_ctx] { server_ctx.run(); });
+    tcp::endpoint ep = acceptor.local_endpoint();
+
+    std::cout << "Downloading " << size_mb << "MB to " << path << ":\n";
+    run("string", ep, path, download_string);
+    run("double buffered", ep, path, download_double_buffered);
+#if defined(BOOST_ASIO_HAS_FILE)
+    run("random_access_file", ep, path, download_random_access);
+#endif
+    run("splice", ep, path, download_splice);
+
+    server_ctx.stop();
+    server_thread.join();
+}
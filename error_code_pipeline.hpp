@@ -0,0 +1,202 @@
+#ifndef USINGSTDCPP_2024_ERROR_CODE_PIPELINE_HPP
+#define USINGSTDCPP_2024_ERROR_CODE_PIPELINE_HPP
+
+#include <boost/asio/as_tuple.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/compose.hpp>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http/empty_body.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/beast/http/read.hpp>
+#include <boost/beast/http/string_body.hpp>
+#include <boost/beast/http/write.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <cassert>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// The request from the examples (resolve, connect, write a GET, read the response headers),
+// reporting I/O errors as error_codes. None of these throw because of a failed operation.
+// Awaiting an operation with asio::deferred throws a boost::system::system_error when it fails.
+// That's free when nothing fails, but each throw allocates the exception and unwinds the stack.
+// When a server refuses thousands of connections per second, that adds up.
+// as_tuple.cpp shows the alternative for a coroutine. This file has the three styles:
+//
+//   - request_coroutine_ec: a coroutine that awaits each step with as_tuple(deferred),
+//     and returns the first error.
+//   - async_request_ec: a composed operation completing with (error_code, std::size_t).
+//     Composed operations don't throw by themselves: it's the completion token that decides.
+//     Await it with as_tuple(deferred) or redirect_error to keep the caller exception-free.
+//   - beast_request_coroutine_ec: the request from beast.cpp, with as_tuple(deferred).
+//
+// In all of them, the socket and the buffers belong to the caller and must outlive the request.
+// Errors other than I/O errors (like std::bad_alloc) are still exceptions.
+// error_propagation_bench compares the cost of deferred, as_tuple and redirect_error under failures.
+
+inline boost::asio::awaitable<boost::system::error_code> request_coroutine_ec(
+    boost::asio::ip::tcp::resolver& resolv,
+    boost::asio::ip::tcp::socket& sock,
+    std::string_view host,
+    std::string_view port,
+    std::string_view req,
+    std::string& buff
+)
+{
+    constexpr auto tok = boost::asio::as_tuple(boost::asio::deferred);
+
+    auto [ec1, endpoints] = co_await resolv.async_resolve(host, port, tok);
+    if (ec1)
+        co_return ec1;
+
+    auto [ec2, endpoint] = co_await boost::asio::async_connect(sock, endpoints, tok);
+    if (ec2)
+        co_return ec2;
+
+    auto [ec3, bytes_written] = co_await boost::asio::async_write(sock, boost::asio::buffer(req), tok);
+    if (ec3)
+        co_return ec3;
+
+    auto [ec4, bytes_read] = co_await boost::asio::async_read_until(
+        sock,
+        boost::asio::dynamic_buffer(buff),
+        "\r\n\r\n",
+        tok
+    );
+    co_return ec4;
+}
+
+// The same state machine as handle_request_op in composed.cpp, with a configurable host and port
+struct request_ec_op
+{
+    boost::asio::ip::tcp::resolver& resolv;
+    boost::asio::ip::tcp::socket& sock;
+    std::string_view host;
+    std::string_view port;
+    std::string_view req;
+    std::string& buff;
+
+    enum class state_t
+    {
+        initial,
+        resolving,
+        connecting,
+        writing,
+        reading,
+    } state{state_t::initial};
+
+    template <class Self>
+    void operator()(Self& self)
+    {
+        assert(state == state_t::initial);
+        state = state_t::resolving;
+        resolv.async_resolve(host, port, std::move(self));
+    }
+
+    template <class Self>
+    void operator()(
+        Self& self,
+        boost::system::error_code ec,
+        boost::asio::ip::tcp::resolver::results_type endpoints
+    )
+    {
+        if (ec)
+            return self.complete(ec, 0u);
+        assert(state == state_t::resolving);
+        state = state_t::connecting;
+        boost::asio::async_connect(sock, endpoints, std::move(self));
+    }
+
+    template <class Self>
+    void operator()(Self& self, boost::system::error_code ec, boost::asio::ip::tcp::endpoint)
+    {
+        if (ec)
+            return self.complete(ec, 0u);
+        assert(state == state_t::connecting);
+        state = state_t::writing;
+        boost::asio::async_write(sock, boost::asio::buffer(req), std::move(self));
+    }
+
+    template <class Self>
+    void operator()(Self& self, boost::system::error_code ec, std::size_t bytes_transferred)
+    {
+        if (ec)
+            return self.complete(ec, 0u);
+
+        if (state == state_t::writing)
+        {
+            state = state_t::reading;
+            boost::asio::async_read_until(
+                sock,
+                boost::asio::dynamic_buffer(buff),
+                "\r\n\r\n",
+                std::move(self)
+            );
+        }
+        else
+        {
+            assert(state == state_t::reading);
+            self.complete(boost::system::error_code(), bytes_transferred);
+        }
+    }
+};
+
+// Completes with the error and the size of the response headers in buff
+template <boost::asio::completion_token_for<void(boost::system::error_code, std::size_t)> CompletionToken>
+auto async_request_ec(
+    boost::asio::ip::tcp::resolver& resolv,
+    boost::asio::ip::tcp::socket& sock,
+    std::string_view host,
+    std::string_view port,
+    std::string_view req,
+    std::string& buff,
+    CompletionToken&& token
+)
+{
+    return boost::asio::async_compose<CompletionToken, void(boost::system::error_code, std::size_t)>(
+        request_ec_op{resolv, sock, host, port, req, buff},
+        token,
+        resolv,
+        sock
+    );
+}
+
+// Beast signals malformed responses as error_codes too (http::error), so they don't throw either
+inline boost::asio::awaitable<boost::system::error_code> beast_request_coroutine_ec(
+    boost::asio::ip::tcp::resolver& resolv,
+    boost::asio::ip::tcp::socket& sock,
+    std::string_view host,
+    std::string_view port,
+    const boost::beast::http::request<boost::beast::http::empty_body>& req,
+    boost::beast::flat_buffer& buff,
+    boost::beast::http::response<boost::beast::http::string_body>& res
+)
+{
+    constexpr auto tok = boost::asio::as_tuple(boost::asio::deferred);
+
+    auto [ec1, endpoints] = co_await resolv.async_resolve(host, port, tok);
+    if (ec1)
+        co_return ec1;
+
+    auto [ec2, endpoint] = co_await boost::asio::async_connect(sock, endpoints, tok);
+    if (ec2)
+        co_return ec2;
+
+    auto [ec3, bytes_written] = co_await boost::beast::http::async_write(sock, req, tok);
+    if (ec3)
+        co_return ec3;
+
+    auto [ec4, bytes_read] = co_await boost::beast::http::async_read(sock, buff, res, tok);
+    co_return ec4;
+}
+
+#endif
@@ -0,0 +1,332 @@
+#include <boost/asio/as_tuple.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/address.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/socket_base.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http/empty_body.hpp>
+#include <boost/beast/http/field.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/beast/http/string_body.hpp>
+#include <boost/beast/http/verb.hpp>
+#include <boost/system/error_code.hpp>
+#include <boost/system/system_error.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <exception>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "error_code_pipeline.hpp"
+
+// Throughput of the request pipeline when a fraction of the requests fail, depending on how
+// errors reach the code that handles them:
+//
+//   - deferred: failed operations throw system_error, which is caught around the request.
+//   - as_tuple: request_coroutine_ec from error_code_pipeline.hpp.
+//   - redirect_error: each step stores its error in an error_code variable.
+//   - composed + as_tuple: async_request_ec from error_code_pipeline.hpp, awaited with as_tuple.
+//   - beast + as_tuple: beast_request_coroutine_ec from error_code_pipeline.hpp. Beast reads
+//     the whole response, including its body, and the request is built for each call.
+//
+// Successful requests go to the local server in server.cpp. Failures are injected by sending
+// requests to a local port nobody listens on, which refuses the connection. For a failure
+// rate r, exactly r of the requests fail, spread evenly. Start the server first:
+//
+//     ./server &
+//     ./error_propagation_bench --failure-rates 0,0.5,1
+//
+// Usage: error_propagation_bench [options]
+//   --host <host>             Server to connect to (default: 127.0.0.1)
+//   --port <port>             Port to connect to (default: 8080)
+//   --requests <n>            Requests per run (default: 20000)
+//   --concurrency <n>         Requests in flight (default: 100)
+//   --failure-rates <r,...>   Comma-separated fractions of requests that fail (default: 0,0.1,0.5,0.9,1)
+
+namespace asio = boost::asio;
+namespace beast = boost::beast;
+namespace http = beast::http;
+using boost::system::error_code;
+using asio::ip::tcp;
+
+struct bench_config
+{
+    std::string host{"127.0.0.1"};
+    std::string port{"8080"};
+    std::size_t total_requests{20000};
+    std::size_t concurrency{100};
+    std::vector<double> failure_rates{0, 0.1, 0.5, 0.9, 1};
+    std::string request;
+    std::string refused_port;
+};
+
+// A port that refuses connections: bound to get a free port, and closed
+static std::string refused_port()
+{
+    asio::io_context ctx;
+    tcp::acceptor acceptor(ctx, tcp::endpoint(asio::ip::make_address("127.0.0.1"), 0));
+    return std::to_string(acceptor.local_endpoint().port());
+}
+
+//
+// The variants. All of them return the request's error, but get it in different ways
+//
+
+static asio::awaitable<error_code> request_deferred(
+    tcp::resolver& resolv,
+    tcp::socket& sock,
+    std::string_view host,
+    std::string_view port,
+    std::string_view req,
+    std::string& buff
+)
+{
+    try
+    {
+        auto endpoints = co_await resolv.async_resolve(host, port, asio::deferred);
+        co_await asio::async_connect(sock, endpoints, asio::deferred);
+        co_await asio::async_write(sock, asio::buffer(req), asio::deferred);
+        co_await asio::async_read_until(sock, asio::dynamic_buffer(buff), "\r\n\r\n", asio::deferred);
+        co_return error_code();
+    }
+    catch (const boost::system::system_error& err)
+    {
+        co_return err.code();
+    }
+}
+
+static asio::awaitable<error_code> request_redirect_error(
+    tcp::resolver& resolv,
+    tcp::socket& sock,
+    std::string_view host,
+    std::string_view port,
+    std::string_view req,
+    std::string& buff
+)
+{
+    error_code ec;
+    auto tok = asio::redirect_error(asio::deferred, ec);
+
+    auto endpoints = co_await resolv.async_resolve(host, port, tok);
+    if (ec)
+        co_return ec;
+    co_await asio::async_connect(sock, endpoints, tok);
+    if (ec)
+        co_return ec;
+    co_await asio::async_write(sock, asio::buffer(req), tok);
+    if (ec)
+        co_return ec;
+    co_await asio::async_read_until(sock, asio::dynamic_buffer(buff), "\r\n\r\n", tok);
+    co_return ec;
+}
+
+static asio::awaitable<error_code> request_composed(
+    tcp::resolver& resolv,
+    tcp::socket& sock,
+    std::string_view host,
+    std::string_view port,
+    std::string_view req,
+    std::string& buff
+)
+{
+    auto [ec, bytes_read] = co_await async_request_ec(
+        resolv,
+        sock,
+        host,
+        port,
+        req,
+        buff,
+        asio::as_tuple(asio::deferred)
+    );
+    co_return ec;
+}
+
+static asio::awaitable<error_code> request_beast(
+    tcp::resolver& resolv,
+    tcp::socket& sock,
+    std::string_view host,
+    std::string_view port,
+    std::string_view,
+    std::string&
+)
+{
+    http::request<http::empty_body> req{http::verb::get, "/", 11};
+    req.set(http::field::host, host);
+    req.set(http::field::user_agent, "Asio");
+    beast::flat_buffer buff;
+    http::response<http::string_body> res;
+    co_return co_await beast_request_coroutine_ec(resolv, sock, host, port, req, buff, res);
+}
+
+using request_function = asio::awaitable<error_code> (*)(
+    tcp::resolver&,
+    tcp::socket&,
+    std::string_view,
+    std::string_view,
+    std::string_view,
+    std::string&
+);
+
+//
+// Driver
+//
+
+struct run_state
+{
+    std::size_t next_request{0};
+    std::size_t refused{0};
+    std::size_t other_errors{0};
+    error_code last_other_error;
+};
+
+// Whether request i is one of the failures, such that exactly rate * n of the first n requests fail
+static bool should_fail(std::size_t i, double rate)
+{
+    return static_cast<std::size_t>((i + 1) * rate) != static_cast<std::size_t>(i * rate);
+}
+
+// Runs requests until there are none left, one at a time
+static asio::awaitable<void> worker(
+    const bench_config& cfg,
+    double failure_rate,
+    request_function request_fn,
+    run_state& st
+)
+{
+    auto ex = co_await asio::this_coro::executor;
+    tcp::resolver resolv(ex);
+    std::string buff;
+
+    while (st.next_request < cfg.total_requests)
+    {
+        bool fail = should_fail(st.next_request++, failure_rate);
+        std::string_view host = fail ? std::string_view("127.0.0.1") : std::string_view(cfg.host);
+        std::string_view port = fail ? cfg.refused_port : cfg.port;
+        tcp::socket sock(ex);
+        buff.clear();
+        error_code ec = co_await request_fn(resolv, sock, host, port, cfg.request, buff);
+        if (ec == asio::error::connection_refused)
+        {
+            ++st.refused;
+        }
+        else if (ec)
+        {
+            ++st.other_errors;
+            st.last_other_error = ec;
+        }
+
+        // Reset the connection instead of closing it gracefully, so successful requests don't
+        // leave sockets in TIME_WAIT. Otherwise, we'd run out of ephemeral ports
+        error_code ignored;
+        sock.set_option(asio::socket_base::linger(true, 0), ignored);
+        sock.close(ignored);
+    }
+}
+
+static double run(const bench_config& cfg, double failure_rate, std::string_view name, request_function fn)
+{
+    asio::io_context ctx(1);
+    run_state st;
+    for (std::size_t i = 0; i < cfg.concurrency; ++i)
+    {
+        asio::co_spawn(ctx, worker(cfg, failure_rate, fn, st), [](std::exception_ptr exc) {
+            if (exc)
+                std::rethrow_exception(exc);
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    ctx.run();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double requests_per_second = cfg.total_requests / elapsed.count();
+
+    std::cout << "  " << std::left << std::setw(22) << name << std::right << std::setw(10)
+              << static_cast<long>(requests_per_second) << " requests/s, " << st.refused << " refused";
+    if (st.other_errors)
+    {
+        std::cout << ", " << st.other_errors << " other errors (last: " << st.last_other_error.message()
+                  << ")";
+    }
+    std::cout << std::endl;
+    return requests_per_second;
+}
+
+static std::vector<double> parse_rates(std::string_view value)
+{
+    std::vector<double> res;
+    while (!value.empty())
+    {
+        std::string_view rate = value.substr(0, value.find(','));
+        value.remove_prefix(std::min(rate.size() + 1, value.size()));
+        res.push_back(std::clamp(std::stod(std::string(rate)), 0.0, 1.0));
+    }
+    return res;
+}
+
+static void usage(const char* program)
+{
+    std::cerr << "Usage: " << program
+              << " [--host <host>] [--port <port>] [--requests <n>] [--concurrency <n>] "
+                 "[--failure-rates <r,...>]\n";
+    std::exit(1);
+}
+
+int main(int argc, char** argv)
+{
+    bench_config cfg;
+    for (int i = 1; i < argc; i += 2)
+    {
+        if (i + 1 >= argc)
+            usage(argv[0]);
+        std::string_view opt = argv[i];
+        const char* value = argv[i + 1];
+        if (opt == "--host")
+            cfg.host = value;
+        else if (opt == "--port")
+            cfg.port = value;
+        else if (opt == "--requests")
+            cfg.total_requests = std::stoul(value);
+        else if (opt == "--concurrency")
+            cfg.concurrency = std::max<std::size_t>(std::stoul(value), 1u);
+        else if (opt == "--failure-rates")
+            cfg.failure_rates = parse_rates(value);
+        else
+            usage(argv[0]);
+    }
+
+    cfg.request = "GET / HTTP/1.1\r\n"
+                  "Host: " +
+                  cfg.host +
+                  "\r\n"
+                  "User-Agent: Asio\r\n"
+                  "Accept: */*\r\n\r\n";
+    cfg.refused_port = refused_port();
+
+    for (double rate : cfg.failure_rates)
+    {
+        std::cout << "Failure rate " << rate * 100 << "%:\n";
+        double deferred = run(cfg, rate, "deferred", request_deferred);
+        double as_tuple = run(cfg, rate, "as_tuple", request_coroutine_ec);
+        double redirect_error = run(cfg, rate, "redirect_error", request_redirect_error);
+        double composed = run(cfg, rate, "composed + as_tuple", request_composed);
+        double beast_as_tuple = run(cfg, rate, "beast + as_tuple", request_beast);
+        std::cout << "  Relative to deferred: as_tuple " << as_tuple / deferred << "x, redirect_error "
+                  << redirect_error / deferred << "x, composed " << composed / deferred << "x, beast "
+                  << beast_as_tuple / deferred << "x\n";
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef USINGSTDCPP_2024_EXAMPLE_TARGET_HPP
+#define USINGSTDCPP_2024_EXAMPLE_TARGET_HPP
+
+#include <cstdlib>
+
+// The host and port the examples send their requests to.
+// By default, the public hosts used in the talk. Set the EXAMPLES_HOST and EXAMPLES_PORT
+// environment variables to point them somewhere else, like the local server in server.cpp:
+//   EXAMPLES_HOST=127.0.0.1 EXAMPLES_PORT=8080 ./coroutines
+// Most examples resolve the host, so it can be a name or an IP. The first two versions in sync.cpp
+// don't resolve it, so they need an IP literal.
+
+inline const char* example_host(const char* default_host)
+{
+    const char* res = std::getenv("EXAMPLES_HOST");
+    return res ? res : default_host;
+}
+
+inline const char* example_port(const char* default_port = "80")
+{
+    const char* res = std::getenv("EXAMPLES_PORT");
+    return res ? res : default_port;
+}
+
+#endif
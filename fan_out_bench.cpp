@@ -0,0 +1,181 @@
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/socket_base.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <new>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <malloc.h>
+#include <sys/resource.h>
+
+#include "bounded_fan_out.hpp"
+#include "error_code_pipeline.hpp"
+
+// Throughput and memory of a batch of requests as the number of requests in flight (K) grows.
+// Runs the batch with bounded_fan_out for several values of K, and with K equal to the batch size,
+// which is what calling handle_request in a loop does. Requests go to the local server in server.cpp,
+// which must be running. Memory is the peak of live heap memory during the batch.
+// Usage: fan_out_bench [options]
+//   --host <host>         Server to connect to (default: 127.0.0.1)
+//   --port <port>         Port to connect to (default: 8080)
+//   --requests <n>        Requests per batch (default: 10000)
+
+namespace asio = boost::asio;
+using boost::system::error_code;
+using asio::ip::tcp;
+
+// Tracks live heap memory. The resolver uses a background thread, so the counters are atomic
+static std::atomic<std::int64_t> live_bytes{0};
+static std::atomic<std::int64_t> peak_live_bytes{0};
+
+void* operator new(std::size_t size)
+{
+    void* p = std::malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    auto now = live_bytes.fetch_add(malloc_usable_size(p), std::memory_order_relaxed) + malloc_usable_size(p);
+    auto peak = peak_live_bytes.load(std::memory_order_relaxed);
+    while (now > peak && !peak_live_bytes.compare_exchange_weak(peak, now, std::memory_order_relaxed))
+        ;
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    if (p)
+        live_bytes.fetch_sub(malloc_usable_size(p), std::memory_order_relaxed);
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept { operator delete(p); }
+
+struct bench_config
+{
+    std::string host{"127.0.0.1"};
+    std::string port{"8080"};
+    std::size_t total_requests{10000};
+    std::string request;
+};
+
+// A request, as in coroutines.cpp, without exceptions
+static asio::awaitable<error_code> fetch(const bench_config& cfg)
+{
+    auto ex = co_await asio::this_coro::executor;
+    tcp::socket sock(ex);
+    tcp::resolver resolv(ex);
+    std::string buff;
+    error_code ec = co_await request_coroutine_ec(resolv, sock, cfg.host, cfg.port, cfg.request, buff);
+
+    // Reset the connection, so the batches don't exhaust the ephemeral ports with TIME_WAIT sockets
+    error_code ignored;
+    sock.set_option(asio::socket_base::linger(true, 0), ignored);
+    sock.close(ignored);
+    co_return ec;
+}
+
+static void run(const bench_config& cfg, std::size_t max_in_flight)
+{
+    asio::io_context ctx(1);
+    std::size_t errors = 0;
+    error_code last_error;
+    auto base_bytes = live_bytes.load();
+    peak_live_bytes = base_bytes;
+
+    auto start = std::chrono::steady_clock::now();
+    asio::co_spawn(
+        ctx,
+        [&]() -> asio::awaitable<void> {
+            auto results = co_await bounded_fan_out(cfg.total_requests, max_in_flight, [&cfg](std::size_t) {
+                return fetch(cfg);
+            });
+            for (const auto& res : results)
+            {
+                if (res.error)
+                    std::rethrow_exception(res.error);
+                if (res.value)
+                {
+                    ++errors;
+                    last_error = res.value;
+                }
+            }
+        },
+        [](std::exception_ptr exc) {
+            if (exc)
+                std::rethrow_exception(exc);
+        }
+    );
+    ctx.run();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << "  K = " << max_in_flight << ": " << static_cast<long>(cfg.total_requests / elapsed.count())
+              << " requests/s, peak heap " << (peak_live_bytes.load() - base_bytes) / 1024 << " KB";
+    if (errors)
+        std::cout << ", " << errors << " errors (last: " << last_error.message() << ")";
+    std::cout << std::endl;
+}
+
+// Each request in flight holds a socket
+static void raise_open_files_limit()
+{
+    rlimit lim{};
+    getrlimit(RLIMIT_NOFILE, &lim);
+    lim.rlim_cur = lim.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &lim);
+}
+
+static void usage(const char* program)
+{
+    std::cerr << "Usage: " << program << " [--host <host>] [--port <port>] [--requests <n>]\n";
+    std::exit(1);
+}
+
+int main(int argc, char** argv)
+{
+    bench_config cfg;
+    for (int i = 1; i < argc; i += 2)
+    {
+        if (i + 1 >= argc)
+            usage(argv[0]);
+        std::string_view opt = argv[i];
+        const char* value = argv[i + 1];
+        if (opt == "--host")
+            cfg.host = value;
+        else if (opt == "--port")
+            cfg.port = value;
+        else if (opt == "--requests")
+            cfg.total_requests = std::max<std::size_t>(std::stoul(value), 1u);
+        else
+            usage(argv[0]);
+    }
+
+    cfg.request = "GET / HTTP/1.1\r\n"
+                  "Host: " +
+                  cfg.host +
+                  "\r\n"
+                  "User-Agent: Asio\r\n"
+                  "Accept: */*\r\n\r\n";
+    raise_open_files_limit();
+
+    std::cout << cfg.total_requests << " requests, at most K in flight:\n";
+    for (std::size_t k : {1, 10, 100, 1000})
+    {
+        if (k < cfg.total_requests)
+            run(cfg, k);
+    }
+    std::cout << "Unbounded (K = " << cfg.total_requests << "), like calling handle_request in a loop:\n";
+    run(cfg, cfg.total_requests);
+}
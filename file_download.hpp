@@ -0,0 +1,484 @@
+#ifndef USINGSTDCPP_2024_FILE_DOWNLOAD_HPP
+#define USINGSTDCPP_2024_FILE_DOWNLOAD_HPP
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/append.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/basic_stream_socket.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/compose.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/experimental/parallel_group.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/socket_base.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/asio/write_at.hpp>
+#include <boost/system/error_code.hpp>
+#include <boost/system/system_error.hpp>
+
+#if defined(BOOST_ASIO_HAS_FILE)
+#include <boost/asio/file_base.hpp>
+#include <boost/asio/random_access_file.hpp>
+#include <boost/asio/stream_file.hpp>
+#endif
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// Writes an HTTP response body to a file as it's received, instead of into a std::string.
+// The examples read the response into memory and print it. To download large objects,
+// the body should go to disk in fixed-size pieces, with the disk and the network busy at the same time:
+//
+//   - async_download_body reads from the stream into one buffer while the previous one is being
+//     written to the file (double buffering). The file can be an asio::stream_file,
+//     an asio::random_access_file (written with async_write_at), or any AsyncWriteStream.
+//   - async_splice_body (Linux only) moves the body from the socket to the file with splice(2),
+//     through a pipe, so it's never copied to user space.
+//
+// Both take the body bytes that were read together with the headers (body_prefix) and the body size,
+// so the headers can be parsed by http_response_parser or Beast (see download.cpp).
+// Only bodies with a Content-Length are supported: chunked bodies need a parser in between.
+//
+// Asio only supports files when it uses io_uring on Linux (BOOST_ASIO_HAS_FILE, see ENABLE_IO_URING).
+// Otherwise, download_file is a blocking_file, which writes synchronously. Regular files are
+// always "ready" for epoll, so this is what a reactor-based program would do anyway.
+
+struct download_options
+{
+    // The size of each of the two buffers
+    std::size_t buffer_size{256 * 1024};
+};
+
+// An AsyncWriteStream over a file descriptor that writes synchronously and posts the completion
+class blocking_file
+{
+    boost::asio::any_io_executor ex_;
+    int fd_;
+
+public:
+    using executor_type = boost::asio::any_io_executor;
+
+    // Creates or truncates the file. Throws on error
+    blocking_file(executor_type ex, const std::string& path)
+        : ex_(std::move(ex)), fd_(::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644))
+    {
+        if (fd_ < 0)
+        {
+            throw boost::system::system_error(
+                boost::system::error_code(errno, boost::system::system_category()),
+                "open"
+            );
+        }
+    }
+
+    blocking_file(blocking_file&& other) noexcept
+        : ex_(std::move(other.ex_)), fd_(std::exchange(other.fd_, -1))
+    {
+    }
+
+    blocking_file& operator=(blocking_file&&) = delete;
+
+    ~blocking_file()
+    {
+        if (fd_ >= 0)
+            ::close(fd_);
+    }
+
+    executor_type get_executor() const noexcept { return ex_; }
+    int native_handle() const noexcept { return fd_; }
+
+    // Writes (part of) the first buffer in the sequence
+    template <class ConstBufferSequence, class CompletionToken>
+    auto async_write_some(const ConstBufferSequence& buffers, CompletionToken&& token)
+    {
+        using signature = void(boost::system::error_code, std::size_t);
+        auto first = boost::asio::buffer_sequence_begin(buffers);
+        boost::asio::const_buffer buff = first == boost::asio::buffer_sequence_end(buffers)
+                                             ? boost::asio::const_buffer()
+                                             : boost::asio::const_buffer(*first);
+        return boost::asio::async_initiate<CompletionToken, signature>(
+            [this](auto handler, boost::asio::const_buffer buff) {
+                boost::system::error_code ec;
+                ssize_t n = buff.size() ? ::write(fd_, buff.data(), buff.size()) : 0;
+                if (n < 0)
+                {
+                    ec.assign(errno, boost::system::system_category());
+                    n = 0;
+                }
+                auto bytes_written = static_cast<std::size_t>(n);
+                boost::asio::post(ex_, boost::asio::append(std::move(handler), ec, bytes_written));
+            },
+            token,
+            buff
+        );
+    }
+};
+
+#if defined(BOOST_ASIO_HAS_FILE)
+using download_file = boost::asio::stream_file;
+
+inline download_file open_download_file(boost::asio::any_io_executor ex, const std::string& path)
+{
+    return download_file(
+        std::move(ex),
+        path,
+        download_file::write_only | download_file::create | download_file::truncate
+    );
+}
+#else
+using download_file = blocking_file;
+
+inline download_file open_download_file(boost::asio::any_io_executor ex, const std::string& path)
+{
+    return download_file(std::move(ex), path);
+}
+#endif
+
+namespace detail {
+
+// Random access files are written at an offset, and anything else sequentially
+template <class File, class CompletionToken>
+auto async_write_file(
+    File& file,
+    std::uint64_t offset,
+    boost::asio::const_buffer data,
+    CompletionToken&& token
+)
+{
+    if constexpr (requires { file.write_some_at(offset, data); })
+        return boost::asio::async_write_at(file, offset, data, std::forward<CompletionToken>(token));
+    else
+        return boost::asio::async_write(file, data, std::forward<CompletionToken>(token));
+}
+
+}  // namespace detail
+
+template <class AsyncReadStream, class File>
+struct download_body_op
+{
+    AsyncReadStream& stream;
+    File& file;
+    boost::asio::const_buffer prefix;
+    std::uint64_t remaining;  // Body bytes still to be read from the stream
+    std::size_t buffer_size;
+    std::unique_ptr<char[]> buffers;  // Two buffers of buffer_size, one after the other
+    std::size_t read_index{0};        // The buffer the next read goes into
+    std::uint64_t written{0};
+
+    enum class state_t
+    {
+        initial,
+        reading,      // The first read, with nothing to write yet
+        overlapping,  // Writing the last data received, while reading into the other buffer
+        writing_last,
+    } state{state_t::initial};
+
+    boost::asio::mutable_buffer read_buffer() const noexcept
+    {
+        auto size = static_cast<std::size_t>(std::min<std::uint64_t>(remaining, buffer_size));
+        return boost::asio::buffer(buffers.get() + read_index * buffer_size, size);
+    }
+
+    // data has just been received. It's not in the buffer the next read goes into
+    template <class Self>
+    void write_and_read(Self& self, boost::asio::const_buffer data)
+    {
+        if (remaining == 0)
+        {
+            state = state_t::writing_last;
+            return detail::async_write_file(file, written, data, std::move(self));
+        }
+        state = state_t::overlapping;
+        boost::asio::experimental::make_parallel_group(
+            detail::async_write_file(file, written, data, boost::asio::deferred),
+            stream.async_read_some(read_buffer(), boost::asio::deferred)
+        )
+            .async_wait(boost::asio::experimental::wait_for_all(), std::move(self));
+    }
+
+    // Makes the buffer that was just read into the one to write, and reads into the other one
+    template <class Self>
+    void on_read(Self& self, std::size_t bytes_read)
+    {
+        remaining -= bytes_read;
+        boost::asio::const_buffer data = boost::asio::buffer(read_buffer().data(), bytes_read);
+        read_index ^= 1;
+        write_and_read(self, data);
+    }
+
+    template <class Self>
+    void operator()(Self& self)
+    {
+        assert(state == state_t::initial);
+
+        // The data that came with the headers is written first. Its memory belongs to the caller
+        if (prefix.size())
+            return write_and_read(self, prefix);
+        if (remaining == 0)
+            return boost::asio::post(boost::asio::append(std::move(self), boost::system::error_code(), 0u));
+        state = state_t::reading;
+        stream.async_read_some(read_buffer(), std::move(self));
+    }
+
+    // The first read, or the last write
+    template <class Self>
+    void operator()(Self& self, boost::system::error_code ec, std::size_t bytes_transferred)
+    {
+        if (state == state_t::reading)
+        {
+            if (ec)
+                return self.complete(ec, written);
+            on_read(self, bytes_transferred);
+        }
+        else
+        {
+            // Also used for empty bodies, from the initial state
+            written += bytes_transferred;
+            self.complete(ec, written);
+        }
+    }
+
+    // A write and a read
+    template <class Self>
+    void operator()(
+        Self& self,
+        std::array<std::size_t, 2>,
+        boost::system::error_code write_ec,
+        std::size_t bytes_written,
+        boost::system::error_code read_ec,
+        std::size_t bytes_read
+    )
+    {
+        assert(state == state_t::overlapping);
+        written += bytes_written;
+        if (write_ec || read_ec)
+            return self.complete(write_ec ? write_ec : read_ec, written);
+        on_read(self, bytes_read);
+    }
+};
+
+// Reads the rest of a body of body_size bytes from stream and writes it to file. body_prefix holds
+// the first bytes of the body, received with the headers, and must remain valid until completion.
+// Completes with the number of bytes written to the file
+template <
+    class AsyncReadStream,
+    class File,
+    boost::asio::completion_token_for<void(boost::system::error_code, std::uint64_t)> CompletionToken>
+auto async_download_body(
+    AsyncReadStream& stream,
+    boost::asio::const_buffer body_prefix,
+    std::uint64_t body_size,
+    File& file,
+    const download_options& opts,
+    CompletionToken&& token
+)
+{
+    // Anything after the body (e.g. a pipelined response) is not ours
+    if (body_prefix.size() > body_size)
+        body_prefix = boost::asio::buffer(body_prefix.data(), static_cast<std::size_t>(body_size));
+    return boost::asio::async_compose<CompletionToken, void(boost::system::error_code, std::uint64_t)>(
+        download_body_op<AsyncReadStream, File>{
+            stream,
+            file,
+            body_prefix,
+            body_size - body_prefix.size(),
+            opts.buffer_size,
+            std::make_unique<char[]>(2 * opts.buffer_size),
+        },
+        token,
+        stream,
+        file
+    );
+}
+
+#if defined(__linux__)
+
+// A pipe for splice. Socket data is spliced into it, and from it into the file
+class splice_pipe
+{
+    int read_fd_{-1};
+    int write_fd_{-1};
+    std::size_t capacity_{0};
+
+public:
+    splice_pipe() = default;
+    splice_pipe(splice_pipe&& other) noexcept
+        : read_fd_(std::exchange(other.read_fd_, -1)),
+          write_fd_(std::exchange(other.write_fd_, -1)),
+          capacity_(other.capacity_)
+    {
+    }
+    splice_pipe& operator=(splice_pipe&&) = delete;
+
+    ~splice_pipe()
+    {
+        if (read_fd_ >= 0)
+        {
+            ::close(read_fd_);
+            ::close(write_fd_);
+        }
+    }
+
+    boost::system::error_code open(std::size_t requested_capacity) noexcept
+    {
+        int fds[2];
+        if (::pipe2(fds, O_CLOEXEC | O_NONBLOCK) != 0)
+            return boost::system::error_code(errno, boost::system::system_category());
+        read_fd_ = fds[0];
+        write_fd_ = fds[1];
+
+        // Bigger pipes need fewer system calls. The default is 64KB, and may not be raised
+        // above /proc/sys/fs/pipe-max-size, which is fine
+        ::fcntl(write_fd_, F_SETPIPE_SZ, static_cast<int>(requested_capacity));
+        int capacity = ::fcntl(write_fd_, F_GETPIPE_SZ);
+        capacity_ = capacity > 0 ? static_cast<std::size_t>(capacity) : 64 * 1024;
+        return {};
+    }
+
+    int read_fd() const noexcept { return read_fd_; }
+    int write_fd() const noexcept { return write_fd_; }
+    std::size_t capacity() const noexcept { return capacity_; }
+};
+
+template <class Socket>
+struct splice_body_op
+{
+    // Splicing as long as the socket has data would starve other work in the io_context
+    static constexpr int max_splices_per_wait = 16;
+
+    Socket& sock;
+    int file_fd;
+    boost::asio::const_buffer prefix;
+    std::uint64_t remaining;
+    std::size_t pipe_size;
+    splice_pipe pipe{};
+    std::uint64_t written{0};
+
+    static boost::system::error_code last_error() noexcept
+    {
+        return boost::system::error_code(errno, boost::system::system_category());
+    }
+
+    // Moves n bytes from the pipe to the file. Regular files don't support non-blocking I/O,
+    // so this blocks until the data is in the page cache, like blocking_file
+    boost::system::error_code drain_pipe(std::size_t n) noexcept
+    {
+        while (n > 0)
+        {
+            auto offset = static_cast<loff_t>(written);
+            ssize_t res = ::splice(pipe.read_fd(), nullptr, file_fd, &offset, n, SPLICE_F_MOVE);
+            if (res < 0 && errno == EINTR)
+                continue;
+            if (res <= 0)
+                return res < 0 ? last_error() : boost::asio::error::make_error_code(boost::asio::error::eof);
+            written += static_cast<std::uint64_t>(res);
+            n -= static_cast<std::size_t>(res);
+        }
+        return {};
+    }
+
+    template <class Self>
+    void operator()(Self& self)
+    {
+        // The data that came with the headers can't be spliced
+        boost::system::error_code ec = pipe.open(pipe_size);
+        for (std::size_t offset = 0; !ec && offset < prefix.size();)
+        {
+            ssize_t res = ::pwrite(
+                file_fd,
+                static_cast<const char*>(prefix.data()) + offset,
+                prefix.size() - offset,
+                static_cast<off_t>(offset)
+            );
+            if (res < 0 && errno != EINTR)
+                ec = last_error();
+            else if (res > 0)
+                offset += static_cast<std::size_t>(res);
+        }
+        written = prefix.size();
+
+        // splice fails with EAGAIN instead of blocking when the socket is non-blocking
+        if (!ec)
+            sock.native_non_blocking(true, ec);
+
+        // Don't complete from within the initiating function
+        if (ec || remaining == 0)
+            return boost::asio::post(boost::asio::append(std::move(self), ec));
+        sock.async_wait(boost::asio::socket_base::wait_read, std::move(self));
+    }
+
+    // The socket has data
+    template <class Self>
+    void operator()(Self& self, boost::system::error_code ec)
+    {
+        for (int i = 0; !ec && remaining > 0; ++i)
+        {
+            if (i == max_splices_per_wait)
+                return sock.async_wait(boost::asio::socket_base::wait_read, std::move(self));
+
+            std::size_t n = static_cast<std::size_t>(std::min<std::uint64_t>(remaining, pipe.capacity()));
+            ssize_t res = ::splice(
+                sock.native_handle(),
+                nullptr,
+                pipe.write_fd(),
+                nullptr,
+                n,
+                SPLICE_F_MOVE | SPLICE_F_NONBLOCK
+            );
+            if (res < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                return sock.async_wait(boost::asio::socket_base::wait_read, std::move(self));
+            if (res < 0 && errno == EINTR)
+                continue;
+            if (res < 0)
+                ec = last_error();
+            else if (res == 0)
+                ec = boost::asio::error::eof;
+            else
+            {
+                remaining -= static_cast<std::uint64_t>(res);
+                ec = drain_pipe(static_cast<std::size_t>(res));
+            }
+        }
+        self.complete(ec, written);
+    }
+};
+
+// Like async_download_body, but moves the body from the socket to the file descriptor file_fd
+// with splice, without copying it to user space. file_fd is written from offset 0.
+// Puts the socket in non-blocking mode
+template <
+    class Protocol,
+    class Executor,
+    boost::asio::completion_token_for<void(boost::system::error_code, std::uint64_t)> CompletionToken>
+auto async_splice_body(
+    boost::asio::basic_stream_socket<Protocol, Executor>& sock,
+    boost::asio::const_buffer body_prefix,
+    std::uint64_t body_size,
+    int file_fd,
+    CompletionToken&& token
+)
+{
+    if (body_prefix.size() > body_size)
+        body_prefix = boost::asio::buffer(body_prefix.data(), static_cast<std::size_t>(body_size));
+    using socket_type = boost::asio::basic_stream_socket<Protocol, Executor>;
+    return boost::asio::async_compose<CompletionToken, void(boost::system::error_code, std::uint64_t)>(
+        splice_body_op<socket_type>{sock, file_fd, body_prefix, body_size - body_prefix.size(), 1024 * 1024},
+        token,
+        sock
+    );
+}
+
+#endif
+
+#endif
@@ -0,0 +1,84 @@
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/address.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/this_coro.hpp>
+
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+#include "example_target.hpp"
+#include "happy_eyeballs.hpp"
+
+namespace asio = boost::asio;
+
+// An endpoint that refuses connections, followed by one that accepts them.
+// The refused attempt fails first, and the second one must still win
+asio::awaitable<void> check_refused_then_accepted()
+{
+    auto ex = co_await asio::this_coro::executor;
+    asio::ip::tcp::endpoint refusing;
+    {
+        // Nothing listens on this port once the acceptor is closed
+        asio::ip::tcp::acceptor acc(ex, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+        refusing = acc.local_endpoint();
+    }
+    asio::ip::tcp::acceptor acceptor(ex, asio::ip::tcp::endpoint(asio::ip::address_v4::loopback(), 0));
+    std::vector<asio::ip::tcp::endpoint> endpoints{refusing, acceptor.local_endpoint()};
+
+    asio::ip::tcp::socket sock(ex);
+    auto endpoint = co_await async_happy_eyeballs_connect(sock, endpoints, asio::deferred);
+    if (endpoint != acceptor.local_endpoint() || !sock.is_open())
+        throw std::runtime_error("Happy Eyeballs check failed: the accepting endpoint didn't win");
+    std::cout << "Check passed: refused " << refusing << ", connected to " << endpoint << std::endl;
+}
+
+asio::awaitable<void> connect_impl()
+{
+    // Coroutines know which executor are using
+    asio::any_io_executor ex = co_await asio::this_coro::executor;
+
+    // I/O objects
+    asio::ip::tcp::socket sock(ex);
+    asio::ip::tcp::resolver resolv(ex);
+
+    // Resolve the hostname and port into a set of endpoints
+    auto results = co_await resolv.async_resolve(example_host("example.com"), example_port(), asio::deferred);
+
+    // Put the unreachable address from cancellation.cpp first.
+    // async_connect would get stuck on it until the OS timeout
+    std::vector<asio::ip::tcp::endpoint> endpoints{
+        asio::ip::tcp::endpoint(asio::ip::make_address("80.213.10.1"), 80)
+    };
+    for (const auto& entry : results)
+        endpoints.push_back(entry.endpoint());
+
+    // Attempts are started every 250ms, and the first one to succeed wins
+    auto start = std::chrono::steady_clock::now();
+    auto endpoint = co_await async_happy_eyeballs_connect(sock, endpoints, asio::deferred);
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::cout << "Connected to " << endpoint << " in " << elapsed.count() << "ms" << std::endl;
+}
+
+int main()
+{
+    asio::io_context ctx;
+    auto on_done = [](std::exception_ptr exc) {
+        if (exc)
+            std::rethrow_exception(exc);
+    };
+    asio::co_spawn(ctx, check_refused_then_accepted, on_done);
+    ctx.run();
+
+    ctx.restart();
+    asio::co_spawn(ctx, connect_impl, on_done);
+    ctx.run();
+}
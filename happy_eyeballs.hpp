@@ -0,0 +1,277 @@
+#ifndef USINGSTDCPP_2024_HAPPY_EYEBALLS_HPP
+#define USINGSTDCPP_2024_HAPPY_EYEBALLS_HPP
+
+#include <boost/asio/append.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/cancellation_type.hpp>
+#include <boost/asio/compose.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/experimental/cancellation_condition.hpp>
+#include <boost/asio/experimental/parallel_group.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// A replacement for asio::async_connect in the style of RFC 8305 ("Happy Eyeballs").
+// async_connect tries the endpoints one after another, so a single unreachable address
+// (like the one in cancellation.cpp) stalls the connection until the OS gives up.
+// Here, connection attempts are raced:
+//
+//   - Endpoints are reordered to alternate between IPv6 and IPv4, starting with the family
+//     of the first endpoint returned by the resolver.
+//   - A new attempt starts every attempt_delay, or as soon as the previous one fails,
+//     without stopping the ones already in progress.
+//   - The first socket to connect is moved into the user's socket, and the other attempts are cancelled.
+//
+// The attempts run in a ranged experimental::make_parallel_group with wait_for_one_success.
+// The operation supports per-operation cancellation, which is forwarded to all attempts.
+// Completes with the same signature as async_connect: void(error_code, tcp::endpoint).
+
+struct happy_eyeballs_params
+{
+    // RFC 8305 recommends 250ms
+    std::chrono::steady_clock::duration attempt_delay{std::chrono::milliseconds(250)};
+};
+
+namespace detail {
+
+struct connect_attempt
+{
+    boost::asio::ip::tcp::socket sock;
+    boost::asio::steady_timer timer;  // Expires when the attempt should start
+    boost::asio::ip::tcp::endpoint endpoint;
+    bool start_now{false};  // Set when the previous attempt failed
+
+    connect_attempt(const boost::asio::ip::tcp::socket::executor_type& ex, boost::asio::ip::tcp::endpoint ep)
+        : sock(ex), timer(ex, std::chrono::steady_clock::time_point::max()), endpoint(ep)
+    {
+    }
+};
+
+// Shared by all attempts. Lives until the parallel group completes, after all attempts finished
+struct happy_eyeballs_state
+{
+    std::deque<connect_attempt> attempts;  // deque, so references remain valid
+    std::size_t next_to_start{0};
+    std::chrono::steady_clock::duration attempt_delay;
+
+    // Attempts wait on their timer. Changing its expiry wakes them up with operation_aborted,
+    // and they check whether it's their turn or they need to wait again
+    void on_attempt_started(std::size_t index)
+    {
+        next_to_start = index + 1;
+        if (next_to_start < attempts.size())
+            attempts[next_to_start].timer.expires_after(attempt_delay);
+    }
+
+    void on_attempt_failed()
+    {
+        if (next_to_start < attempts.size())
+        {
+            attempts[next_to_start].start_now = true;
+            attempts[next_to_start].timer.cancel();
+        }
+    }
+};
+
+// A single attempt: wait for our turn, then connect
+struct connect_attempt_op
+{
+    happy_eyeballs_state& st;
+    std::size_t index;
+
+    enum class state_t
+    {
+        waiting,
+        connecting,
+    } state{state_t::waiting};
+
+    template <class Self>
+    void operator()(Self& self)
+    {
+        st.attempts[index].timer.async_wait(std::move(self));
+    }
+
+    template <class Self>
+    void operator()(Self& self, boost::system::error_code ec)
+    {
+        connect_attempt& attempt = st.attempts[index];
+        if (state == state_t::waiting)
+        {
+            // Another attempt won, or the whole operation was cancelled
+            if (self.get_cancellation_state().cancelled() != boost::asio::cancellation_type::none)
+                return self.complete(boost::asio::error::operation_aborted);
+
+            // Our timer was re-armed, but it's not our turn yet
+            if (ec && !attempt.start_now)
+                return attempt.timer.async_wait(std::move(self));
+
+            state = state_t::connecting;
+            st.on_attempt_started(index);
+            attempt.sock.async_connect(attempt.endpoint, std::move(self));
+        }
+        else
+        {
+            if (ec)
+                st.on_attempt_failed();
+            self.complete(ec);
+        }
+    }
+};
+
+inline auto async_connect_attempt(happy_eyeballs_state& st, std::size_t index)
+{
+    return boost::asio::async_compose<const boost::asio::deferred_t, void(boost::system::error_code)>(
+        connect_attempt_op{st, index},
+        boost::asio::deferred,
+        st.attempts[index].sock
+    );
+}
+
+struct happy_eyeballs_op
+{
+    boost::asio::ip::tcp::socket& sock;
+    std::unique_ptr<happy_eyeballs_state> st;
+
+    template <class Self>
+    void operator()(Self& self)
+    {
+        if (st->attempts.empty())
+        {
+            // Like async_connect. Handlers must not be called from the initiating function
+            return boost::asio::post(
+                sock.get_executor(),
+                boost::asio::append(std::move(self), boost::system::error_code(boost::asio::error::not_found))
+            );
+        }
+
+        // The first attempt starts immediately
+        st->attempts.front().start_now = true;
+        st->attempts.front().timer.expires_at(std::chrono::steady_clock::time_point::min());
+
+        std::vector<decltype(async_connect_attempt(*st, 0))> ops;
+        ops.reserve(st->attempts.size());
+        for (std::size_t i = 0; i < st->attempts.size(); ++i)
+            ops.push_back(async_connect_attempt(*st, i));
+
+        boost::asio::experimental::make_parallel_group(std::move(ops))
+            .async_wait(boost::asio::experimental::wait_for_one_success(), std::move(self));
+    }
+
+    // No endpoints
+    template <class Self>
+    void operator()(Self& self, boost::system::error_code ec)
+    {
+        self.complete(ec, boost::asio::ip::tcp::endpoint());
+    }
+
+    // All the attempts have finished
+    template <class Self>
+    void operator()(
+        Self& self,
+        std::vector<std::size_t> completion_order,
+        std::vector<boost::system::error_code> errors
+    )
+    {
+        // Attempts that failed fast (e.g. connection refused) complete before the winner,
+        // so the winner is the first attempt that didn't fail
+        auto winner = std::find_if(completion_order.begin(), completion_order.end(), [&](std::size_t i) {
+            return !errors[i];
+        });
+        if (winner == completion_order.end())
+        {
+            // Everything failed. Report the last error, like async_connect does
+            return self.complete(errors[completion_order.back()], boost::asio::ip::tcp::endpoint());
+        }
+        connect_attempt& attempt = st->attempts[*winner];
+        sock = std::move(attempt.sock);
+        boost::asio::ip::tcp::endpoint ep = attempt.endpoint;
+        self.complete(boost::system::error_code(), ep);
+    }
+};
+
+// Interleaves the address families, starting with the first one
+template <class EndpointSequence>
+std::deque<boost::asio::ip::tcp::endpoint> interleave_address_families(const EndpointSequence& endpoints)
+{
+    std::deque<boost::asio::ip::tcp::endpoint> first_family, other_family, res;
+    for (const auto& entry : endpoints)
+    {
+        boost::asio::ip::tcp::endpoint ep = entry;
+        if (first_family.empty() || ep.address().is_v6() == first_family.front().address().is_v6())
+            first_family.push_back(ep);
+        else
+            other_family.push_back(ep);
+    }
+    while (!first_family.empty() || !other_family.empty())
+    {
+        for (auto* family : {&first_family, &other_family})
+        {
+            if (!family->empty())
+            {
+                res.push_back(family->front());
+                family->pop_front();
+            }
+        }
+    }
+    return res;
+}
+
+}  // namespace detail
+
+// endpoints may be a tcp::resolver::results_type, or any range of tcp::endpoint.
+// sock must not be open. On success, it contains the connected socket
+template <
+    class EndpointSequence,
+    boost::asio::completion_token_for<void(boost::system::error_code, boost::asio::ip::tcp::endpoint)>
+        CompletionToken>
+auto async_happy_eyeballs_connect(
+    boost::asio::ip::tcp::socket& sock,
+    const EndpointSequence& endpoints,
+    const happy_eyeballs_params& params,
+    CompletionToken&& token
+)
+{
+    auto st = std::make_unique<detail::happy_eyeballs_state>();
+    st->attempt_delay = params.attempt_delay;
+    for (const auto& ep : detail::interleave_address_families(endpoints))
+        st->attempts.emplace_back(sock.get_executor(), ep);
+
+    return boost::asio::async_compose<
+        CompletionToken,
+        void(boost::system::error_code, boost::asio::ip::tcp::endpoint)>(
+        detail::happy_eyeballs_op{sock, std::move(st)},
+        token,
+        sock
+    );
+}
+
+template <
+    class EndpointSequence,
+    boost::asio::completion_token_for<void(boost::system::error_code, boost::asio::ip::tcp::endpoint)>
+        CompletionToken>
+auto async_happy_eyeballs_connect(
+    boost::asio::ip::tcp::socket& sock,
+    const EndpointSequence& endpoints,
+    CompletionToken&& token
+)
+{
+    return async_happy_eyeballs_connect(
+        sock,
+        endpoints,
+        happy_eyeballs_params(),
+        std::forward<CompletionToken>(token)
+    );
+}
+
+#endif
@@ -0,0 +1,275 @@
+#ifndef USINGSTDCPP_2024_HTTP_PIPELINE_HPP
+#define USINGSTDCPP_2024_HTTP_PIPELINE_HPP
+
+#include <boost/asio/any_completion_handler.hpp>
+#include <boost/asio/append.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/compose.hpp>
+#include <boost/asio/completion_condition.hpp>
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "http_response_parser.hpp"
+
+// HTTP/1.1 request pipelining over a single connection.
+// handle_request_op in composed.cpp writes one request and reads one response per connection.
+// Here, requests are sent without waiting for the previous responses, and the server answers them
+// in order. This saves a round trip per request and, for small requests, most of the syscalls:
+//
+//   - Requests submitted together (e.g. from the same handler) are written back-to-back
+//     with a single gather write.
+//   - Responses that arrive together are parsed from the same read.
+//   - Each request completes as soon as its own response has been read, in order.
+//   - At most max_depth requests are in flight. Further requests wait until a response arrives.
+//
+// async_pipelined_request is an async_compose-based operation, so it works with any completion token.
+// Responses must have a Content-Length, since it's the only way to know where one ends and the next begins.
+// If any request fails, the connection can't be used anymore: all pending and future requests fail.
+//
+// Not thread-safe: operations must be initiated from the stream's executor (or strand),
+// and the pipeline and the stream must outlive them.
+
+template <class AsyncStream>
+class http_pipeline
+{
+public:
+    using handler_type = boost::asio::any_completion_handler<void(boost::system::error_code, std::size_t)>;
+
+private:
+    using error_code = boost::system::error_code;
+
+    struct pending_request
+    {
+        std::string_view req;
+        std::string* buff;  // Receives the response headers and body
+        handler_type handler;
+    };
+
+    AsyncStream& stream_;
+    std::size_t max_depth_;
+    http_response_parser parser_;
+    std::deque<pending_request> queued_;     // Not written yet
+    std::deque<pending_request> in_flight_;  // Written or being written, waiting for their response
+    std::vector<boost::asio::const_buffer> write_buffers_;
+    bool write_scheduled_{false};
+    bool writing_{false};
+    bool reading_{false};
+    error_code error_;  // Set once the connection is broken
+
+    static void complete(handler_type handler, error_code ec, std::size_t header_size)
+    {
+        // Runs the handler through its associated executor, inline if we're already in it
+        boost::asio::dispatch(boost::asio::append(std::move(handler), ec, header_size));
+    }
+
+    // Defers the write, so all the requests submitted before it runs end up in the same batch
+    void schedule_write()
+    {
+        if (write_scheduled_ || writing_ || error_ || queued_.empty() || in_flight_.size() >= max_depth_)
+            return;
+        write_scheduled_ = true;
+        boost::asio::post(stream_.get_executor(), [this] {
+            write_scheduled_ = false;
+            start_write();
+        });
+    }
+
+    void start_write()
+    {
+        if (writing_ || error_)
+            return;
+
+        write_buffers_.clear();
+        while (!queued_.empty() && in_flight_.size() < max_depth_)
+        {
+            write_buffers_.push_back(boost::asio::buffer(queued_.front().req));
+            in_flight_.push_back(std::move(queued_.front()));
+            queued_.pop_front();
+        }
+        if (write_buffers_.empty())
+            return;
+
+        writing_ = true;
+        boost::asio::async_write(stream_, write_buffers_, [this](error_code ec, std::size_t) {
+            writing_ = false;
+            if (ec || error_)
+                return fail(ec);
+            schedule_write();
+        });
+
+        // Responses may start arriving before the write completes
+        if (!reading_)
+            read_next();
+    }
+
+    void read_next()
+    {
+        reading_ = true;
+        async_read_response_header(stream_, parser_, [this](error_code ec, std::size_t header_size) {
+            reading_ = false;
+            if (ec || error_)
+                return fail(ec);
+            if (!parser_.content_length())
+                return fail(http_parser_errc::no_content_length);
+
+            // Copy the headers and the part of the body we already have to the request's buffer.
+            // Anything after them belongs to the next response, and stays in the parser
+            std::size_t content_length = *parser_.content_length();
+            std::string_view body_prefix = parser_.body_prefix();
+            body_prefix = body_prefix.substr(0, std::min(body_prefix.size(), content_length));
+            std::string& buff = *in_flight_.front().buff;
+            buff.assign(parser_.header_data());
+            buff.append(body_prefix);
+            parser_.consume(header_size + body_prefix.size());
+
+            std::size_t remaining = content_length - body_prefix.size();
+            if (remaining == 0)
+                return finish_response(header_size);
+
+            // The rest of the body goes directly to the request's buffer
+            reading_ = true;
+            boost::asio::async_read(
+                stream_,
+                boost::asio::dynamic_buffer(buff),
+                boost::asio::transfer_exactly(remaining),
+                [this, header_size](error_code ec, std::size_t) {
+                    reading_ = false;
+                    if (ec || error_)
+                        return fail(ec);
+                    finish_response(header_size);
+                }
+            );
+        });
+    }
+
+    void finish_response(std::size_t header_size)
+    {
+        handler_type handler = std::move(in_flight_.front().handler);
+        in_flight_.pop_front();
+
+        // A slot in the pipeline became free
+        schedule_write();
+        if (!in_flight_.empty())
+            read_next();
+
+        complete(std::move(handler), error_code(), header_size);
+    }
+
+    // Breaks the connection. Pending requests are failed once the read and write in progress,
+    // which may reference their buffers, have finished
+    void fail(error_code ec)
+    {
+        if (!error_)
+        {
+            error_ = ec;
+            error_code ignored;
+            stream_.lowest_layer().cancel(ignored);
+        }
+        if (reading_ || writing_)
+            return;
+
+        auto in_flight = std::exchange(in_flight_, {});
+        auto queued = std::exchange(queued_, {});
+        for (auto* requests : {&in_flight, &queued})
+        {
+            for (auto& r : *requests)
+                boost::asio::post(boost::asio::append(std::move(r.handler), error_, std::size_t(0)));
+        }
+    }
+
+public:
+    // stream must be connected. max_depth is the maximum number of requests in flight
+    http_pipeline(AsyncStream& stream, std::size_t max_depth = 16)
+        : stream_(stream), max_depth_(std::max<std::size_t>(max_depth, 1u))
+    {
+    }
+
+    http_pipeline(const http_pipeline&) = delete;
+    http_pipeline& operator=(const http_pipeline&) = delete;
+
+    AsyncStream& stream() noexcept { return stream_; }
+    std::size_t max_depth() const noexcept { return max_depth_; }
+
+    // Requests that have been submitted but not completed yet
+    std::size_t pending() const noexcept { return queued_.size() + in_flight_.size(); }
+
+    // The error that broke the connection, if any
+    error_code error() const noexcept { return error_; }
+
+    // Low-level interface used by async_pipelined_request. req and buff must be valid
+    // until the handler is called. The handler is never called from within this function.
+    void submit(std::string_view req, std::string& buff, handler_type handler)
+    {
+        if (error_)
+        {
+            boost::asio::post(boost::asio::append(std::move(handler), error_, std::size_t(0)));
+            return;
+        }
+        queued_.push_back(pending_request{req, &buff, std::move(handler)});
+        schedule_write();
+    }
+
+    // Fails all pending requests with operation_aborted. The pipeline can't be used afterwards
+    void cancel()
+    {
+        if (!error_)
+            fail(boost::asio::error::operation_aborted);
+    }
+};
+
+// The operation submitted to the pipeline. It's type-erased into an any_completion_handler
+// while it waits in the queue, and resumed when its response arrives
+template <class AsyncStream>
+struct pipelined_request_op
+{
+    http_pipeline<AsyncStream>& pipeline;
+    std::string_view req;
+    std::string& buff;
+
+    template <class Self>
+    void operator()(Self& self)
+    {
+        pipeline.submit(req, buff, std::move(self));
+    }
+
+    template <class Self>
+    void operator()(Self& self, boost::system::error_code ec, std::size_t header_size)
+    {
+        self.complete(ec, header_size);
+    }
+};
+
+// Sends req through the pipeline and reads its response into buff.
+// Completes with the size of the response headers, like handle_request_op does.
+// buff contains the headers followed by the body
+template <
+    class AsyncStream,
+    boost::asio::completion_token_for<void(boost::system::error_code, std::size_t)> CompletionToken>
+auto async_pipelined_request(
+    http_pipeline<AsyncStream>& pipeline,
+    std::string_view req,
+    std::string& buff,
+    CompletionToken&& token
+)
+{
+    return boost::asio::async_compose<CompletionToken, void(boost::system::error_code, std::size_t)>(
+        pipelined_request_op<AsyncStream>{pipeline, req, buff},
+        token,
+        pipeline.stream()
+    );
+}
+
+#endif
@@ -0,0 +1,151 @@
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <utility>
+
+#include "http_pipeline.hpp"
+#include "latency_histogram.hpp"
+
+// Measures requests/s, latency and read/write calls per request when sending requests through
+// an http_pipeline with increasing depths. Depth 1 is a plain keep-alive connection,
+// where each request waits for the previous response.
+// Usage: http_pipeline_bench [host] [port] [total-requests] [connections]
+
+namespace asio = boost::asio;
+
+struct bench_config
+{
+    std::string host{"127.0.0.1"};
+    std::string port{"8080"};
+    std::size_t total_requests{200000};
+    std::size_t connections{4};
+    std::string request;
+};
+
+// Forwards to a socket, counting the read and write calls. Each of them is a syscall
+class counting_socket
+{
+    asio::ip::tcp::socket sock_;
+
+public:
+    using executor_type = asio::ip::tcp::socket::executor_type;
+    using lowest_layer_type = asio::ip::tcp::socket::lowest_layer_type;
+
+    std::uint64_t reads{0};
+    std::uint64_t writes{0};
+
+    explicit counting_socket(executor_type ex) : sock_(std::move(ex)) {}
+
+    executor_type get_executor() { return sock_.get_executor(); }
+    lowest_layer_type& lowest_layer() { return sock_.lowest_layer(); }
+    asio::ip::tcp::socket& socket() { return sock_; }
+
+    template <class MutableBufferSequence, class CompletionToken>
+    auto async_read_some(const MutableBufferSequence& buffers, CompletionToken&& token)
+    {
+        ++reads;
+        return sock_.async_read_some(buffers, std::forward<CompletionToken>(token));
+    }
+
+    template <class ConstBufferSequence, class CompletionToken>
+    auto async_write_some(const ConstBufferSequence& buffers, CompletionToken&& token)
+    {
+        ++writes;
+        return sock_.async_write_some(buffers, std::forward<CompletionToken>(token));
+    }
+};
+
+// Issues requests through the pipeline until the shared budget is exhausted.
+// There are as many of these per connection as the pipeline depth, to keep it full
+static asio::awaitable<void> worker(
+    const bench_config& cfg,
+    http_pipeline<counting_socket>& pipeline,
+    std::size_t& remaining,
+    latency_histogram& hist
+)
+{
+    std::string buff;
+    while (remaining > 0)
+    {
+        --remaining;
+        auto start = std::chrono::steady_clock::now();
+        co_await async_pipelined_request(pipeline, cfg.request, buff, asio::deferred);
+        hist.record(std::chrono::steady_clock::now() - start);
+    }
+}
+
+static void run_benchmark(const bench_config& cfg, std::size_t depth)
+{
+    asio::io_context ctx;
+    std::size_t remaining = cfg.total_requests;
+    latency_histogram hist;
+
+    // Connect all the sockets before starting to measure
+    asio::ip::tcp::resolver resolv(ctx);
+    auto endpoints = resolv.resolve(cfg.host, cfg.port);
+    std::deque<counting_socket> sockets;
+    std::deque<http_pipeline<counting_socket>> pipelines;
+    for (std::size_t i = 0; i < cfg.connections; ++i)
+    {
+        auto& sock = sockets.emplace_back(ctx.get_executor());
+        asio::connect(sock.socket(), endpoints);
+        auto& pipeline = pipelines.emplace_back(sock, depth);
+        for (std::size_t j = 0; j < depth; ++j)
+        {
+            asio::co_spawn(ctx, worker(cfg, pipeline, remaining, hist), [](std::exception_ptr exc) {
+                if (exc)
+                    std::rethrow_exception(exc);
+            });
+        }
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    ctx.run();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::uint64_t reads = 0, writes = 0;
+    for (const auto& sock : sockets)
+    {
+        reads += sock.reads;
+        writes += sock.writes;
+    }
+    double total = static_cast<double>(hist.count());
+    std::cout << "depth " << depth << ": " << total / elapsed.count() << " requests/s\n"
+              << "  writes/request: " << writes / total << ", reads/request: " << reads / total << "\n"
+              << "  latency: " << hist << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    bench_config cfg;
+    if (argc > 1)
+        cfg.host = argv[1];
+    if (argc > 2)
+        cfg.port = argv[2];
+    if (argc > 3)
+        cfg.total_requests = std::stoul(argv[3]);
+    if (argc > 4)
+        cfg.connections = std::stoul(argv[4]);
+
+    cfg.request = "GET / HTTP/1.1\r\n"
+                  "Host: " +
+                  cfg.host +
+                  "\r\n"
+                  "User-Agent: Asio\r\n"
+                  "Accept: */*\r\n\r\n";
+
+    for (std::size_t depth : {1, 4, 16, 64})
+        run_benchmark(cfg, depth);
+}
@@ -0,0 +1,371 @@
+#ifndef USINGSTDCPP_2024_HTTP_RESPONSE_PARSER_HPP
+#define USINGSTDCPP_2024_HTTP_RESPONSE_PARSER_HPP
+
+#include <boost/asio/append.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/compose.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/system/error_category.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cctype>
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+// An incremental HTTP/1.1 response header parser that doesn't copy.
+// Data is read directly into the parser's fixed-size buffer, which is allocated once
+// and reused across responses. Once the headers are complete, the status line, headers
+// and Content-Length are available as string_views into that buffer.
+//
+// Compared to async_read_until(sock, dynamic_buffer(str), "\r\n\r\n"):
+//   - The end of the headers is searched using SIMD, 16 or 32 bytes at a time.
+//   - Each byte is scanned once: after a partial read, the search resumes where it left off,
+//     instead of rescanning the whole buffer.
+//   - There is no growing std::string: the buffer has a fixed capacity, and headers
+//     that don't fit are reported as an error.
+//
+// async_read_response_header is an async_compose-based operation to use it with any async stream.
+
+enum class http_parser_errc
+{
+    header_too_large = 1,  // The headers don't fit in the parser's buffer
+    bad_status_line,
+    bad_header,
+    too_many_headers,
+    no_content_length,  // The response length can't be determined without closing the connection
+};
+
+inline const boost::system::error_category& http_parser_category() noexcept
+{
+    struct category final : boost::system::error_category
+    {
+        const char* name() const noexcept override { return "http_parser"; }
+        std::string message(int ev) const override
+        {
+            switch (static_cast<http_parser_errc>(ev))
+            {
+            case http_parser_errc::header_too_large: return "the response headers are too large";
+            case http_parser_errc::bad_status_line: return "malformed status line";
+            case http_parser_errc::bad_header: return "malformed header field";
+            case http_parser_errc::too_many_headers: return "too many header fields";
+            case http_parser_errc::no_content_length: return "the response has no Content-Length";
+            default: return "unknown http_parser error";
+            }
+        }
+    };
+    static const category cat;
+    return cat;
+}
+
+inline boost::system::error_code make_error_code(http_parser_errc e) noexcept
+{
+    return boost::system::error_code(static_cast<int>(e), http_parser_category());
+}
+
+template <>
+struct boost::system::is_error_code_enum<http_parser_errc> : std::true_type
+{
+};
+
+// Finds the first "\r\n\r\n" in [first, last). Returns nullptr if not found
+inline const char* find_header_terminator(const char* first, const char* last) noexcept
+{
+    constexpr char terminator[] = "\r\n\r\n";
+
+    // Compare a block of bytes against \r at once, and only look at the positions that match.
+    // The blocks stop 3 bytes before the end, so the 4-byte comparison never reads out of bounds
+#if defined(__AVX2__)
+    const __m256i cr32 = _mm256_set1_epi8('\r');
+    while (last - first >= 32 + 3)
+    {
+        auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+        auto mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, cr32)));
+        for (; mask != 0; mask &= mask - 1)
+        {
+            const char* candidate = first + std::countr_zero(mask);
+            if (std::memcmp(candidate, terminator, 4) == 0)
+                return candidate;
+        }
+        first += 32;
+    }
+#endif
+#if defined(__SSE2__)
+    const __m128i cr16 = _mm_set1_epi8('\r');
+    while (last - first >= 16 + 3)
+    {
+        auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+        auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, cr16)));
+        for (; mask != 0; mask &= mask - 1)
+        {
+            const char* candidate = first + std::countr_zero(mask);
+            if (std::memcmp(candidate, terminator, 4) == 0)
+                return candidate;
+        }
+        first += 16;
+    }
+#endif
+
+    // Scalar tail, or the whole range if no SIMD is available
+    for (; last - first >= 4; ++first)
+    {
+        if (*first == '\r' && std::memcmp(first, terminator, 4) == 0)
+            return first;
+    }
+    return nullptr;
+}
+
+struct http_header_field
+{
+    std::string_view name;
+    std::string_view value;
+};
+
+class http_response_parser
+{
+    static constexpr std::size_t max_headers = 64;
+
+    std::unique_ptr<char[]> buff_;
+    std::size_t capacity_;
+    std::size_t size_{0};     // Bytes received
+    std::size_t scanned_{0};  // Bytes already searched for the terminator
+    std::size_t header_size_{0};  // Including the final \r\n\r\n. 0 if not done yet
+
+    int version_minor_{0};
+    int status_code_{0};
+    std::string_view reason_;
+    std::array<http_header_field, max_headers> headers_;
+    std::size_t num_headers_{0};
+    std::optional<std::size_t> content_length_;
+
+    static bool iequals(std::string_view a, std::string_view b) noexcept
+    {
+        auto to_lower = [](char c) { return std::tolower(static_cast<unsigned char>(c)); };
+        auto eq = [to_lower](char c1, char c2) { return to_lower(c1) == to_lower(c2); };
+        return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), eq);
+    }
+
+    static std::string_view trim(std::string_view s) noexcept
+    {
+        while (!s.empty() && (s.front() == ' ' || s.front() == '\t'))
+            s.remove_prefix(1);
+        while (!s.empty() && (s.back() == ' ' || s.back() == '\t'))
+            s.remove_suffix(1);
+        return s;
+    }
+
+    // Parses the status line and headers. headers includes the final \r\n, but not the empty line
+    boost::system::error_code parse_headers(std::string_view headers) noexcept
+    {
+        // Status line: HTTP/1.1 200 OK
+        std::size_t line_end = headers.find("\r\n");
+        std::string_view line = headers.substr(0, line_end);
+        bool valid = line.size() >= 12 && line.starts_with("HTTP/1.") &&
+                     std::isdigit(static_cast<unsigned char>(line[7])) && line[8] == ' ' &&
+                     (line.size() == 12 || line[12] == ' ');
+        if (!valid)
+            return http_parser_errc::bad_status_line;
+        version_minor_ = line[7] - '0';
+
+        // Exactly three digits. from_chars would also accept a sign
+        auto is_digit = [](char c) { return std::isdigit(static_cast<unsigned char>(c)) != 0; };
+        if (!std::all_of(line.begin() + 9, line.begin() + 12, is_digit))
+            return http_parser_errc::bad_status_line;
+        status_code_ = (line[9] - '0') * 100 + (line[10] - '0') * 10 + (line[11] - '0');
+        if (status_code_ < 100 || status_code_ > 599)
+            return http_parser_errc::bad_status_line;
+        reason_ = line.size() > 13 ? line.substr(13) : std::string_view();
+
+        // Header fields
+        for (std::size_t pos = line_end + 2; pos < headers.size();)
+        {
+            std::size_t end = headers.find("\r\n", pos);
+            line = headers.substr(pos, end - pos);
+            pos = end + 2;
+
+            std::size_t colon = line.find(':');
+            if (colon == 0 || colon == std::string_view::npos)
+                return http_parser_errc::bad_header;
+            if (num_headers_ == max_headers)
+                return http_parser_errc::too_many_headers;
+            http_header_field& field = headers_[num_headers_++];
+            field.name = line.substr(0, colon);
+            field.value = trim(line.substr(colon + 1));
+
+            if (iequals(field.name, "content-length"))
+            {
+                std::size_t value = 0;
+                const char* value_end = field.value.data() + field.value.size();
+                auto res = std::from_chars(field.value.data(), value_end, value);
+                if (res.ec != std::errc() || res.ptr != value_end)
+                    return http_parser_errc::bad_header;
+                content_length_ = value;
+            }
+        }
+        return {};
+    }
+
+    void reset_state() noexcept
+    {
+        scanned_ = 0;
+        header_size_ = 0;
+        version_minor_ = 0;
+        status_code_ = 0;
+        reason_ = {};
+        num_headers_ = 0;
+        content_length_.reset();
+    }
+
+public:
+    // buffer_size is the maximum size of the headers
+    explicit http_response_parser(std::size_t buffer_size = 8192)
+        : buff_(new char[buffer_size]), capacity_(buffer_size)
+    {
+    }
+
+    // Space to read data into. Call commit() after reading
+    boost::asio::mutable_buffer prepare() noexcept
+    {
+        return boost::asio::buffer(buff_.get() + size_, capacity_ - size_);
+    }
+
+    void commit(std::size_t n) noexcept { size_ += n; }
+
+    // Looks for the end of the headers in the data received so far, and parses them if found.
+    // Returns true once the headers are complete. Can be called again after more data is committed.
+    bool parse(boost::system::error_code& ec) noexcept
+    {
+        ec.clear();
+        if (done())
+            return true;
+
+        // The terminator may have started in the previously scanned data
+        std::size_t from = scanned_ >= 3 ? scanned_ - 3 : 0;
+        const char* term = find_header_terminator(buff_.get() + from, buff_.get() + size_);
+        if (!term)
+        {
+            scanned_ = size_;
+            if (size_ == capacity_)
+                ec = http_parser_errc::header_too_large;
+            return false;
+        }
+
+        std::size_t terminator_pos = static_cast<std::size_t>(term - buff_.get());
+        ec = parse_headers(std::string_view(buff_.get(), terminator_pos + 2));
+        if (ec)
+            return false;
+        header_size_ = terminator_pos + 4;
+        return true;
+    }
+
+    bool done() const noexcept { return header_size_ != 0; }
+
+    // Valid once done() is true. Views point into the parser's buffer,
+    // and are invalidated by consume() and reset()
+    int version_minor() const noexcept { return version_minor_; }
+    int status_code() const noexcept { return status_code_; }
+    std::string_view reason() const noexcept { return reason_; }
+    std::span<const http_header_field> headers() const noexcept { return {headers_.data(), num_headers_}; }
+    std::optional<std::size_t> content_length() const noexcept { return content_length_; }
+    std::size_t header_size() const noexcept { return header_size_; }
+    std::string_view header_data() const noexcept { return {buff_.get(), header_size_}; }
+
+    // Case-insensitive header lookup
+    std::optional<std::string_view> find(std::string_view name) const noexcept
+    {
+        for (const auto& field : headers())
+        {
+            if (iequals(field.name, name))
+                return field.value;
+        }
+        return std::nullopt;
+    }
+
+    // Body bytes that were received together with the headers
+    std::string_view body_prefix() const noexcept
+    {
+        return {buff_.get() + header_size_, size_ - header_size_};
+    }
+
+    // Removes the first n bytes of received data (e.g. a complete response) and prepares
+    // to parse the next response. Any bytes after them (e.g. a pipelined response) are kept.
+    void consume(std::size_t n) noexcept
+    {
+        n = std::min(n, size_);
+        std::memmove(buff_.get(), buff_.get() + n, size_ - n);
+        size_ -= n;
+        reset_state();
+    }
+
+    // Discards all data and prepares to parse a new response
+    void reset() noexcept
+    {
+        size_ = 0;
+        reset_state();
+    }
+};
+
+// Reads from stream until parser has a complete response header.
+// Completes with the size of the header, like async_read_until does.
+template <class AsyncReadStream>
+struct read_response_header_op
+{
+    AsyncReadStream& stream;
+    http_response_parser& parser;
+
+    template <class Self>
+    void operator()(Self& self)
+    {
+        // The parser may already contain a complete response (e.g. from pipelining).
+        // Handlers must not be called from the initiating function, so post to check it
+        boost::asio::post(
+            stream.get_executor(),
+            boost::asio::append(std::move(self), boost::system::error_code(), std::size_t(0))
+        );
+    }
+
+    template <class Self>
+    void operator()(Self& self, boost::system::error_code ec, std::size_t bytes_transferred)
+    {
+        if (ec)
+            return self.complete(ec, 0u);
+        parser.commit(bytes_transferred);
+        if (parser.parse(ec))
+            return self.complete(ec, parser.header_size());
+        if (ec)
+            return self.complete(ec, 0u);
+        stream.async_read_some(parser.prepare(), std::move(self));
+    }
+};
+
+template <
+    class AsyncReadStream,
+    boost::asio::completion_token_for<void(boost::system::error_code, std::size_t)> CompletionToken>
+auto async_read_response_header(
+    AsyncReadStream& stream,
+    http_response_parser& parser,
+    CompletionToken&& token
+)
+{
+    return boost::asio::async_compose<CompletionToken, void(boost::system::error_code, std::size_t)>(
+        read_response_header_op<AsyncReadStream>{stream, parser},
+        token,
+        stream
+    );
+}
+
+#endif
@@ -0,0 +1,141 @@
+
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/system/error_code.hpp>
+#include <boost/system/system_error.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include "http_response_parser.hpp"
+
+// Microbenchmarks for http_response_parser against asio::read_until with a dynamic string buffer,
+// which is what the examples use to read the response headers.
+// Both read from an in-memory stream that returns data in segments of a fixed size, like
+// a socket receiving TCP segments, so we only measure the cost of buffering and scanning.
+
+namespace asio = boost::asio;
+using boost::system::error_code;
+
+// A SyncReadStream returning a fixed message in segments of segment_size bytes
+class memory_stream
+{
+    std::string_view data_;
+    std::size_t segment_size_;
+    std::size_t pos_{0};
+
+public:
+    memory_stream(std::string_view data, std::size_t segment_size) : data_(data), segment_size_(segment_size)
+    {
+    }
+
+    void rewind() noexcept { pos_ = 0; }
+
+    template <class MutableBufferSequence>
+    std::size_t read_some(const MutableBufferSequence& buffers, error_code& ec)
+    {
+        if (pos_ == data_.size())
+        {
+            ec = asio::error::eof;
+            return 0;
+        }
+        ec.clear();
+        std::size_t n = asio::buffer_copy(buffers, asio::buffer(data_.substr(pos_, segment_size_)));
+        pos_ += n;
+        return n;
+    }
+
+    template <class MutableBufferSequence>
+    std::size_t read_some(const MutableBufferSequence& buffers)
+    {
+        error_code ec;
+        std::size_t n = read_some(buffers, ec);
+        if (ec)
+            throw boost::system::system_error(ec);
+        return n;
+    }
+};
+
+// A response whose headers have approximately the given size
+static std::string make_response(std::size_t header_size)
+{
+    std::string res = "HTTP/1.1 200 OK\r\nContent-Type: text/html; charset=UTF-8\r\nContent-Length: 0\r\n";
+    for (int i = 0; res.size() + 2 < header_size; ++i)
+        res += "X-Header-" + std::to_string(i) + ": some-value-that-makes-the-header-longer\r\n";
+    res += "\r\n";
+    return res;
+}
+
+// Prevent the compiler from optimizing the work away
+static volatile std::size_t sink;
+
+template <class Function>
+static void measure(
+    std::string_view name,
+    std::size_t bytes_per_iteration,
+    std::size_t iterations,
+    Function fn
+)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < iterations; ++i)
+        sink = fn();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double mbps = bytes_per_iteration * iterations / elapsed.count() / (1024 * 1024);
+    std::cout << "  " << name << ": " << mbps << " MB/s, "
+              << std::chrono::duration<double, std::nano>(elapsed).count() / iterations << " ns/response\n";
+}
+
+int main()
+{
+    constexpr std::size_t total_bytes = 256 * 1024 * 1024;
+
+    for (std::size_t header_size : {256, 2048, 16384})
+    {
+        std::string response = make_response(header_size);
+        std::size_t iterations = total_bytes / response.size();
+
+        // Only the scanning, on the complete header
+        std::cout << "Headers of " << response.size() << " bytes, searching for the terminator:\n";
+        measure("std::string_view::find", response.size(), iterations, [&] {
+            return std::string_view(response).find("\r\n\r\n");
+        });
+        measure("find_header_terminator", response.size(), iterations, [&] {
+            return static_cast<std::size_t>(
+                find_header_terminator(response.data(), response.data() + response.size()) - response.data()
+            );
+        });
+
+        // The full read operation, with the data arriving in segments
+        for (std::size_t segment_size : {64, 1460, 65536})
+        {
+            std::cout << "Headers of " << response.size() << " bytes, read in segments of " << segment_size
+                      << " bytes:\n";
+            memory_stream stream(response, segment_size);
+
+            measure("read_until", response.size(), iterations, [&] {
+                stream.rewind();
+                std::string buff;
+                return asio::read_until(stream, asio::dynamic_buffer(buff), "\r\n\r\n");
+            });
+
+            http_response_parser parser(32 * 1024);
+            measure("http_response_parser", response.size(), iterations, [&] {
+                stream.rewind();
+                parser.reset();
+                error_code ec;
+                while (!parser.parse(ec))
+                {
+                    if (ec)
+                        throw boost::system::system_error(ec);
+                    parser.commit(stream.read_some(parser.prepare()));
+                }
+                return parser.header_size();
+            });
+        }
+    }
+}
@@ -0,0 +1,29 @@
+#ifndef USINGSTDCPP_2024_IO_CONTEXT_OF_HPP
+#define USINGSTDCPP_2024_IO_CONTEXT_OF_HPP
+
+#include <boost/asio/io_context.hpp>
+
+#include <stdexcept>
+#include <type_traits>
+
+// The io_context running ex, for services that only make sense on an io_context
+// (timer_wheel, request_handler_pool, coroutine_frame_pool).
+// ex must be an io_context executor, or a polymorphic executor holding one, like any_io_executor.
+// Throws std::invalid_argument otherwise.
+template <class Executor>
+boost::asio::io_context& io_context_of(const Executor& ex)
+{
+    // execution_context isn't polymorphic, so we can't dynamic_cast it to io_context.
+    // Look at the executor's type instead
+    using io_executor = boost::asio::io_context::executor_type;
+    const io_executor* io_ex = nullptr;
+    if constexpr (std::is_same_v<Executor, io_executor>)
+        io_ex = &ex;
+    else if constexpr (requires { ex.template target<io_executor>(); })
+        io_ex = ex.template target<io_executor>();
+    if (!io_ex)
+        throw std::invalid_argument("The executor doesn't belong to an io_context");
+    return io_ex->context();
+}
+
+#endif
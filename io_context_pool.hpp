@@ -0,0 +1,198 @@
+#ifndef USINGSTDCPP_2024_IO_CONTEXT_POOL_HPP
+#define USINGSTDCPP_2024_IO_CONTEXT_POOL_HPP
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/consign.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Runs N io_contexts, each one in its own thread, optionally pinned to a CPU core.
+// This is the "one io_context per thread" model: each context is single-threaded,
+// so I/O objects created from one of its executors (sockets, timers...) stay on that thread
+// for their whole lifetime, and don't need any synchronization.
+// Work is distributed by choosing which context to start each operation on.
+//
+// Since get_executor() returns an any_io_executor, functions like handle_request(any_io_executor)
+// work unchanged: handle_request(pool.get_executor()).
+
+enum class spawn_policy
+{
+    round_robin,   // Cycle through the contexts
+    least_loaded,  // Pick the context with the least coroutines spawned through co_spawn() in flight
+};
+
+class io_context_pool
+{
+    struct context_data
+    {
+        boost::asio::io_context ctx{1};  // Single-threaded, so Asio can skip some locking
+        std::optional<boost::asio::executor_work_guard<boost::asio::io_context::executor_type>> work;
+        std::atomic<std::size_t> load{0};
+        std::thread thread;
+    };
+
+    // Decrements the load of a context when destroyed. Attached to the completion token
+    // of spawned coroutines using asio::consign, so it lives until the coroutine completes
+    class load_tracker
+    {
+        std::atomic<std::size_t>* load_;
+
+    public:
+        explicit load_tracker(std::atomic<std::size_t>& load) noexcept : load_(&load)
+        {
+            load_->fetch_add(1, std::memory_order_relaxed);
+        }
+        load_tracker(load_tracker&& rhs) noexcept : load_(std::exchange(rhs.load_, nullptr)) {}
+        load_tracker& operator=(load_tracker&&) = delete;
+        ~load_tracker()
+        {
+            if (load_)
+                load_->fetch_sub(1, std::memory_order_relaxed);
+        }
+    };
+
+    std::vector<std::unique_ptr<context_data>> contexts_;
+    std::atomic<std::size_t> next_{0};
+    bool pin_threads_;
+
+    static void pin_to_core(std::thread& t, std::size_t core)
+    {
+#ifdef __linux__
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(core % std::max(1u, std::thread::hardware_concurrency()), &set);
+        pthread_setaffinity_np(t.native_handle(), sizeof(set), &set);
+#else
+        (void)t;
+        (void)core;
+#endif
+    }
+
+    std::size_t next_round_robin() noexcept
+    {
+        return next_.fetch_add(1, std::memory_order_relaxed) % contexts_.size();
+    }
+
+    std::size_t least_loaded() const noexcept
+    {
+        auto it = std::min_element(contexts_.begin(), contexts_.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs->load.load(std::memory_order_relaxed) < rhs->load.load(std::memory_order_relaxed);
+        });
+        return static_cast<std::size_t>(it - contexts_.begin());
+    }
+
+    std::size_t pick(spawn_policy policy) noexcept
+    {
+        return policy == spawn_policy::round_robin ? next_round_robin() : least_loaded();
+    }
+
+public:
+    // Creates the contexts. Threads aren't launched until start() is called
+    explicit io_context_pool(
+        std::size_t size = std::max(1u, std::thread::hardware_concurrency()),
+        bool pin_threads = true
+    )
+        : pin_threads_(pin_threads)
+    {
+        contexts_.reserve(size);
+        for (std::size_t i = 0; i < std::max<std::size_t>(size, 1u); ++i)
+            contexts_.push_back(std::make_unique<context_data>());
+    }
+
+    io_context_pool(const io_context_pool&) = delete;
+    io_context_pool& operator=(const io_context_pool&) = delete;
+
+    ~io_context_pool()
+    {
+        stop();
+        join();
+    }
+
+    std::size_t size() const noexcept { return contexts_.size(); }
+
+    // Launches one thread per context. Contexts keep running until join() or stop() are called,
+    // even if they run out of work.
+    void start()
+    {
+        for (std::size_t i = 0; i < contexts_.size(); ++i)
+        {
+            auto& data = *contexts_[i];
+            data.work.emplace(data.ctx.get_executor());
+            data.thread = std::thread([&data] { data.ctx.run(); });
+            if (pin_threads_)
+                pin_to_core(data.thread, i);
+        }
+    }
+
+    // Lets contexts finish their outstanding work, then waits for all threads to exit
+    void join()
+    {
+        for (auto& data : contexts_)
+            data->work.reset();
+        for (auto& data : contexts_)
+        {
+            if (data->thread.joinable())
+                data->thread.join();
+        }
+    }
+
+    // Stops all contexts as soon as possible, abandoning outstanding work
+    void stop()
+    {
+        for (auto& data : contexts_)
+            data->ctx.stop();
+    }
+
+    // Returns an executor for one of the contexts, chosen in a round-robin fashion.
+    // I/O objects created with this executor are bound to that context.
+    boost::asio::any_io_executor get_executor() noexcept
+    {
+        return contexts_[next_round_robin()]->ctx.get_executor();
+    }
+
+    // Returns an executor for the i-th context
+    boost::asio::any_io_executor get_executor(std::size_t i) noexcept
+    {
+        return contexts_[i]->ctx.get_executor();
+    }
+
+    // Number of coroutines spawned with co_spawn() that haven't completed yet, for the i-th context
+    std::size_t load(std::size_t i) const noexcept
+    {
+        return contexts_[i]->load.load(std::memory_order_relaxed);
+    }
+
+    // Like asio::co_spawn, but chooses the context to run the coroutine in.
+    // The coroutine runs entirely in the chosen context.
+    template <class AwaitableOrFunction, class CompletionToken>
+    auto co_spawn(
+        AwaitableOrFunction&& fn,
+        CompletionToken&& token,
+        spawn_policy policy = spawn_policy::least_loaded
+    )
+    {
+        auto& data = *contexts_[pick(policy)];
+        return boost::asio::co_spawn(
+            data.ctx,
+            std::forward<AwaitableOrFunction>(fn),
+            boost::asio::consign(std::forward<CompletionToken>(token), load_tracker(data.load))
+        );
+    }
+};
+
+#endif
@@ -0,0 +1,130 @@
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/write.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "io_context_pool.hpp"
+
+// Measures how the request workload of the examples scales with the number of cores,
+// by running it on an io_context_pool with 1, 2, 4... N threads.
+// Usage: io_context_pool_bench [host] [port] [total-requests] [concurrency] [max-threads]
+
+namespace asio = boost::asio;
+
+struct bench_config
+{
+    std::string host{"127.0.0.1"};
+    std::string port{"8080"};
+    std::size_t total_requests{1000};
+    std::size_t concurrency{64};
+    std::size_t max_threads{std::max(1u, std::thread::hardware_concurrency())};
+    std::string request;
+};
+
+// Shared between all threads
+struct bench_state
+{
+    // Every worker decrements this once past zero, so it must be signed
+    std::atomic<std::int64_t> remaining;
+    std::mutex mtx;
+    std::vector<std::chrono::steady_clock::duration> latencies;
+};
+
+// The same as handle_request_impl in coroutines.cpp. The socket and resolver are created
+// using the coroutine's executor, so they stay in the context the coroutine was spawned on
+static asio::awaitable<void> do_request(const bench_config& cfg, std::string& buff)
+{
+    auto ex = co_await asio::this_coro::executor;
+    asio::ip::tcp::socket sock(ex);
+    asio::ip::tcp::resolver resolv(ex);
+    auto endpoints = co_await resolv.async_resolve(cfg.host, cfg.port, asio::deferred);
+    co_await asio::async_connect(sock, endpoints, asio::deferred);
+    co_await asio::async_write(sock, asio::buffer(cfg.request), asio::deferred);
+    co_await asio::async_read_until(sock, asio::dynamic_buffer(buff), "\r\n\r\n", asio::deferred);
+}
+
+static asio::awaitable<void> worker(const bench_config& cfg, bench_state& st)
+{
+    // Record latencies locally to avoid contention, and merge them at the end
+    std::vector<std::chrono::steady_clock::duration> latencies;
+    std::string buff;
+    while (st.remaining.fetch_sub(1, std::memory_order_relaxed) > 0)
+    {
+        buff.clear();
+        auto start = std::chrono::steady_clock::now();
+        co_await do_request(cfg, buff);
+        latencies.push_back(std::chrono::steady_clock::now() - start);
+    }
+
+    std::lock_guard<std::mutex> lock(st.mtx);
+    st.latencies.insert(st.latencies.end(), latencies.begin(), latencies.end());
+}
+
+static void run_benchmark(const bench_config& cfg, std::size_t num_threads)
+{
+    io_context_pool pool(num_threads);
+    bench_state st;
+    st.remaining = static_cast<std::int64_t>(cfg.total_requests);
+
+    for (std::size_t i = 0; i < cfg.concurrency; ++i)
+    {
+        pool.co_spawn(worker(cfg, st), [](std::exception_ptr exc) {
+            if (exc)
+                std::rethrow_exception(exc);
+        });
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    pool.start();
+    pool.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::sort(st.latencies.begin(), st.latencies.end());
+    auto p99 = st.latencies.empty() ? std::chrono::steady_clock::duration()
+                                     : st.latencies[st.latencies.size() * 99 / 100];
+    std::cout << num_threads << " threads: " << st.latencies.size() / elapsed.count() << " requests/s, p99 "
+              << std::chrono::duration_cast<std::chrono::microseconds>(p99).count() << "us" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    bench_config cfg;
+    if (argc > 1)
+        cfg.host = argv[1];
+    if (argc > 2)
+        cfg.port = argv[2];
+    if (argc > 3)
+        cfg.total_requests = std::stoul(argv[3]);
+    if (argc > 4)
+        cfg.concurrency = std::stoul(argv[4]);
+    if (argc > 5)
+        cfg.max_threads = std::stoul(argv[5]);
+
+    cfg.request = "GET / HTTP/1.1\r\n"
+                  "Host: " +
+                  cfg.host +
+                  "\r\n"
+                  "User-Agent: Asio\r\n"
+                  "Accept: */*\r\n\r\n";
+
+    for (std::size_t n = 1; n < cfg.max_threads; n *= 2)
+        run_benchmark(cfg, n);
+    run_benchmark(cfg, cfg.max_threads);
+}
@@ -0,0 +1,126 @@
+#ifndef USINGSTDCPP_2024_LATENCY_HISTOGRAM_HPP
+#define USINGSTDCPP_2024_LATENCY_HISTOGRAM_HPP
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <ostream>
+#include <vector>
+
+// A latency histogram in the style of HdrHistogram.
+// Values are recorded in nanoseconds into log-linear buckets: each power of two is split
+// into a fixed number of linear sub-buckets, so the relative error is bounded
+// (below 1.6%, 1/64, with the default 7 bits) while using a few KB of memory regardless of the range.
+// Recording is O(1) and allocation-free. Not thread-safe: record into one histogram
+// per thread and merge() them at the end.
+
+class latency_histogram
+{
+public:
+    using duration = std::chrono::nanoseconds;
+
+private:
+    static constexpr unsigned sub_bucket_bits = 7;
+    static constexpr std::uint64_t sub_bucket_count = std::uint64_t(1) << sub_bucket_bits;
+    static constexpr std::uint64_t sub_bucket_half = sub_bucket_count / 2;
+
+    // Values below sub_bucket_count map to themselves. Above that, the bucket is given by
+    // the position of the most significant bit, and the sub-bucket by the following bits
+    static constexpr std::size_t num_buckets = 64 - sub_bucket_bits + 1;
+    static constexpr std::size_t num_counts = (num_buckets + 1) * sub_bucket_half;
+
+    std::vector<std::uint64_t> counts_;
+    std::uint64_t total_{0};
+    std::uint64_t min_{std::numeric_limits<std::uint64_t>::max()};
+    std::uint64_t max_{0};
+    long double sum_{0};
+
+    static std::size_t index_for(std::uint64_t value) noexcept
+    {
+        if (value < sub_bucket_count)
+            return static_cast<std::size_t>(value);
+        unsigned bucket = static_cast<unsigned>(std::bit_width(value)) - sub_bucket_bits;
+        return static_cast<std::size_t>(bucket * sub_bucket_half + (value >> bucket));
+    }
+
+    // The highest value that maps to the given index, like HdrHistogram's "highest equivalent value"
+    static std::uint64_t highest_value_for(std::size_t index) noexcept
+    {
+        if (index < sub_bucket_count)
+            return index;
+        unsigned bucket = static_cast<unsigned>(index / sub_bucket_half) - 1;
+        std::uint64_t sub_bucket = index - bucket * sub_bucket_half;
+        return ((sub_bucket + 1) << bucket) - 1;
+    }
+
+public:
+    latency_histogram() : counts_(num_counts, 0) {}
+
+    void record(duration d) noexcept
+    {
+        auto value = static_cast<std::uint64_t>(std::max(d.count(), duration::rep(0)));
+        ++counts_[index_for(value)];
+        ++total_;
+        min_ = std::min(min_, value);
+        max_ = std::max(max_, value);
+        sum_ += value;
+    }
+
+    void merge(const latency_histogram& other) noexcept
+    {
+        for (std::size_t i = 0; i < num_counts; ++i)
+            counts_[i] += other.counts_[i];
+        total_ += other.total_;
+        min_ = std::min(min_, other.min_);
+        max_ = std::max(max_, other.max_);
+        sum_ += other.sum_;
+    }
+
+    void reset() noexcept
+    {
+        std::fill(counts_.begin(), counts_.end(), 0);
+        total_ = 0;
+        min_ = std::numeric_limits<std::uint64_t>::max();
+        max_ = 0;
+        sum_ = 0;
+    }
+
+    std::uint64_t count() const noexcept { return total_; }
+    duration min() const noexcept { return duration(total_ ? min_ : 0); }
+    duration max() const noexcept { return duration(max_); }
+    duration mean() const noexcept
+    {
+        return duration(total_ ? static_cast<duration::rep>(sum_ / total_) : 0);
+    }
+
+    // The value below which the given percentage of recorded values fall, e.g. percentile(99.9)
+    duration percentile(double p) const noexcept
+    {
+        if (total_ == 0)
+            return duration(0);
+        auto target = static_cast<std::uint64_t>(p / 100.0 * static_cast<double>(total_) + 0.5);
+        target = std::clamp<std::uint64_t>(target, 1, total_);
+        std::uint64_t acc = 0;
+        for (std::size_t i = 0; i < num_counts; ++i)
+        {
+            acc += counts_[i];
+            if (acc >= target)
+                return duration(static_cast<duration::rep>(std::min(highest_value_for(i), max_)));
+        }
+        return max();
+    }
+
+    // Prints a one-line summary, in microseconds
+    friend std::ostream& operator<<(std::ostream& os, const latency_histogram& h)
+    {
+        auto us = [](duration d) { return std::chrono::duration<double, std::micro>(d).count(); };
+        return os << "count=" << h.count() << " min=" << us(h.min()) << "us mean=" << us(h.mean())
+                  << "us p50=" << us(h.percentile(50)) << "us p99=" << us(h.percentile(99))
+                  << "us p999=" << us(h.percentile(99.9)) << "us max=" << us(h.max()) << "us";
+    }
+};
+
+#endif
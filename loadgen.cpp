@@ -0,0 +1,625 @@
+
+#include <boost/asio/any_io_executor.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/compose.hpp>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/consign.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/system/error_code.hpp>
+#include <boost/system/system_error.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "http_response_parser.hpp"
+#include "io_context_pool.hpp"
+#include "latency_histogram.hpp"
+#include "pooled_request_handler.hpp"
+#include "request_tracing.hpp"
+
+// A load generator for the client patterns shown in the examples.
+// It runs the same workload (resolve, connect, write a GET, read the response headers)
+// using the sync, callback, coroutine and async_compose styles, so their costs can be compared.
+// callbacks_pooled is the callback style with recycled, non-atomically ref-counted handlers
+// (see pooled_request_handler.hpp).
+//
+// Usage: loadgen <sync|callbacks|callbacks_pooled|coroutines|composed> [options]
+//   --host <host>         Server to connect to (default: 127.0.0.1)
+//   --port <port>         Port to connect to (default: 8080)
+//   --requests <n>        Total number of requests (default: 10000)
+//   --concurrency <n>     Maximum requests in flight. For sync, the number of threads (default: 1000)
+//   --threads <n>         io_context threads for the async variants (default: 1)
+//   --rate <n>            Requests per second. If 0, runs as fast as possible (default: 0)
+//   --reader <r>          read_until or parser (http_response_parser). Only for coroutines and composed
+//   --trace <file>        With ENABLE_REQUEST_TRACING, write a Chrome trace of the request stages to file
+//
+// With --rate, requests are started on a fixed schedule regardless of how long previous
+// requests take (open loop), and latency is measured from the scheduled start time.
+// This avoids the "coordinated omission" problem of measuring from the actual start.
+
+namespace asio = boost::asio;
+using boost::system::error_code;
+using clock_type = std::chrono::steady_clock;
+
+struct loadgen_config
+{
+    std::string variant;
+    std::string host{"127.0.0.1"};
+    std::string port{"8080"};
+    std::size_t total_requests{10000};
+    std::size_t concurrency{1000};
+    std::size_t threads{1};
+    double rate{0};
+    bool use_parser{false};  // Read the response with http_response_parser instead of read_until
+    std::string trace_file;
+    std::string request;
+};
+
+// Per-thread results, merged at the end
+struct thread_stats
+{
+    latency_histogram hist;
+    std::uint64_t errors{0};
+    std::uint64_t dropped{0};  // Open loop only: requests not started because of the concurrency limit
+    error_code last_error;
+
+    void on_request_finished(error_code ec, clock_type::time_point start)
+    {
+        if (ec)
+        {
+            ++errors;
+            last_error = ec;
+        }
+        else
+        {
+            hist.record(clock_type::now() - start);
+        }
+    }
+};
+
+//
+// The request variants. Each one starts a request and calls a callback with an error_code when done
+//
+
+// The same as handle_request_v4 in sync.cpp
+static error_code request_sync(asio::ip::tcp::resolver& resolv, const loadgen_config& cfg, std::string& buff)
+{
+    error_code ec;
+    asio::ip::tcp::socket sock(resolv.get_executor());
+    auto endpoints = resolv.resolve(cfg.host, cfg.port, ec);
+    if (!ec)
+        asio::connect(sock, endpoints, ec);
+    if (!ec)
+        asio::write(sock, asio::buffer(cfg.request), ec);
+    if (!ec)
+        asio::read_until(sock, asio::dynamic_buffer(buff), "\r\n\r\n", ec);
+    return ec;
+}
+
+// The same as request_handler in callbacks.cpp
+template <class Callback>
+class request_handler : public std::enable_shared_from_this<request_handler<Callback>>
+{
+    asio::ip::tcp::socket sock;
+    asio::ip::tcp::resolver resolv;
+    std::string buff;
+    const loadgen_config& cfg;
+    Callback cb;
+
+public:
+    request_handler(asio::any_io_executor ex, const loadgen_config& cfg, Callback cb)
+        : sock(ex), resolv(ex), cfg(cfg), cb(std::move(cb))
+    {
+    }
+
+    void start_resolve()
+    {
+        resolv.async_resolve(
+            cfg.host,
+            cfg.port,
+            [self = this->shared_from_this()](error_code ec, auto endpoints) {
+                if (ec)
+                    self->cb(ec);
+                else
+                    self->start_connect(std::move(endpoints));
+            }
+        );
+    }
+
+    void start_connect(const asio::ip::tcp::resolver::results_type& endpoints)
+    {
+        asio::async_connect(sock, endpoints, [self = this->shared_from_this()](error_code ec, auto) {
+            if (ec)
+                self->cb(ec);
+            else
+                self->start_write();
+        });
+    }
+
+    void start_write()
+    {
+        asio::async_write(
+            sock,
+            asio::buffer(cfg.request),
+            [self = this->shared_from_this()](error_code ec, std::size_t) {
+                if (ec)
+                    self->cb(ec);
+                else
+                    self->start_read();
+            }
+        );
+    }
+
+    void start_read()
+    {
+        asio::async_read_until(
+            sock,
+            asio::dynamic_buffer(buff),
+            "\r\n\r\n",
+            [self = this->shared_from_this()](error_code ec, std::size_t) { self->cb(ec); }
+        );
+    }
+};
+
+// The same as handle_request_impl in coroutines.cpp
+static asio::awaitable<void> request_coroutine(const loadgen_config& cfg)
+{
+    auto ex = co_await asio::this_coro::executor;
+    asio::ip::tcp::socket sock(ex);
+    asio::ip::tcp::resolver resolv(ex);
+    request_trace trace;
+    auto endpoints = co_await traced(
+        trace,
+        request_stage::resolve,
+        resolv.async_resolve(cfg.host, cfg.port, asio::deferred)
+    );
+    co_await traced(trace, request_stage::connect, asio::async_connect(sock, endpoints, asio::deferred));
+    co_await traced(
+        trace,
+        request_stage::write,
+        asio::async_write(sock, asio::buffer(cfg.request), asio::deferred)
+    );
+    if (cfg.use_parser)
+    {
+        http_response_parser parser;
+        co_await traced(trace, request_stage::read, async_read_response_header(sock, parser, asio::deferred));
+    }
+    else
+    {
+        std::string buff;
+        co_await traced(
+            trace,
+            request_stage::read,
+            asio::async_read_until(sock, asio::dynamic_buffer(buff), "\r\n\r\n", asio::deferred)
+        );
+    }
+    trace.enter(request_stage::done);
+}
+
+// The same as handle_request_op in composed.cpp, with a configurable host and port
+struct handle_request_op
+{
+    asio::ip::tcp::resolver& resolv;
+    asio::ip::tcp::socket& sock;
+    const loadgen_config& cfg;
+    std::string& buff;
+    http_response_parser* parser;  // If not null, used instead of buff and read_until
+    [[no_unique_address]] request_trace trace;
+
+    enum class state_t
+    {
+        initial,
+        resolving,
+        connecting,
+        writing,
+        reading,
+    } state{state_t::initial};
+
+    template <class Self>
+    void operator()(Self& self)
+    {
+        assert(state == state_t::initial);
+        state = state_t::resolving;
+        trace.enter(request_stage::resolve);
+        resolv.async_resolve(cfg.host, cfg.port, std::move(self));
+    }
+
+    template <class Self>
+    void operator()(Self& self, error_code ec, asio::ip::tcp::resolver::results_type endpoints)
+    {
+        if (ec)
+            return self.complete(ec, 0u);
+        assert(state == state_t::resolving);
+        state = state_t::connecting;
+        trace.enter(request_stage::connect);
+        asio::async_connect(sock, endpoints, std::move(self));
+    }
+
+    template <class Self>
+    void operator()(Self& self, error_code ec, asio::ip::tcp::endpoint)
+    {
+        if (ec)
+            return self.complete(ec, 0u);
+        assert(state == state_t::connecting);
+        state = state_t::writing;
+        trace.enter(request_stage::write);
+        asio::async_write(sock, asio::buffer(cfg.request), std::move(self));
+    }
+
+    template <class Self>
+    void operator()(Self& self, error_code ec, std::size_t bytes_transferred)
+    {
+        if (ec)
+            return self.complete(ec, 0u);
+
+        if (state == state_t::writing)
+        {
+            state = state_t::reading;
+            trace.enter(request_stage::read);
+            if (parser)
+                async_read_response_header(sock, *parser, std::move(self));
+            else
+                asio::async_read_until(sock, asio::dynamic_buffer(buff), "\r\n\r\n", std::move(self));
+        }
+        else
+        {
+            assert(state == state_t::reading);
+            trace.enter(request_stage::done);
+            self.complete(error_code(), bytes_transferred);
+        }
+    }
+};
+
+template <asio::completion_token_for<void(error_code, std::size_t)> CompletionToken>
+auto handle_request_generic(
+    asio::ip::tcp::resolver& resolv,
+    asio::ip::tcp::socket& sock,
+    const loadgen_config& cfg,
+    std::string& buff,
+    http_response_parser* parser,
+    CompletionToken&& token
+)
+{
+    return asio::async_compose<CompletionToken, void(error_code, std::size_t)>(
+        handle_request_op{resolv, sock, cfg, buff, parser},
+        token,
+        resolv,
+        sock
+    );
+}
+
+// Objects that must outlive the composed operation
+struct composed_request_state
+{
+    asio::ip::tcp::socket sock;
+    asio::ip::tcp::resolver resolv;
+    std::string buff;
+    std::optional<http_response_parser> parser;
+
+    composed_request_state(asio::any_io_executor ex, bool use_parser) : sock(ex), resolv(ex)
+    {
+        if (use_parser)
+            parser.emplace();
+    }
+};
+
+// Starts a request of the configured variant, calling cb(error_code) when done
+template <class Callback>
+static void start_request(asio::any_io_executor ex, const loadgen_config& cfg, Callback cb)
+{
+    if (cfg.variant == "callbacks")
+    {
+        std::make_shared<request_handler<Callback>>(ex, cfg, std::move(cb))->start_resolve();
+    }
+    else if (cfg.variant == "callbacks_pooled")
+    {
+        request_handler_pool<Callback>::use(ex).start(cfg.host, cfg.port, cfg.request, std::move(cb));
+    }
+    else if (cfg.variant == "coroutines")
+    {
+        asio::co_spawn(ex, request_coroutine(cfg), [cb = std::move(cb)](std::exception_ptr exc) mutable {
+            error_code ec;
+            if (exc)
+            {
+                try
+                {
+                    std::rethrow_exception(exc);
+                }
+                catch (const boost::system::system_error& err)
+                {
+                    ec = err.code();
+                }
+            }
+            cb(ec);
+        });
+    }
+    else
+    {
+        assert(cfg.variant == "composed");
+        // consign keeps the state alive until the operation completes
+        auto st = std::make_unique<composed_request_state>(ex, cfg.use_parser);
+        auto& st_ref = *st;
+        handle_request_generic(
+            st_ref.resolv,
+            st_ref.sock,
+            cfg,
+            st_ref.buff,
+            st_ref.parser ? &*st_ref.parser : nullptr,
+            asio::consign([cb = std::move(cb)](error_code ec, std::size_t) mutable { cb(ec); }, std::move(st))
+        );
+    }
+}
+
+//
+// Drivers
+//
+
+// Shared between all threads
+struct shared_state
+{
+    // Decremented once past zero by every worker, so it must be signed
+    std::atomic<std::int64_t> remaining;
+};
+
+// Closed loop: a fixed number of workers, each starting a new request as soon as the previous one finishes
+struct closed_loop_worker
+{
+    asio::any_io_executor ex;
+    const loadgen_config& cfg;
+    shared_state& shared;
+    thread_stats& stats;
+
+    void start()
+    {
+        if (shared.remaining.fetch_sub(1, std::memory_order_relaxed) <= 0)
+            return;
+        auto start_time = clock_type::now();
+        start_request(ex, cfg, [this, start_time](error_code ec) {
+            stats.on_request_finished(ec, start_time);
+            start();
+        });
+    }
+};
+
+// Open loop: starts requests at a fixed rate, independently of when they finish
+struct open_loop_pacer
+{
+    asio::steady_timer timer;
+    const loadgen_config& cfg;
+    thread_stats& stats;
+    std::size_t quota;           // Requests to start from this pacer
+    std::size_t max_in_flight;   // Requests above this are dropped
+    clock_type::duration interval;
+    clock_type::time_point next_time{};
+    std::size_t issued{0};
+    std::size_t in_flight{0};
+
+    void start()
+    {
+        next_time = clock_type::now();
+        tick();
+    }
+
+    void tick()
+    {
+        // If we're behind schedule, start all the requests we missed
+        while (issued < quota && next_time <= clock_type::now())
+        {
+            auto scheduled = next_time;
+            next_time += interval;
+            ++issued;
+            if (in_flight >= max_in_flight)
+            {
+                ++stats.dropped;
+                continue;
+            }
+            ++in_flight;
+            start_request(timer.get_executor(), cfg, [this, scheduled](error_code ec) {
+                --in_flight;
+                stats.on_request_finished(ec, scheduled);
+            });
+        }
+
+        if (issued < quota)
+        {
+            timer.expires_at(next_time);
+            timer.async_wait([this](error_code) { tick(); });
+        }
+    }
+};
+
+static std::vector<thread_stats> run_async(const loadgen_config& cfg)
+{
+    io_context_pool pool(cfg.threads);
+    std::vector<thread_stats> stats(cfg.threads);
+    shared_state shared{static_cast<std::int64_t>(cfg.total_requests)};
+
+    // Each worker/pacer runs in a single context, and only touches its context's stats
+    std::deque<closed_loop_worker> workers;
+    std::deque<open_loop_pacer> pacers;
+    if (cfg.rate == 0)
+    {
+        for (std::size_t i = 0; i < cfg.concurrency; ++i)
+        {
+            std::size_t ctx_idx = i % cfg.threads;
+            workers.push_back(closed_loop_worker{pool.get_executor(ctx_idx), cfg, shared, stats[ctx_idx]});
+            asio::post(pool.get_executor(ctx_idx), [&w = workers.back()] { w.start(); });
+        }
+    }
+    else
+    {
+        for (std::size_t i = 0; i < cfg.threads; ++i)
+        {
+            std::size_t quota = cfg.total_requests / cfg.threads + (i < cfg.total_requests % cfg.threads);
+            auto interval = std::chrono::duration_cast<clock_type::duration>(
+                std::chrono::duration<double>(cfg.threads / cfg.rate)
+            );
+            pacers.push_back(open_loop_pacer{
+                asio::steady_timer(pool.get_executor(i)),
+                cfg,
+                stats[i],
+                quota,
+                cfg.concurrency / cfg.threads + 1,
+                interval,
+            });
+            asio::post(pool.get_executor(i), [&p = pacers.back()] { p.start(); });
+        }
+    }
+
+    pool.start();
+    pool.join();
+    return stats;
+}
+
+static std::vector<thread_stats> run_sync(const loadgen_config& cfg)
+{
+    // The sync model can only achieve concurrency using threads
+    std::vector<thread_stats> stats(cfg.concurrency);
+    shared_state shared{static_cast<std::int64_t>(cfg.total_requests)};
+    std::vector<std::thread> threads;
+
+    for (std::size_t i = 0; i < cfg.concurrency; ++i)
+    {
+        threads.emplace_back([&cfg, &shared, &st = stats[i], i] {
+            asio::io_context ctx;
+            asio::ip::tcp::resolver resolv(ctx);
+            std::string buff;
+            auto interval = cfg.rate == 0 ? clock_type::duration()
+                                          : std::chrono::duration_cast<clock_type::duration>(
+                                                std::chrono::duration<double>(cfg.concurrency / cfg.rate)
+                                            );
+            // Stagger the threads so the requests are evenly spread
+            auto scheduled = clock_type::now() + interval * i / cfg.concurrency;
+            while (shared.remaining.fetch_sub(1, std::memory_order_relaxed) > 0)
+            {
+                if (cfg.rate != 0)
+                {
+                    std::this_thread::sleep_until(scheduled);
+                }
+                else
+                {
+                    scheduled = clock_type::now();
+                }
+                buff.clear();
+                st.on_request_finished(request_sync(resolv, cfg, buff), scheduled);
+                scheduled += interval;
+            }
+        });
+    }
+
+    for (auto& t : threads)
+        t.join();
+    return stats;
+}
+
+static void usage(const char* program)
+{
+    std::cerr << "Usage: " << program
+              << " <sync|callbacks|callbacks_pooled|coroutines|composed> [--host <host>] [--port <port>] "
+                 "[--requests <n>] [--concurrency <n>] [--threads <n>] [--rate <n>] "
+                 "[--reader <read_until|parser>] [--trace <file>]\n";
+    std::exit(1);
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+        usage(argv[0]);
+
+    loadgen_config cfg;
+    cfg.variant = argv[1];
+    if (cfg.variant != "sync" && cfg.variant != "callbacks" && cfg.variant != "callbacks_pooled" &&
+        cfg.variant != "coroutines" && cfg.variant != "composed")
+        usage(argv[0]);
+
+    for (int i = 2; i + 1 < argc; i += 2)
+    {
+        std::string_view opt = argv[i];
+        const char* value = argv[i + 1];
+        if (opt == "--host")
+            cfg.host = value;
+        else if (opt == "--port")
+            cfg.port = value;
+        else if (opt == "--requests")
+            cfg.total_requests = std::stoul(value);
+        else if (opt == "--concurrency")
+            cfg.concurrency = std::max<std::size_t>(std::stoul(value), 1u);
+        else if (opt == "--threads")
+            cfg.threads = std::max<std::size_t>(std::stoul(value), 1u);
+        else if (opt == "--rate")
+            cfg.rate = std::stod(value);
+        else if (opt == "--reader" && std::string_view(value) == "parser")
+            cfg.use_parser = true;
+        else if (opt == "--reader" && std::string_view(value) == "read_until")
+            cfg.use_parser = false;
+        else if (opt == "--trace")
+            cfg.trace_file = value;
+        else
+            usage(argv[0]);
+    }
+
+    cfg.request = "GET / HTTP/1.1\r\n"
+                  "Host: " +
+                  cfg.host +
+                  "\r\n"
+                  "User-Agent: Asio\r\n"
+                  "Accept: */*\r\n\r\n";
+
+    auto start = clock_type::now();
+    auto stats = cfg.variant == "sync" ? run_sync(cfg) : run_async(cfg);
+    std::chrono::duration<double> elapsed = clock_type::now() - start;
+
+    // Merge the per-thread results
+    thread_stats total;
+    for (const auto& st : stats)
+    {
+        total.hist.merge(st.hist);
+        total.errors += st.errors;
+        total.dropped += st.dropped;
+        if (st.last_error)
+            total.last_error = st.last_error;
+    }
+
+    std::cout << cfg.variant << ": " << total.hist.count() / elapsed.count() << " requests/s\n"
+              << "  latency: " << total.hist << "\n"
+              << "  errors: " << total.errors;
+    if (total.last_error)
+        std::cout << " (last: " << total.last_error.message() << ")";
+    std::cout << "\n  dropped: " << total.dropped << std::endl;
+
+    // Only the coroutine and composed variants are instrumented
+    if constexpr (request_tracing_enabled)
+    {
+        std::cout << "Time per stage:\n";
+        write_stage_histograms(std::cout);
+        if (!cfg.trace_file.empty())
+        {
+            std::ofstream trace_file(cfg.trace_file);
+            write_chrome_trace(trace_file);
+        }
+    }
+}
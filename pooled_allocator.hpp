@@ -0,0 +1,277 @@
+#ifndef USINGSTDCPP_2024_POOLED_ALLOCATOR_HPP
+#define USINGSTDCPP_2024_POOLED_ALLOCATOR_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+// Allocators to bind to completion tokens using asio::bind_allocator.
+// Asio allocates the state of each async operation (e.g. a pending read) using the allocator
+// associated to its completion handler, and frees it before calling the handler.
+// These allocations have a few well-known sizes and very short lifetimes, which makes them
+// a good fit for recycling.
+//
+//   - pooled_allocator<T> keeps per-thread free lists, one per power-of-two size class.
+//     Freed blocks are kept for reuse instead of being returned to the heap.
+//     It's stateless, so any thread can use it, and memory can be freed from a different thread.
+//   - arena_allocator<T> allocates from a request_arena, a bump allocator that releases all its
+//     memory at once when destroyed. Create one per request and bind it to all its operations.
+
+// Counters for the allocations performed by the current thread
+struct allocation_stats
+{
+    std::uint64_t allocations{0};
+    std::uint64_t deallocations{0};
+    std::uint64_t pool_hits{0};        // Allocations served from a free list
+    std::uint64_t heap_allocations{0};  // Allocations that had to call operator new
+};
+
+namespace detail {
+
+// Per-thread free lists
+class handler_memory_pool
+{
+    static constexpr std::size_t min_block_size = 16;
+    static constexpr std::size_t num_classes = 9;  // 16, 32, ..., 4096 bytes
+    static constexpr std::size_t max_cached_per_class = 256;
+
+    struct free_block
+    {
+        free_block* next;
+    };
+
+    free_block* free_lists_[num_classes]{};
+    std::size_t num_cached_[num_classes]{};
+    allocation_stats stats_;
+
+    static std::size_t size_class(std::size_t size) noexcept
+    {
+        return static_cast<std::size_t>(std::bit_width(std::max(size, min_block_size) - 1)) - 4;
+    }
+
+    static std::size_t class_size(std::size_t cls) noexcept { return min_block_size << cls; }
+
+    handler_memory_pool() = default;
+
+public:
+    handler_memory_pool(const handler_memory_pool&) = delete;
+    handler_memory_pool& operator=(const handler_memory_pool&) = delete;
+
+    ~handler_memory_pool()
+    {
+        for (std::size_t cls = 0; cls < num_classes; ++cls)
+        {
+            while (free_block* b = free_lists_[cls])
+            {
+                free_lists_[cls] = b->next;
+                ::operator delete(b);
+            }
+        }
+    }
+
+    static handler_memory_pool& instance() noexcept
+    {
+        thread_local handler_memory_pool pool;
+        return pool;
+    }
+
+    const allocation_stats& stats() const noexcept { return stats_; }
+    void reset_stats() noexcept { stats_ = allocation_stats(); }
+
+    void* allocate(std::size_t size)
+    {
+        ++stats_.allocations;
+        std::size_t cls = size_class(size);
+        if (cls < num_classes && free_lists_[cls])
+        {
+            free_block* b = free_lists_[cls];
+            free_lists_[cls] = b->next;
+            --num_cached_[cls];
+            ++stats_.pool_hits;
+            return b;
+        }
+        ++stats_.heap_allocations;
+        return ::operator new(cls < num_classes ? class_size(cls) : size);
+    }
+
+    void deallocate(void* p, std::size_t size) noexcept
+    {
+        ++stats_.deallocations;
+        std::size_t cls = size_class(size);
+        if (cls < num_classes && num_cached_[cls] < max_cached_per_class)
+        {
+            auto* b = ::new (p) free_block{free_lists_[cls]};
+            free_lists_[cls] = b;
+            ++num_cached_[cls];
+        }
+        else
+        {
+            ::operator delete(p);
+        }
+    }
+};
+
+}  // namespace detail
+
+// The allocation counters for the current thread
+inline const allocation_stats& thread_allocation_stats() noexcept
+{
+    return detail::handler_memory_pool::instance().stats();
+}
+
+inline void reset_thread_allocation_stats() noexcept
+{
+    detail::handler_memory_pool::instance().reset_stats();
+}
+
+template <class T>
+struct pooled_allocator
+{
+    using value_type = T;
+
+    pooled_allocator() = default;
+
+    template <class U>
+    constexpr pooled_allocator(const pooled_allocator<U>&) noexcept
+    {
+    }
+
+    T* allocate(std::size_t n)
+    {
+        // operator new only guarantees this alignment. Over-aligned types bypass the pool
+        if constexpr (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+            return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(alignof(T))));
+        else
+            return static_cast<T*>(detail::handler_memory_pool::instance().allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, std::size_t n) noexcept
+    {
+        if constexpr (alignof(T) > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+            ::operator delete(p, std::align_val_t(alignof(T)));
+        else
+            detail::handler_memory_pool::instance().deallocate(p, n * sizeof(T));
+    }
+
+    template <class U>
+    friend constexpr bool operator==(const pooled_allocator&, const pooled_allocator<U>&) noexcept
+    {
+        return true;
+    }
+};
+
+// A bump allocator for the operations of a single request. Deallocation is a no-op:
+// all memory is released at once when the arena is destroyed.
+// Small requests are served from inline storage, and further memory is obtained from the
+// per-thread pool in 4KB chunks. Not thread-safe, and must outlive all the operations using it.
+class request_arena
+{
+    static constexpr std::size_t chunk_size = 4096;
+
+    // Header of each block of memory obtained by the arena
+    struct alignas(std::max_align_t) chunk
+    {
+        chunk* next;
+        std::size_t size;  // chunk_size for pooled chunks. Bigger for allocations that don't fit in one
+    };
+
+    alignas(std::max_align_t) unsigned char initial_[512];
+    unsigned char* cur_{initial_};
+    unsigned char* end_{initial_ + sizeof(initial_)};
+    chunk* chunks_{};  // Most recent first
+    std::size_t bytes_allocated_{0};
+
+    static unsigned char* align_up(unsigned char* p, std::size_t alignment) noexcept
+    {
+        auto value = reinterpret_cast<std::uintptr_t>(p);
+        return p + ((alignment - value % alignment) % alignment);
+    }
+
+    chunk* new_chunk(std::size_t size)
+    {
+        void* mem = size == chunk_size ? detail::handler_memory_pool::instance().allocate(size)
+                                       : ::operator new(size);
+        chunks_ = ::new (mem) chunk{chunks_, size};
+        return chunks_;
+    }
+
+public:
+    request_arena() = default;
+    request_arena(const request_arena&) = delete;
+    request_arena& operator=(const request_arena&) = delete;
+
+    ~request_arena()
+    {
+        auto& pool = detail::handler_memory_pool::instance();
+        while (chunks_)
+        {
+            chunk* c = chunks_;
+            chunks_ = c->next;
+            if (c->size == chunk_size)
+                pool.deallocate(c, chunk_size);
+            else
+                ::operator delete(c);
+        }
+    }
+
+    // Total bytes handed out by this arena
+    std::size_t bytes_allocated() const noexcept { return bytes_allocated_; }
+
+    // alignment must be a power of two, not greater than alignof(std::max_align_t)
+    void* allocate(std::size_t size, std::size_t alignment)
+    {
+        bytes_allocated_ += size;
+        unsigned char* p = align_up(cur_, alignment);
+        if (p <= end_ && size <= static_cast<std::size_t>(end_ - p))
+        {
+            cur_ = p + size;
+            return p;
+        }
+
+        if (size > (chunk_size - sizeof(chunk)) / 2)
+        {
+            // Big allocations get their own block, so we don't waste the rest of the current chunk
+            return new_chunk(sizeof(chunk) + size) + 1;
+        }
+
+        // Start a new chunk. The rest of the current one is wasted
+        chunk* c = new_chunk(chunk_size);
+        p = reinterpret_cast<unsigned char*>(c + 1);
+        cur_ = p + size;
+        end_ = reinterpret_cast<unsigned char*>(c) + chunk_size;
+        return p;
+    }
+};
+
+template <class T>
+class arena_allocator
+{
+    request_arena* arena_;
+
+    template <class U>
+    friend class arena_allocator;
+
+public:
+    using value_type = T;
+
+    explicit arena_allocator(request_arena& arena) noexcept : arena_(&arena) {}
+
+    template <class U>
+    constexpr arena_allocator(const arena_allocator<U>& other) noexcept : arena_(other.arena_)
+    {
+    }
+
+    T* allocate(std::size_t n) { return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T))); }
+
+    void deallocate(T*, std::size_t) noexcept {}
+
+    template <class U>
+    friend constexpr bool operator==(const arena_allocator& lhs, const arena_allocator<U>& rhs) noexcept
+    {
+        return lhs.arena_ == rhs.arena_;
+    }
+};
+
+#endif
@@ -0,0 +1,160 @@
+
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/bind_allocator.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/write.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <new>
+#include <string>
+#include <string_view>
+
+#include "latency_histogram.hpp"
+#include "pooled_allocator.hpp"
+
+// Compares the number of heap allocations and the latency per request when binding
+// no allocator (the default), pooled_allocator and a per-request arena_allocator
+// to the operations of many concurrent requests.
+// Usage: pooled_allocator_bench [host] [port] [total-requests] [concurrency]
+
+namespace asio = boost::asio;
+
+// Count every call to the global operator new, to know how many times we hit malloc
+static std::atomic<std::uint64_t> num_global_allocations{0};
+
+void* operator new(std::size_t size)
+{
+    num_global_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+enum class allocator_mode
+{
+    default_allocator,
+    pooled,
+    arena,
+};
+
+struct bench_config
+{
+    std::string host{"127.0.0.1"};
+    std::string port{"8080"};
+    std::size_t total_requests{10000};
+    std::size_t concurrency{500};
+    std::string request;
+};
+
+// handle_request_impl from associated_allocator.cpp, with a configurable token
+template <class CompletionToken>
+static asio::awaitable<void> do_request(const bench_config& cfg, std::string& buff, CompletionToken tok)
+{
+    auto ex = co_await asio::this_coro::executor;
+    asio::ip::tcp::socket sock(ex);
+    asio::ip::tcp::resolver resolv(ex);
+    auto endpoints = co_await resolv.async_resolve(cfg.host, cfg.port, tok);
+    co_await asio::async_connect(sock, endpoints, tok);
+    co_await asio::async_write(sock, asio::buffer(cfg.request), tok);
+    co_await asio::async_read_until(sock, asio::dynamic_buffer(buff), "\r\n\r\n", tok);
+}
+
+static asio::awaitable<void> worker(
+    const bench_config& cfg,
+    allocator_mode mode,
+    std::size_t& remaining,
+    latency_histogram& hist
+)
+{
+    std::string buff;
+    while (remaining > 0)
+    {
+        --remaining;
+        buff.clear();
+        auto start = std::chrono::steady_clock::now();
+        switch (mode)
+        {
+        case allocator_mode::default_allocator: co_await do_request(cfg, buff, asio::deferred); break;
+        case allocator_mode::pooled:
+            co_await do_request(cfg, buff, asio::bind_allocator(pooled_allocator<void>(), asio::deferred));
+            break;
+        case allocator_mode::arena:
+        {
+            // All the memory for this request is released at once when the arena goes out of scope
+            request_arena arena;
+            auto tok = asio::bind_allocator(arena_allocator<void>(arena), asio::deferred);
+            co_await do_request(cfg, buff, tok);
+            break;
+        }
+        }
+        hist.record(std::chrono::steady_clock::now() - start);
+    }
+}
+
+static void run_benchmark(const bench_config& cfg, allocator_mode mode, std::string_view name)
+{
+    asio::io_context ctx;
+    std::size_t remaining = cfg.total_requests;
+    latency_histogram hist;
+
+    for (std::size_t i = 0; i < cfg.concurrency; ++i)
+    {
+        asio::co_spawn(ctx, worker(cfg, mode, remaining, hist), [](std::exception_ptr exc) {
+            if (exc)
+                std::rethrow_exception(exc);
+        });
+    }
+
+    reset_thread_allocation_stats();
+    auto allocs_before = num_global_allocations.load();
+    ctx.run();
+    auto allocs = num_global_allocations.load() - allocs_before;
+    const auto& stats = thread_allocation_stats();
+
+    auto per_request = [&cfg](std::uint64_t value) {
+        return static_cast<double>(value) / cfg.total_requests;
+    };
+    std::cout << name << ":\n  malloc calls/request: " << per_request(allocs)
+              << "\n  allocator calls/request: " << per_request(stats.allocations) << " (" << stats.pool_hits
+              << " served from the pool)\n  latency: " << hist << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    bench_config cfg;
+    if (argc > 1)
+        cfg.host = argv[1];
+    if (argc > 2)
+        cfg.port = argv[2];
+    if (argc > 3)
+        cfg.total_requests = std::stoul(argv[3]);
+    if (argc > 4)
+        cfg.concurrency = std::stoul(argv[4]);
+
+    cfg.request = "GET / HTTP/1.1\r\n"
+                  "Host: " +
+                  cfg.host +
+                  "\r\n"
+                  "User-Agent: Asio\r\n"
+                  "Accept: */*\r\n\r\n";
+
+    run_benchmark(cfg, allocator_mode::default_allocator, "default");
+    run_benchmark(cfg, allocator_mode::pooled, "pooled_allocator");
+    run_benchmark(cfg, allocator_mode::arena, "arena_allocator");
+}
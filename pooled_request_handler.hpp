@@ -0,0 +1,288 @@
+#ifndef USINGSTDCPP_2024_POOLED_REQUEST_HANDLER_HPP
+#define USINGSTDCPP_2024_POOLED_REQUEST_HANDLER_HPP
+
+#include <boost/asio/bind_allocator.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/execution_context.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/smart_ptr/intrusive_ptr.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "io_context_of.hpp"
+
+// The request_handler from callbacks.cpp, without its per-request costs.
+// callbacks.cpp creates each request_handler with std::make_shared, and copies shared_from_this()
+// into the handler of every step. That's a heap allocation per request, plus atomic reference count
+// updates whenever a handler is created, moved or destroyed. Handlers only run in their io_context's
+// thread, so none of this needs to be thread-safe:
+//
+//   - Handlers are kept alive by a boost::intrusive_ptr with a plain (non-atomic) counter.
+//   - When the last reference goes away, the handler goes to a free list instead of being deleted.
+//     The next request reuses it, including its socket, resolver and buffer capacity.
+//   - Each handler owns a block of memory for the state of its pending operation. Only one step
+//     (resolve, connect, write or read) is pending at a time, so the block is reused by all of them.
+//
+// The pool is an io_context service, one per Callback type:
+//
+//     request_handler_pool<Callback>::use(ex).start(host, port, req, callback);
+//
+// calls callback(error_code) when the response headers have been read. host, port and req
+// must outlive the request. Like timer_wheel, the io_context must be run by a single thread.
+
+// Memory for the state of one async operation at a time. Bigger operations, or a second
+// one while the block is in use, fall back to operator new
+class handler_memory
+{
+    alignas(std::max_align_t) unsigned char storage_[1024];
+    bool in_use_{false};
+
+public:
+    handler_memory() = default;
+    handler_memory(const handler_memory&) = delete;
+    handler_memory& operator=(const handler_memory&) = delete;
+
+    void* allocate(std::size_t size)
+    {
+        if (!in_use_ && size <= sizeof(storage_))
+        {
+            in_use_ = true;
+            return storage_;
+        }
+        return ::operator new(size);
+    }
+
+    void deallocate(void* p) noexcept
+    {
+        if (p == storage_)
+            in_use_ = false;
+        else
+            ::operator delete(p);
+    }
+};
+
+template <class T>
+struct handler_memory_allocator
+{
+    using value_type = T;
+
+    handler_memory* mem;
+
+    explicit handler_memory_allocator(handler_memory& m) noexcept : mem(&m) {}
+
+    template <class U>
+    handler_memory_allocator(const handler_memory_allocator<U>& other) noexcept : mem(other.mem)
+    {
+    }
+
+    T* allocate(std::size_t n)
+    {
+        static_assert(alignof(T) <= alignof(std::max_align_t), "Over-aligned types are not supported");
+        return static_cast<T*>(mem->allocate(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, std::size_t) noexcept { mem->deallocate(p); }
+
+    template <class U>
+    friend bool operator==(const handler_memory_allocator& a, const handler_memory_allocator<U>& b) noexcept
+    {
+        return a.mem == b.mem;
+    }
+};
+
+template <class Callback>
+class request_handler_pool;
+
+template <class Callback>
+class pooled_request_handler
+{
+    friend class request_handler_pool<Callback>;
+    using ptr = boost::intrusive_ptr<pooled_request_handler>;
+    using error_code = boost::system::error_code;
+
+    request_handler_pool<Callback>& pool_;
+    std::size_t refs_{0};  // Not atomic: only touched from the io_context's thread
+    pooled_request_handler* next_free_{nullptr};
+
+    // Kept between requests
+    boost::asio::ip::tcp::socket sock_;
+    boost::asio::ip::tcp::resolver resolv_;
+    std::string buff_;
+    handler_memory mem_;
+
+    // The current request
+    std::string_view host_;
+    std::string_view port_;
+    std::string_view req_;
+    std::optional<Callback> cb_;
+
+    friend void intrusive_ptr_add_ref(pooled_request_handler* h) noexcept { ++h->refs_; }
+
+    friend void intrusive_ptr_release(pooled_request_handler* h) noexcept
+    {
+        if (--h->refs_ == 0)
+            h->pool_.recycle(h);
+    }
+
+    pooled_request_handler(request_handler_pool<Callback>& pool, boost::asio::io_context& ctx)
+        : pool_(pool), sock_(ctx), resolv_(ctx)
+    {
+    }
+
+    // The state of every step's operation is allocated from mem_
+    template <class Function>
+    auto with_memory(Function fn)
+    {
+        return boost::asio::bind_allocator(handler_memory_allocator<void>(mem_), std::move(fn));
+    }
+
+    // The callback may start another request, so the handler must not be used afterwards
+    void finish(error_code ec)
+    {
+        Callback cb = std::move(*cb_);
+        cb_.reset();
+        cb(ec);
+    }
+
+    // Leaves the handler ready for the next request. Allocated memory is kept
+    void reset() noexcept
+    {
+        error_code ignored;
+        sock_.close(ignored);
+        buff_.clear();
+        cb_.reset();
+    }
+
+    void start_resolve()
+    {
+        resolv_.async_resolve(host_, port_, with_memory([self = ptr(this)](error_code ec, auto endpoints) {
+            if (ec)
+                self->finish(ec);
+            else
+                self->start_connect(endpoints);
+        }));
+    }
+
+    void start_connect(const boost::asio::ip::tcp::resolver::results_type& endpoints)
+    {
+        boost::asio::async_connect(sock_, endpoints, with_memory([self = ptr(this)](error_code ec, auto) {
+            if (ec)
+                self->finish(ec);
+            else
+                self->start_write();
+        }));
+    }
+
+    void start_write()
+    {
+        boost::asio::async_write(
+            sock_,
+            boost::asio::buffer(req_),
+            with_memory([self = ptr(this)](error_code ec, std::size_t) {
+                if (ec)
+                    self->finish(ec);
+                else
+                    self->start_read();
+            })
+        );
+    }
+
+    void start_read()
+    {
+        boost::asio::async_read_until(
+            sock_,
+            boost::asio::dynamic_buffer(buff_),
+            "\r\n\r\n",
+            with_memory([self = ptr(this)](error_code ec, std::size_t) { self->finish(ec); })
+        );
+    }
+};
+
+template <class Callback>
+class request_handler_pool : public boost::asio::execution_context::service
+{
+    using handler_type = pooled_request_handler<Callback>;
+    friend class pooled_request_handler<Callback>;
+
+    boost::asio::io_context& ctx_;
+    handler_type* free_{nullptr};
+    std::size_t num_created_{0};
+    bool shut_down_{false};
+
+    void recycle(handler_type* h) noexcept
+    {
+        // Handlers released while the io_context is destroying its pending operations
+        if (shut_down_)
+        {
+            delete h;
+            return;
+        }
+        h->reset();
+        h->next_free_ = free_;
+        free_ = h;
+    }
+
+    // Handlers that are still in use are deleted when their last reference goes away
+    void shutdown() override
+    {
+        shut_down_ = true;
+        while (handler_type* h = free_)
+        {
+            free_ = h->next_free_;
+            delete h;
+        }
+    }
+
+public:
+    static inline boost::asio::execution_context::id id;
+
+    explicit request_handler_pool(boost::asio::io_context& ctx)
+        : boost::asio::execution_context::service(ctx), ctx_(ctx)
+    {
+    }
+
+    // The pool for the io_context running ex. ex must be an io_context executor,
+    // or a polymorphic executor holding one. Throws otherwise
+    template <class Executor>
+    static request_handler_pool& use(const Executor& ex)
+    {
+        return boost::asio::use_service<request_handler_pool>(io_context_of(ex));
+    }
+
+    // Resolves host and port, connects, writes req and reads the response headers,
+    // then calls cb(error_code). Must be called from the io_context's thread
+    void start(std::string_view host, std::string_view port, std::string_view req, Callback cb)
+    {
+        handler_type* h = free_;
+        if (h)
+        {
+            free_ = h->next_free_;
+        }
+        else
+        {
+            h = new handler_type(*this, ctx_);
+            ++num_created_;
+        }
+        h->host_ = host;
+        h->port_ = port;
+        h->req_ = req;
+        h->cb_.emplace(std::move(cb));
+        h->start_resolve();
+    }
+
+    // The number of handlers allocated so far, i.e. the maximum number of requests in flight at once
+    std::size_t num_created() const noexcept { return num_created_; }
+};
+
+#endif
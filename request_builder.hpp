@@ -0,0 +1,138 @@
+#ifndef USINGSTDCPP_2024_REQUEST_BUILDER_HPP
+#define USINGSTDCPP_2024_REQUEST_BUILDER_HPP
+
+#include <boost/asio/buffer.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <string_view>
+
+// Builds HTTP/1.1 requests without formatting them at runtime.
+// The examples write a hand-written request string, which can't change per request, and beast.cpp
+// sets each header field at runtime, which allocates. Here, the method and the fixed header fields
+// are template arguments, and are concatenated into static storage at compile time.
+// The values that change per request (the target and the Host) are spliced in between,
+// producing a sequence of buffers for a single gather write:
+//
+//     using get_request = request_builder<"GET", "User-Agent: Asio", "Accept: */*">;
+//     co_await asio::async_write(sock, get_request::buffers("/index.html", "example.com"), asio::deferred);
+//
+// writes "GET /index.html HTTP/1.1\r\nHost: example.com\r\nUser-Agent: Asio\r\nAccept: */*\r\n\r\n"
+// as 5 buffers, 3 of which point to static data. buffers() doesn't allocate or copy:
+// the target and host must outlive the write.
+//
+// The fixed parts are validated at compile time. The runtime values must not contain CR or LF,
+// which would allow injecting header fields. This is checked with assert.
+
+// A string literal that can be used as a template argument
+template <std::size_t N>
+struct fixed_string
+{
+    char value[N]{};
+
+    constexpr fixed_string(const char (&s)[N]) { std::copy_n(s, N, value); }
+
+    constexpr std::string_view view() const { return std::string_view(value, N - 1); }
+    constexpr std::size_t size() const { return N - 1; }
+};
+
+namespace detail {
+
+// The characters allowed in a method or a field name by RFC 9110
+constexpr bool is_http_token(std::string_view s)
+{
+    constexpr std::string_view special = "!#$%&'*+-.^_`|~";
+    return !s.empty() && std::all_of(s.begin(), s.end(), [special](char c) {
+        return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+               special.find(c) != std::string_view::npos;
+    });
+}
+
+constexpr bool is_field_value(std::string_view s)
+{
+    return std::none_of(s.begin(), s.end(), [](char c) { return c == '\r' || c == '\n'; });
+}
+
+// "Name: value"
+constexpr bool is_header_field(std::string_view s)
+{
+    auto colon = s.find(':');
+    return colon != std::string_view::npos && is_http_token(s.substr(0, colon)) &&
+           is_field_value(s.substr(colon + 1));
+}
+
+}  // namespace detail
+
+template <fixed_string Method, fixed_string... Fields>
+class request_builder
+{
+    static_assert(detail::is_http_token(Method.view()), "Invalid HTTP method");
+    static_assert((... && detail::is_header_field(Fields.view())), "Header fields must be \"Name: value\"");
+
+    template <std::size_t N>
+    struct text
+    {
+        std::array<char, N> chars{};
+        std::size_t pos{0};
+
+        constexpr text& operator+=(std::string_view s)
+        {
+            for (char c : s)
+                chars[pos++] = c;
+            return *this;
+        }
+    };
+
+    // "GET "
+    static constexpr auto request_line_start = [] {
+        text<Method.size() + 1> res;
+        res += Method.view();
+        res += " ";
+        return res.chars;
+    }();
+
+    static constexpr std::string_view host_prefix = " HTTP/1.1\r\nHost: ";
+
+    // The end of the Host line, the fixed fields and the empty line ending the headers
+    static constexpr auto headers_end = [] {
+        text<2 + (std::size_t(0) + ... + (Fields.size() + 2)) + 2> res;
+        res += "\r\n";
+        ((res += Fields.view(), res += "\r\n"), ...);
+        res += "\r\n";
+        return res.chars;
+    }();
+
+public:
+    using buffers_type = std::array<boost::asio::const_buffer, 5>;
+
+    // Checks a value to be spliced into the request
+    static constexpr bool valid_value(std::string_view value) noexcept
+    {
+        return !value.empty() && detail::is_field_value(value);
+    }
+
+    // The request, as a buffer sequence referencing target and host
+    static buffers_type buffers(std::string_view target, std::string_view host) noexcept
+    {
+        assert(valid_value(target) && target.find(' ') == std::string_view::npos);
+        assert(valid_value(host));
+        return {
+            boost::asio::buffer(request_line_start),
+            boost::asio::buffer(target),
+            boost::asio::buffer(host_prefix),
+            boost::asio::buffer(host),
+            boost::asio::buffer(headers_end),
+        };
+    }
+
+    // The size of the request, without building it
+    static constexpr std::size_t size(std::string_view target, std::string_view host) noexcept
+    {
+        return request_line_start.size() + target.size() + host_prefix.size() + host.size() +
+               headers_end.size();
+    }
+};
+
+#endif
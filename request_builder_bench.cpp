@@ -0,0 +1,124 @@
+
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/http/empty_body.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/beast/http/write.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <string_view>
+
+#include "request_builder.hpp"
+
+// Measures the cost of producing a request and passing it to a write operation:
+//
+//   - request_builder: compile-time fixed parts, and a 5-buffer gather write.
+//   - Beast: an http::request whose fields are set at runtime, written with http::write,
+//     which runs Beast's serializer. This is what beast.cpp does.
+//   - std::string: formatting the request into a string per request.
+//
+// The stream copies the data into a fixed buffer, so we only measure building and serializing.
+// Usage: request_builder_bench [iterations]
+
+namespace asio = boost::asio;
+namespace beast = boost::beast;
+namespace http = beast::http;
+using boost::system::error_code;
+
+// Count every call to the global operator new
+static std::atomic<std::uint64_t> num_global_allocations{0};
+
+void* operator new(std::size_t size)
+{
+    num_global_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+// A SyncWriteStream that copies everything into a fixed buffer, like a socket's send buffer
+class sink_stream
+{
+    std::array<char, 4096> buff_;
+    std::size_t num_writes_{0};
+
+public:
+    std::size_t num_writes() const noexcept { return num_writes_; }
+
+    template <class ConstBufferSequence>
+    std::size_t write_some(const ConstBufferSequence& buffers, error_code& ec)
+    {
+        ec.clear();
+        ++num_writes_;
+        return asio::buffer_copy(asio::buffer(buff_), buffers);
+    }
+
+    template <class ConstBufferSequence>
+    std::size_t write_some(const ConstBufferSequence& buffers)
+    {
+        error_code ec;
+        return write_some(buffers, ec);
+    }
+};
+
+// The targets change per request, so nothing can be precomputed
+static const std::array<std::string, 4> targets{"/", "/index.html", "/api/v1/items?page=2", "/static/app.js"};
+static constexpr char host[] = "example.com";
+
+using get_request = request_builder<"GET", "User-Agent: Asio", "Accept: */*">;
+
+template <class Function>
+static void measure(std::string_view name, std::size_t iterations, Function fn)
+{
+    sink_stream sink;
+    std::size_t bytes = 0;
+    auto allocs_before = num_global_allocations.load();
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < iterations; ++i)
+        bytes += fn(sink, targets[i % targets.size()]);
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    auto allocs = num_global_allocations.load() - allocs_before;
+
+    std::cout << "  " << name << ": " << elapsed.count() / iterations << " ns/request, "
+              << static_cast<double>(allocs) / iterations << " allocations/request, "
+              << static_cast<double>(sink.num_writes()) / iterations << " writes/request, "
+              << static_cast<double>(bytes) / iterations << " bytes/request\n";
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t iterations = argc > 1 ? std::stoul(argv[1]) : 1000000;
+
+    std::cout << "Building and writing " << iterations << " requests:\n";
+
+    measure("request_builder", iterations, [](sink_stream& sink, const std::string& target) {
+        return asio::write(sink, get_request::buffers(target, host));
+    });
+
+    measure("Beast serializer", iterations, [](sink_stream& sink, const std::string& target) {
+        http::request<http::empty_body> req{http::verb::get, target, 11};
+        req.set(http::field::host, host);
+        req.set(http::field::user_agent, "Asio");
+        req.set(http::field::accept, "*/*");
+        return http::write(sink, req);
+    });
+
+    measure("std::string formatting", iterations, [](sink_stream& sink, const std::string& target) {
+        std::string req = "GET " + target + " HTTP/1.1\r\nHost: ";
+        req += host;
+        req += "\r\nUser-Agent: Asio\r\nAccept: */*\r\n\r\n";
+        return asio::write(sink, asio::buffer(req));
+    });
+}
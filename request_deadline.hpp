@@ -0,0 +1,328 @@
+#ifndef USINGSTDCPP_2024_REQUEST_DEADLINE_HPP
+#define USINGSTDCPP_2024_REQUEST_DEADLINE_HPP
+
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/bind_cancellation_slot.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/cancellation_signal.hpp>
+#include <boost/asio/cancellation_type.hpp>
+#include <boost/asio/compose.hpp>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/system/error_category.hpp>
+#include <boost/system/error_code.hpp>
+#include <boost/system/errc.hpp>
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "timer_wheel.hpp"
+
+// handle_request_op from composed.cpp, with a time budget.
+// A single timeout around the whole request, like the one in timeouts.cpp, can't tell
+// a slow DNS lookup from a slow server. Here, the request has a total deadline,
+// and each stage (resolve, connect, write, read) may have its own budget on top of it.
+//
+//   - Each inner operation is bound to a cancellation slot, which is signalled when the stage
+//     runs out of time. The deadlines are kept in the io_context's timer_wheel.
+//   - The error code says which stage timed out (e.g. request_errc::connect_timeout).
+//     All of them compare equal to boost::system::errc::timed_out.
+//   - A stage isn't started if the total budget is already exhausted, and the socket is closed
+//     as soon as the request fails, so requests that are over budget don't hold resources.
+//   - Per-operation cancellation requested by the caller is forwarded to the inner operations.
+//
+// tcp::resolver doesn't support per-operation cancellation, since getaddrinfo can't be interrupted.
+// A slow lookup is still reported as resolve_timeout, but only once getaddrinfo returns.
+
+enum class request_errc
+{
+    resolve_timeout = 1,
+    connect_timeout,
+    write_timeout,
+    read_timeout,
+};
+
+inline const boost::system::error_category& request_category() noexcept
+{
+    struct category final : boost::system::error_category
+    {
+        const char* name() const noexcept override { return "request"; }
+        std::string message(int ev) const override
+        {
+            switch (static_cast<request_errc>(ev))
+            {
+            case request_errc::resolve_timeout: return "the name resolution timed out";
+            case request_errc::connect_timeout: return "the connection timed out";
+            case request_errc::write_timeout: return "writing the request timed out";
+            case request_errc::read_timeout: return "reading the response timed out";
+            default: return "unknown request error";
+            }
+        }
+        boost::system::error_condition default_error_condition(int) const noexcept override
+        {
+            return boost::system::errc::timed_out;
+        }
+    };
+    static const category cat;
+    return cat;
+}
+
+inline boost::system::error_code make_error_code(request_errc e) noexcept
+{
+    return boost::system::error_code(static_cast<int>(e), request_category());
+}
+
+template <>
+struct boost::system::is_error_code_enum<request_errc> : std::true_type
+{
+};
+
+struct request_budget
+{
+    using duration = std::chrono::steady_clock::duration;
+
+    // For the whole request. If not set, only the per-stage budgets apply
+    std::optional<duration> total;
+
+    // For each stage. If not set, the stage is only limited by the total
+    std::optional<duration> resolve;
+    std::optional<duration> connect;
+    std::optional<duration> write;
+    std::optional<duration> read;
+};
+
+namespace detail {
+
+// The deadline of the current stage. Heap-allocated, since the wheel keeps a pointer to it
+struct stage_deadline : timer_wheel::entry
+{
+    using clock = std::chrono::steady_clock;
+
+    timer_wheel& wheel;
+    boost::asio::cancellation_signal sig;  // Bound to the inner operation
+    clock::time_point total_deadline{clock::time_point::max()};
+    bool expired{false};
+
+    stage_deadline(timer_wheel& w, std::optional<clock::duration> total) : wheel(w)
+    {
+        if (total)
+            total_deadline = clock::now() + *total;
+        on_expire = [](timer_wheel::entry& e) {
+            auto& self = static_cast<stage_deadline&>(e);
+            self.expired = true;
+            self.sig.emit(boost::asio::cancellation_type::terminal);
+        };
+    }
+
+    stage_deadline(const stage_deadline&) = delete;
+    stage_deadline& operator=(const stage_deadline&) = delete;
+
+    ~stage_deadline() { wheel.remove(*this); }
+
+    // Returns false if there is no time left for the stage
+    bool arm(std::optional<clock::duration> budget)
+    {
+        expired = false;
+        auto now = clock::now();
+        auto limit = total_deadline;
+        if (budget)
+            limit = std::min(limit, now + *budget);
+        if (limit == clock::time_point::max())
+            return true;  // No deadline
+        if (limit <= now)
+            return false;
+        wheel.add(*this, limit - now);
+        return true;
+    }
+
+    // If the stage's deadline fired, it's over budget, even if the operation managed to complete
+    boost::system::error_code finish(boost::system::error_code ec, request_errc timeout_code) noexcept
+    {
+        wheel.remove(*this);
+        return expired ? make_error_code(timeout_code) : ec;
+    }
+};
+
+// Forwards cancellation requested by the caller to the inner operations
+struct forward_to_stage
+{
+    boost::asio::cancellation_signal& sig;
+
+    void operator()(boost::asio::cancellation_type type) { sig.emit(type); }
+};
+
+}  // namespace detail
+
+struct deadline_request_op
+{
+    boost::asio::ip::tcp::resolver& resolv;
+    boost::asio::ip::tcp::socket& sock;
+    std::string_view host;
+    std::string_view port;
+    std::string_view req;
+    std::string& buff;
+    request_budget budget;
+    std::unique_ptr<detail::stage_deadline> deadline;
+
+    enum class state_t
+    {
+        initial,
+        resolving,
+        connecting,
+        writing,
+        reading,
+    } state{state_t::initial};
+
+    // The budget and timeout error of each stage
+    std::optional<std::chrono::steady_clock::duration> stage_budget() const
+    {
+        switch (state)
+        {
+        case state_t::resolving: return budget.resolve;
+        case state_t::connecting: return budget.connect;
+        case state_t::writing: return budget.write;
+        default: assert(state == state_t::reading); return budget.read;
+        }
+    }
+
+    request_errc stage_timeout() const
+    {
+        switch (state)
+        {
+        case state_t::resolving: return request_errc::resolve_timeout;
+        case state_t::connecting: return request_errc::connect_timeout;
+        case state_t::writing: return request_errc::write_timeout;
+        default: assert(state == state_t::reading); return request_errc::read_timeout;
+        }
+    }
+
+    // Moves to the next stage. Returns false if it's already out of time
+    bool next_stage(state_t next)
+    {
+        state = next;
+        return deadline->arm(stage_budget());
+    }
+
+    // Inner operations are cancelled through the stage's signal
+    template <class Self>
+    auto with_deadline(Self& self)
+    {
+        return boost::asio::bind_cancellation_slot(deadline->sig.slot(), std::move(self));
+    }
+
+    // forward_to_stage refers to the stage deadline, which is freed when the operation completes.
+    // Remove it from the slot first, or a later emit on the caller's signal would use freed memory
+    template <class Self>
+    void complete(Self& self, boost::system::error_code ec, std::size_t bytes_transferred)
+    {
+        self.get_cancellation_state().slot().clear();
+        self.complete(ec, bytes_transferred);
+    }
+
+    template <class Self>
+    void fail(Self& self, boost::system::error_code ec)
+    {
+        // Release the socket now, rather than when the caller destroys it
+        boost::system::error_code ignored;
+        sock.close(ignored);
+        complete(self, ec, 0u);
+    }
+
+    template <class Self>
+    void operator()(Self& self)
+    {
+        assert(state == state_t::initial);
+        auto slot = self.get_cancellation_state().slot();
+        if (slot.is_connected())
+            slot.template emplace<detail::forward_to_stage>(deadline->sig);
+
+        // The first stage always starts, so we never complete from within the initiating function
+        next_stage(state_t::resolving);
+        resolv.async_resolve(host, port, with_deadline(self));
+    }
+
+    template <class Self>
+    void operator()(
+        Self& self,
+        boost::system::error_code ec,
+        boost::asio::ip::tcp::resolver::results_type endpoints
+    )
+    {
+        assert(state == state_t::resolving);
+        if ((ec = deadline->finish(ec, stage_timeout())))
+            return fail(self, ec);
+        if (!next_stage(state_t::connecting))
+            return fail(self, stage_timeout());
+        boost::asio::async_connect(sock, endpoints, with_deadline(self));
+    }
+
+    template <class Self>
+    void operator()(Self& self, boost::system::error_code ec, boost::asio::ip::tcp::endpoint)
+    {
+        assert(state == state_t::connecting);
+        if ((ec = deadline->finish(ec, stage_timeout())))
+            return fail(self, ec);
+        if (!next_stage(state_t::writing))
+            return fail(self, stage_timeout());
+        boost::asio::async_write(sock, boost::asio::buffer(req), with_deadline(self));
+    }
+
+    template <class Self>
+    void operator()(Self& self, boost::system::error_code ec, std::size_t bytes_transferred)
+    {
+        if ((ec = deadline->finish(ec, stage_timeout())))
+            return fail(self, ec);
+
+        if (state == state_t::writing)
+        {
+            if (!next_stage(state_t::reading))
+                return fail(self, stage_timeout());
+            boost::asio::async_read_until(
+                sock,
+                boost::asio::dynamic_buffer(buff),
+                "\r\n\r\n",
+                with_deadline(self)
+            );
+        }
+        else
+        {
+            assert(state == state_t::reading);
+            complete(self, boost::system::error_code(), bytes_transferred);
+        }
+    }
+};
+
+// Like handle_request_generic in composed.cpp. The objects passed by reference must outlive the operation.
+// sock's executor must belong to an io_context run by a single thread, as required by timer_wheel
+template <boost::asio::completion_token_for<void(boost::system::error_code, std::size_t)> CompletionToken>
+auto async_request_with_deadline(
+    boost::asio::ip::tcp::resolver& resolv,
+    boost::asio::ip::tcp::socket& sock,
+    std::string_view host,
+    std::string_view port,
+    std::string_view req,
+    std::string& buff,
+    const request_budget& budget,
+    CompletionToken&& token
+)
+{
+    timer_wheel& wheel = timer_wheel::use(sock.get_executor());
+    auto deadline = std::make_unique<detail::stage_deadline>(wheel, budget.total);
+    return boost::asio::async_compose<CompletionToken, void(boost::system::error_code, std::size_t)>(
+        deadline_request_op{resolv, sock, host, port, req, buff, budget, std::move(deadline)},
+        token,
+        resolv,
+        sock
+    );
+}
+
+#endif
@@ -0,0 +1,283 @@
+#ifndef USINGSTDCPP_2024_REQUEST_TRACING_HPP
+#define USINGSTDCPP_2024_REQUEST_TRACING_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "latency_histogram.hpp"
+
+// Per-stage latency tracing for requests: where does the time go between resolving,
+// connecting, writing and receiving the response headers?
+//
+// A request_trace is created per request, and enter() is called on each state transition.
+// Each call writes a steady_clock timestamp into a ring buffer owned by the calling thread,
+// without locks or atomic read-modify-write operations. When the buffer is full, the oldest
+// events are overwritten. The collected events can be exported as:
+//
+//   - Chrome trace-event JSON (write_chrome_trace), to be opened in chrome://tracing or Perfetto.
+//   - One latency_histogram per stage (aggregate_request_traces).
+//
+// Export after the traced threads are done, or at least quiescent.
+//
+// Tracing is compiled in by defining USINGSTDCPP_ENABLE_REQUEST_TRACING (the ENABLE_REQUEST_TRACING
+// CMake option). Otherwise, request_trace is an empty class whose functions do nothing,
+// traced() returns the operation unchanged and the exporters produce empty output, so the
+// instrumentation has no cost.
+//
+// For async_compose operations, keep a request_trace in the operation state. For coroutines,
+// wrap each stage's operation in traced():
+//
+//     request_trace trace;
+//     auto endpoints = co_await traced(trace, request_stage::resolve, resolv.async_resolve(..., deferred));
+
+#ifdef USINGSTDCPP_ENABLE_REQUEST_TRACING
+inline constexpr bool request_tracing_enabled = true;
+#else
+inline constexpr bool request_tracing_enabled = false;
+#endif
+
+// The stages of handle_request_op. done marks the end of the last one
+enum class request_stage : std::uint8_t
+{
+    resolve,
+    connect,
+    write,
+    read,
+    done,
+};
+
+inline constexpr std::size_t num_request_stages = 4;  // Not counting done
+
+inline const char* to_string(request_stage stage) noexcept
+{
+    switch (stage)
+    {
+    case request_stage::resolve: return "resolve";
+    case request_stage::connect: return "connect";
+    case request_stage::write: return "write";
+    case request_stage::read: return "read";
+    default: return "done";
+    }
+}
+
+struct trace_event
+{
+    std::uint64_t request_id;
+    std::int64_t timestamp_ns;  // steady_clock
+    request_stage stage;
+};
+
+namespace detail {
+
+// Single writer (the owning thread). Readers see everything published before the last
+// release store to head_, and must not run concurrently with a wrap-around to get consistent data
+class trace_ring_buffer
+{
+    static constexpr std::size_t capacity = std::size_t(1) << 16;
+
+    std::unique_ptr<trace_event[]> events_{new trace_event[capacity]};
+    std::atomic<std::uint64_t> head_{0};  // Total events written
+    std::uint32_t thread_index_;
+    std::uint64_t next_request_{0};
+
+public:
+    explicit trace_ring_buffer(std::uint32_t thread_index) noexcept : thread_index_(thread_index) {}
+
+    std::uint32_t thread_index() const noexcept { return thread_index_; }
+
+    // Unique across threads without synchronization: the thread index goes in the high bits
+    std::uint64_t new_request_id() noexcept
+    {
+        return (static_cast<std::uint64_t>(thread_index_) << 40) | next_request_++;
+    }
+
+    void push(const trace_event& ev) noexcept
+    {
+        std::uint64_t head = head_.load(std::memory_order_relaxed);
+        events_[head % capacity] = ev;
+        head_.store(head + 1, std::memory_order_release);
+    }
+
+    void copy_to(std::vector<trace_event>& to) const
+    {
+        std::uint64_t head = head_.load(std::memory_order_acquire);
+        for (std::uint64_t i = head > capacity ? head - capacity : 0; i < head; ++i)
+            to.push_back(events_[i % capacity]);
+    }
+};
+
+// Buffers are registered once per thread, and outlive it so they can be exported later
+class trace_registry
+{
+    std::mutex mtx_;
+    std::vector<std::shared_ptr<trace_ring_buffer>> buffers_;
+
+public:
+    static trace_registry& instance()
+    {
+        static trace_registry reg;
+        return reg;
+    }
+
+    std::shared_ptr<trace_ring_buffer> register_thread()
+    {
+        std::lock_guard lock(mtx_);
+        auto res = std::make_shared<trace_ring_buffer>(static_cast<std::uint32_t>(buffers_.size()));
+        buffers_.push_back(res);
+        return res;
+    }
+
+    // All the events, grouped by thread
+    std::vector<std::pair<std::uint32_t, std::vector<trace_event>>> collect()
+    {
+        std::lock_guard lock(mtx_);
+        std::vector<std::pair<std::uint32_t, std::vector<trace_event>>> res;
+        for (const auto& buf : buffers_)
+        {
+            res.emplace_back(buf->thread_index(), std::vector<trace_event>());
+            buf->copy_to(res.back().second);
+        }
+        return res;
+    }
+};
+
+inline trace_ring_buffer& thread_trace_buffer()
+{
+    thread_local std::shared_ptr<trace_ring_buffer> buf = trace_registry::instance().register_thread();
+    return *buf;
+}
+
+// Calls fn(thread_index, event, duration_ns) for each completed stage. event marks its start
+template <class Function>
+void for_each_traced_stage(Function fn)
+{
+    for (auto& [thread_index, events] : trace_registry::instance().collect())
+    {
+        // A request's events are in order within its thread's buffer, but interleaved with other requests
+        std::stable_sort(events.begin(), events.end(), [](const trace_event& a, const trace_event& b) {
+            return a.request_id < b.request_id;
+        });
+        for (std::size_t i = 0; i + 1 < events.size(); ++i)
+        {
+            const trace_event& cur = events[i];
+            const trace_event& next = events[i + 1];
+            if (cur.request_id == next.request_id && cur.stage != request_stage::done)
+                fn(thread_index, cur, next.timestamp_ns - cur.timestamp_ns);
+        }
+    }
+}
+
+// Trace event timestamps are in microseconds. Write them with full nanosecond precision
+inline void write_microseconds(std::ostream& os, std::int64_t ns)
+{
+    char fraction[4] = {
+        static_cast<char>('0' + ns / 100 % 10),
+        static_cast<char>('0' + ns / 10 % 10),
+        static_cast<char>('0' + ns % 10),
+        '\0',
+    };
+    os << ns / 1000 << '.' << fraction;
+}
+
+}  // namespace detail
+
+#ifdef USINGSTDCPP_ENABLE_REQUEST_TRACING
+
+class request_trace
+{
+    std::uint64_t id_{detail::thread_trace_buffer().new_request_id()};
+
+public:
+    std::uint64_t id() const noexcept { return id_; }
+
+    // Records that the request entered stage now
+    void enter(request_stage stage) noexcept
+    {
+        auto now = std::chrono::steady_clock::now().time_since_epoch();
+        detail::thread_trace_buffer().push(
+            trace_event{id_, std::chrono::duration_cast<std::chrono::nanoseconds>(now).count(), stage}
+        );
+    }
+};
+
+// Returns an async operation that calls trace.enter(stage) when initiated, then initiates op.
+// Works with any async operation that can be co_await'ed, e.g. the ones returned when using deferred
+template <class Op>
+auto traced(request_trace& trace, request_stage stage, Op&& op)
+{
+    return [&trace, stage, op = std::forward<Op>(op)](auto&& token) mutable {
+        trace.enter(stage);
+        return std::move(op)(std::forward<decltype(token)>(token));
+    };
+}
+
+#else
+
+class request_trace
+{
+public:
+    std::uint64_t id() const noexcept { return 0; }
+    void enter(request_stage) noexcept {}
+};
+
+template <class Op>
+std::decay_t<Op> traced(request_trace&, request_stage, Op&& op)
+{
+    return std::forward<Op>(op);
+}
+
+#endif
+
+// The duration of each stage of every traced request, indexed by request_stage
+inline std::array<latency_histogram, num_request_stages> aggregate_request_traces()
+{
+    std::array<latency_histogram, num_request_stages> res;
+    if constexpr (request_tracing_enabled)
+    {
+        detail::for_each_traced_stage([&res](std::uint32_t, const trace_event& ev, std::int64_t duration_ns) {
+            res[static_cast<std::size_t>(ev.stage)].record(std::chrono::nanoseconds(duration_ns));
+        });
+    }
+    return res;
+}
+
+inline void write_stage_histograms(std::ostream& os)
+{
+    auto hists = aggregate_request_traces();
+    for (std::size_t i = 0; i < hists.size(); ++i)
+        os << "  " << to_string(static_cast<request_stage>(i)) << ": " << hists[i] << '\n';
+}
+
+// Writes the traced stages as complete ("X") events in Chrome's trace event format
+inline void write_chrome_trace(std::ostream& os)
+{
+    os << "{\"traceEvents\":[";
+    if constexpr (request_tracing_enabled)
+    {
+        bool first = true;
+        detail::for_each_traced_stage(
+            [&os, &first](std::uint32_t thread_index, const trace_event& ev, std::int64_t duration_ns) {
+                os << (first ? "\n" : ",\n") << "{\"name\":\"" << to_string(ev.stage)
+                   << "\",\"cat\":\"request\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread_index << ",\"ts\":";
+                detail::write_microseconds(os, ev.timestamp_ns);
+                os << ",\"dur\":";
+                detail::write_microseconds(os, duration_ns);
+                os << ",\"args\":{\"request\":" << ev.request_id << "}}";
+                first = false;
+            }
+        );
+    }
+    os << "\n]}\n";
+}
+
+#endif
@@ -0,0 +1,494 @@
+
+#include <boost/asio/as_tuple.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/address.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/socket_base.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <sys/socket.h>
+
+#include "content_coding.hpp"
+
+// A local HTTP/1.1 server to use as a deterministic peer for the examples and benchmarks,
+// so they can run without network access and with reproducible results.
+// It supports keep-alive and pipelining, and serves responses with a configurable body size and latency.
+// Each thread runs its own io_context with its own acceptor. All acceptors listen on the same port
+// using SO_REUSEPORT, so the kernel load-balances incoming connections between threads.
+//
+// Usage: server [--address <ip>] [--port <port>] [--threads <n>] [--body-size <bytes>] [--latency-us <us>]
+//
+// The defaults can be overridden per request using the query string, e.g. GET /?size=1048576&latency_us=500
+// Requests that send Accept-Encoding with gzip or deflate get a compressed body. Compressed bodies
+// are built the first time each size is requested, and cached.
+// Requests with more than 16KB of headers, or bodies over 1MB, get a 431 or 413 response,
+// and their connection is closed. Request bodies are read and discarded.
+//
+// Point the examples to this server by setting the EXAMPLES_HOST and EXAMPLES_PORT environment variables:
+//   EXAMPLES_HOST=127.0.0.1 EXAMPLES_PORT=8080 ./coroutines
+
+namespace asio = boost::asio;
+using boost::system::error_code;
+
+// SO_REUSEPORT isn't provided by Asio. A SettableSocketOption, so it can be passed to set_option
+class reuse_port
+{
+    int value_;
+
+public:
+    explicit reuse_port(bool enabled) noexcept : value_(enabled ? 1 : 0) {}
+
+    template <class Protocol>
+    int level(const Protocol&) const noexcept
+    {
+        return SOL_SOCKET;
+    }
+
+    template <class Protocol>
+    int name(const Protocol&) const noexcept
+    {
+        return SO_REUSEPORT;
+    }
+
+    template <class Protocol>
+    const int* data(const Protocol&) const noexcept
+    {
+        return &value_;
+    }
+
+    template <class Protocol>
+    std::size_t size(const Protocol&) const noexcept
+    {
+        return sizeof(value_);
+    }
+};
+
+struct server_config
+{
+    std::string address{"127.0.0.1"};
+    unsigned short port{8080};
+    std::size_t threads{1};
+    std::size_t body_size{1024};
+    std::chrono::microseconds latency{0};
+
+    // Larger requests get an error response, and the connection is closed
+    std::size_t max_header_size{16 * 1024};
+    std::size_t max_body_size{1024 * 1024};
+};
+
+// Response bodies are slices of this buffer, repeated as many times as required,
+// so we never need to build bodies at runtime. Text, so it compresses like real payloads.
+static const std::string& body_pattern()
+{
+    static const std::string res = [] {
+        constexpr std::string_view line = "The quick brown fox jumps over the lazy dog. 0123456789\n";
+        std::string s;
+        while (s.size() < 64 * 1024)
+            s += line;
+        s.resize(64 * 1024);
+        return s;
+    }();
+    return res;
+}
+
+static bool iequals(std::string_view a, std::string_view b)
+{
+    auto to_lower = [](char c) { return std::tolower(static_cast<unsigned char>(c)); };
+    return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [to_lower](char c1, char c2) {
+               return to_lower(c1) == to_lower(c2);
+           });
+}
+
+template <class T>
+static void parse_number(std::string_view from, T& to)
+{
+    std::from_chars(from.data(), from.data() + from.size(), to);
+}
+
+// What we need to know about a request. Request bodies are skipped.
+struct request_info
+{
+    std::size_t size;  // Including the body
+    std::size_t body_size;
+    std::chrono::microseconds latency;
+    bool keep_alive{true};
+    content_coding coding{content_coding::identity};
+    int status{200};  // Otherwise, the request was rejected, and the connection must be closed
+};
+
+// A request we won't process, because it's too large. Its response has no body
+static request_info rejected_request(int status) { return request_info{0, 0, {}, false, {}, status}; }
+
+// The coding to compress a response with, given the request's Accept-Encoding. Prefers gzip
+static content_coding choose_content_coding(std::string_view accept_encoding)
+{
+    bool gzip = false, deflate = false;
+    while (!accept_encoding.empty())
+    {
+        std::string_view item = accept_encoding.substr(0, accept_encoding.find(','));
+        accept_encoding.remove_prefix(std::min(item.size() + 1, accept_encoding.size()));
+
+        // A quality of 0 means "not acceptable"
+        std::size_t params = item.find(';');
+        std::size_t q = item.find("q=", params == std::string_view::npos ? item.size() : params);
+        if (q != std::string_view::npos)
+        {
+            double quality = 1;
+            parse_number(item.substr(q + 2), quality);
+            if (quality == 0)
+                continue;
+        }
+
+        auto coding = parse_content_encoding(item.substr(0, params));
+        gzip = gzip || coding == content_coding::gzip;
+        deflate = deflate || coding == content_coding::deflate;
+    }
+    return gzip ? content_coding::gzip : deflate ? content_coding::deflate : content_coding::identity;
+}
+
+// Parses the request at the start of buff, if there is a complete one.
+// A client could otherwise make us buffer an arbitrarily large request, so requests
+// with more than cfg.max_header_size bytes of headers, or with a Content-Length over
+// cfg.max_body_size, are rejected with 431 and 413, respectively
+static std::optional<request_info> parse_request(std::string_view buff, const server_config& cfg)
+{
+    std::size_t header_end = buff.find("\r\n\r\n");
+    if (header_end == std::string_view::npos)
+    {
+        if (buff.size() > cfg.max_header_size)
+            return rejected_request(431);
+        return std::nullopt;
+    }
+    if (header_end + 4 > cfg.max_header_size)
+        return rejected_request(431);
+    std::string_view headers = buff.substr(0, header_end + 2);
+
+    request_info res{header_end + 4, cfg.body_size, cfg.latency};
+
+    // Request line: METHOD target VERSION
+    std::size_t line_end = headers.find("\r\n");
+    std::string_view request_line = headers.substr(0, line_end);
+    if (request_line.ends_with("HTTP/1.0"))
+        res.keep_alive = false;
+    std::size_t query_start = request_line.find('?');
+    if (query_start != std::string_view::npos)
+    {
+        std::string_view query = request_line.substr(query_start + 1);
+        query = query.substr(0, query.find(' '));
+        while (!query.empty())
+        {
+            std::string_view param = query.substr(0, query.find('&'));
+            query.remove_prefix(std::min(param.size() + 1, query.size()));
+            std::size_t eq = param.find('=');
+            if (eq == std::string_view::npos)
+                continue;
+            std::string_view key = param.substr(0, eq), value = param.substr(eq + 1);
+            if (key == "size")
+            {
+                parse_number(value, res.body_size);
+            }
+            else if (key == "latency_us")
+            {
+                std::chrono::microseconds::rep us{};
+                parse_number(value, us);
+                res.latency = std::chrono::microseconds(us);
+            }
+        }
+    }
+
+    // Headers
+    for (std::size_t pos = line_end + 2; pos < headers.size();)
+    {
+        std::size_t end = headers.find("\r\n", pos);
+        std::string_view line = headers.substr(pos, end - pos);
+        pos = end + 2;
+        std::size_t colon = line.find(':');
+        if (colon == std::string_view::npos)
+            continue;
+        std::string_view name = line.substr(0, colon), value = line.substr(colon + 1);
+        while (!value.empty() && value.front() == ' ')
+            value.remove_prefix(1);
+        if (iequals(name, "connection"))
+        {
+            if (iequals(value, "close"))
+                res.keep_alive = false;
+            else if (iequals(value, "keep-alive"))
+                res.keep_alive = true;
+        }
+        else if (iequals(name, "content-length"))
+        {
+            std::size_t request_body_size = 0;
+            parse_number(value, request_body_size);
+            if (request_body_size > cfg.max_body_size)
+                return rejected_request(413);
+            res.size += request_body_size;
+        }
+        else if (iequals(name, "accept-encoding"))
+        {
+            res.coding = choose_content_coding(value);
+        }
+    }
+
+    if (buff.size() < res.size)
+        return std::nullopt;
+    return res;
+}
+
+// A compressed body made of body_pattern(). Built once per thread, size and coding.
+// Responses that are being written keep their body alive if the cache is cleared
+static std::shared_ptr<const std::string> compressed_body(std::size_t size, content_coding coding)
+{
+    thread_local std::map<std::pair<std::size_t, content_coding>, std::shared_ptr<const std::string>> cache;
+    auto key = std::make_pair(size, coding);
+    auto it = cache.find(key);
+    if (it != cache.end())
+        return it->second;
+    if (cache.size() >= 64)
+        cache.clear();
+
+    const std::string& pattern = body_pattern();
+    std::string body;
+    body.reserve(size);
+    while (body.size() < size)
+        body.append(pattern, 0, std::min(pattern.size(), size - body.size()));
+    auto res = std::make_shared<const std::string>(compress_body(body, coding));
+    cache.emplace(key, res);
+    return res;
+}
+
+// Accumulates the responses to all the pipelined requests we've got, to send them in a single write.
+// Bodies point into body_pattern() or a cached compressed body, so only headers are allocated
+class response_writer
+{
+    std::deque<std::string> headers_;  // deque, so that push_back doesn't move existing strings
+    std::vector<std::shared_ptr<const std::string>> compressed_bodies_;
+    std::vector<asio::const_buffer> buffers_;
+
+public:
+    void add(const request_info& req)
+    {
+        if (req.status != 200)
+        {
+            std::string& header = headers_.emplace_back();
+            header.append("HTTP/1.1 ")
+                .append(req.status == 431 ? "431 Request Header Fields Too Large" : "413 Content Too Large")
+                .append("\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+            buffers_.push_back(asio::buffer(header));
+            return;
+        }
+
+        std::shared_ptr<const std::string> compressed;
+        if (req.coding != content_coding::identity)
+            compressed = compressed_body(req.body_size, req.coding);
+
+        std::string& header = headers_.emplace_back();
+        header.append("HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n");
+        if (compressed)
+        {
+            header.append("Content-Encoding: ")
+                .append(req.coding == content_coding::gzip ? "gzip" : "deflate")
+                .append("\r\n");
+        }
+        header.append("Content-Length: ")
+            .append(std::to_string(compressed ? compressed->size() : req.body_size))
+            .append(req.keep_alive ? "\r\n\r\n" : "\r\nConnection: close\r\n\r\n");
+        buffers_.push_back(asio::buffer(header));
+
+        if (compressed)
+        {
+            buffers_.push_back(asio::buffer(*compressed));
+            compressed_bodies_.push_back(std::move(compressed));
+            return;
+        }
+        const std::string& pattern = body_pattern();
+        for (std::size_t remaining = req.body_size; remaining > 0;)
+        {
+            std::size_t chunk = std::min(remaining, pattern.size());
+            buffers_.push_back(asio::buffer(pattern.data(), chunk));
+            remaining -= chunk;
+        }
+    }
+
+    bool empty() const noexcept { return buffers_.empty(); }
+
+    asio::awaitable<error_code> flush(asio::ip::tcp::socket& sock)
+    {
+        auto [ec, n] = co_await asio::async_write(sock, buffers_, asio::as_tuple(asio::deferred));
+        headers_.clear();
+        compressed_bodies_.clear();
+        buffers_.clear();
+        co_return ec;
+    }
+};
+
+static asio::awaitable<void> run_session(asio::ip::tcp::socket sock, const server_config& cfg)
+{
+    constexpr auto tok = asio::as_tuple(asio::deferred);
+    sock.set_option(asio::ip::tcp::no_delay(true));
+
+    std::string buff;
+    std::size_t buff_size = 0;  // Bytes of buff that contain data
+    response_writer writer;
+    asio::steady_timer timer(sock.get_executor());
+
+    while (true)
+    {
+        // Read whatever is available. With pipelining, this may contain several requests
+        if (buff.size() - buff_size < 4096)
+            buff.resize(std::max<std::size_t>(buff.size() * 2, 8192));
+        auto [ec, n] = co_await sock.async_read_some(
+            asio::buffer(buff.data() + buff_size, buff.size() - buff_size),
+            tok
+        );
+        if (ec)
+            co_return;  // Client closed the connection, or error
+        buff_size += n;
+
+        // Process all complete requests, in order
+        std::size_t consumed = 0;
+        bool keep_alive = true;
+        while (keep_alive)
+        {
+            auto req = parse_request(std::string_view(buff.data() + consumed, buff_size - consumed), cfg);
+            if (!req)
+                break;
+            consumed += req->size;
+            keep_alive = req->keep_alive;
+
+            // Responses must be sent in order, so a delayed response delays the ones after it
+            if (req->latency.count() > 0)
+            {
+                if (!writer.empty() && co_await writer.flush(sock))
+                    co_return;
+                timer.expires_after(req->latency);
+                co_await timer.async_wait(tok);
+            }
+            writer.add(*req);
+        }
+
+        // Shift any partial request to the start of the buffer
+        std::copy(buff.begin() + consumed, buff.begin() + buff_size, buff.begin());
+        buff_size -= consumed;
+
+        if (!writer.empty() && co_await writer.flush(sock))
+            co_return;
+        if (!keep_alive)
+        {
+            error_code ignored;
+            sock.shutdown(asio::ip::tcp::socket::shutdown_send, ignored);
+            co_return;
+        }
+    }
+}
+
+static asio::awaitable<void> run_acceptor(const server_config& cfg)
+{
+    auto ex = co_await asio::this_coro::executor;
+    asio::ip::tcp::endpoint endpoint(asio::ip::make_address(cfg.address), cfg.port);
+
+    // Each thread has its own acceptor. SO_REUSEPORT must be set before binding
+    asio::ip::tcp::acceptor acceptor(ex);
+    acceptor.open(endpoint.protocol());
+    acceptor.set_option(asio::socket_base::reuse_address(true));
+    acceptor.set_option(reuse_port(true));
+    acceptor.bind(endpoint);
+    acceptor.listen(asio::socket_base::max_listen_connections);
+
+    asio::steady_timer backoff(ex);
+    while (true)
+    {
+        auto [ec, sock] = co_await acceptor.async_accept(asio::as_tuple(asio::deferred));
+        if (ec == asio::error::operation_aborted)
+            co_return;
+        if (ec)
+        {
+            // Likely running out of file descriptors (EMFILE). Retrying right away would fail again
+            // and spin, so give sessions some time to close their sockets first
+            std::cerr << "Error accepting: " << ec.message() << std::endl;
+            backoff.expires_after(std::chrono::milliseconds(100));
+            co_await backoff.async_wait(asio::as_tuple(asio::deferred));
+            continue;
+        }
+        asio::co_spawn(ex, run_session(std::move(sock), cfg), asio::detached);
+    }
+}
+
+static void usage(const char* program)
+{
+    std::cerr << "Usage: " << program
+              << " [--address <ip>] [--port <port>] [--threads <n>] [--body-size <bytes>] "
+                 "[--latency-us <us>]\n";
+    std::exit(1);
+}
+
+int main(int argc, char** argv)
+{
+    server_config cfg;
+    for (int i = 1; i < argc; i += 2)
+    {
+        if (i + 1 >= argc)
+            usage(argv[0]);
+        std::string_view opt = argv[i];
+        const char* value = argv[i + 1];
+        if (opt == "--address")
+            cfg.address = value;
+        else if (opt == "--port")
+            cfg.port = static_cast<unsigned short>(std::stoul(value));
+        else if (opt == "--threads")
+            cfg.threads = std::max<std::size_t>(std::stoul(value), 1u);
+        else if (opt == "--body-size")
+            cfg.body_size = std::stoul(value);
+        else if (opt == "--latency-us")
+            cfg.latency = std::chrono::microseconds(std::stol(value));
+        else
+            usage(argv[0]);
+    }
+
+    // One single-threaded io_context per thread
+    std::vector<std::unique_ptr<asio::io_context>> contexts;
+    for (std::size_t i = 0; i < cfg.threads; ++i)
+    {
+        auto& ctx = *contexts.emplace_back(std::make_unique<asio::io_context>(1));
+        asio::co_spawn(ctx, run_acceptor(cfg), [](std::exception_ptr exc) {
+            if (exc)
+                std::rethrow_exception(exc);
+        });
+    }
+
+    std::cout << "Listening on " << cfg.address << ":" << cfg.port << " with " << cfg.threads << " threads"
+              << std::endl;
+
+    std::vector<std::thread> threads;
+    for (std::size_t i = 1; i < cfg.threads; ++i)
+        threads.emplace_back([&ctx = *contexts[i]] { ctx.run(); });
+    contexts[0]->run();
+    for (auto& t : threads)
+        t.join();
+}
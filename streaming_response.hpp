@@ -0,0 +1,196 @@
+#ifndef USINGSTDCPP_2024_STREAMING_RESPONSE_HPP
+#define USINGSTDCPP_2024_STREAMING_RESPONSE_HPP
+
+#include <boost/asio/append.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/compose.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http/buffer_body.hpp>
+#include <boost/beast/http/error.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/beast/http/parser.hpp>
+#include <boost/beast/http/read.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+// Reads an HTTP response body in chunks, as it arrives, instead of into a string.
+// beast.cpp reads into an http::response<http::string_body>, which holds the entire body in memory
+// until the response is complete. Here, the body is parsed with a response_parser<buffer_body>
+// into a fixed-size chunk buffer, so memory use doesn't depend on the response size:
+//
+//     streaming_response_reader<asio::ip::tcp::socket> reader(sock);
+//     co_await reader.async_read_header(asio::deferred);
+//     while (!reader.done())
+//     {
+//         asio::const_buffer chunk = co_await reader.async_read_chunk(asio::deferred);
+//         // Use chunk. It's valid until the next call to async_read_chunk
+//     }
+//
+// This is backpressure by construction: nothing is read from the stream until the consumer asks
+// for the next chunk, so a slow consumer makes TCP flow control slow down the server.
+// async_stream_response_body wraps this loop for consumers that are plain callbacks.
+//
+// Bodies larger than body_limit fail with http::error::body_limit, before the excess is read.
+// One reader per response. Not thread-safe, and the stream must outlive the reader.
+
+struct streaming_response_options
+{
+    std::uint64_t body_limit{64 * 1024 * 1024};
+    std::uint32_t header_limit{8 * 1024};
+    std::size_t chunk_size{64 * 1024};
+};
+
+template <class AsyncStream>
+class streaming_response_reader
+{
+    template <class>
+    friend struct read_body_chunk_op;
+
+    using parser_type = boost::beast::http::response_parser<boost::beast::http::buffer_body>;
+
+    AsyncStream& stream_;
+    std::size_t chunk_size_;
+    std::unique_ptr<char[]> chunk_;
+    boost::beast::flat_buffer buffer_;  // Holds the headers, or at most one read from the stream
+    parser_type parser_;
+
+public:
+    explicit streaming_response_reader(AsyncStream& stream, const streaming_response_options& opts = {})
+        : stream_(stream),
+          chunk_size_(opts.chunk_size),
+          chunk_(new char[opts.chunk_size]),
+          buffer_(opts.header_limit + 64 * 1024)  // Beast reads up to 64KB at a time
+    {
+        parser_.body_limit(opts.body_limit);
+        parser_.header_limit(opts.header_limit);
+    }
+
+    streaming_response_reader(const streaming_response_reader&) = delete;
+    streaming_response_reader& operator=(const streaming_response_reader&) = delete;
+
+    AsyncStream& stream() noexcept { return stream_; }
+
+    // Valid once async_read_header has completed
+    const boost::beast::http::response_header<>& header() const { return parser_.get().base(); }
+
+    // True when the whole body has been delivered
+    bool done() const { return parser_.is_done(); }
+
+    // Signature: void(error_code, std::size_t bytes_read)
+    template <class CompletionToken>
+    auto async_read_header(CompletionToken&& token)
+    {
+        return boost::beast::http::async_read_header(
+            stream_,
+            buffer_,
+            parser_,
+            std::forward<CompletionToken>(token)
+        );
+    }
+
+    // Signature: void(error_code, asio::const_buffer chunk).
+    // chunk points into the reader, and is valid until the next call. Empty when done()
+    template <class CompletionToken>
+    auto async_read_chunk(CompletionToken&& token);
+};
+
+template <class AsyncStream>
+struct read_body_chunk_op
+{
+    streaming_response_reader<AsyncStream>& reader;
+
+    template <class Self>
+    void operator()(Self& self)
+    {
+        auto& body = reader.parser_.get().body();
+        body.data = reader.chunk_.get();
+        body.size = reader.chunk_size_;
+
+        // Nothing left to read. Don't complete from within the initiating function
+        if (reader.done())
+            return boost::asio::post(boost::asio::append(std::move(self), boost::system::error_code(), 0u));
+
+        // Reads until the chunk buffer is full or the message is complete
+        boost::beast::http::async_read(reader.stream_, reader.buffer_, reader.parser_, std::move(self));
+    }
+
+    template <class Self>
+    void operator()(Self& self, boost::system::error_code ec, std::size_t)
+    {
+        // need_buffer means that the chunk buffer is full, which is what we're waiting for
+        if (ec == boost::beast::http::error::need_buffer)
+            ec.clear();
+        std::size_t size = ec ? 0u : reader.chunk_size_ - reader.parser_.get().body().size;
+        self.complete(ec, boost::asio::const_buffer(reader.chunk_.get(), size));
+    }
+};
+
+template <class AsyncStream>
+template <class CompletionToken>
+auto streaming_response_reader<AsyncStream>::async_read_chunk(CompletionToken&& token)
+{
+    using signature = void(boost::system::error_code, boost::asio::const_buffer);
+    return boost::asio::async_compose<CompletionToken, signature>(
+        read_body_chunk_op<AsyncStream>{*this},
+        token,
+        stream_
+    );
+}
+
+// Reads the rest of the body, calling on_chunk(asio::const_buffer) for each chunk.
+// The next chunk isn't read until on_chunk returns
+template <class AsyncStream, class ChunkHandler>
+struct stream_response_body_op
+{
+    streaming_response_reader<AsyncStream>& reader;
+    ChunkHandler on_chunk;
+    std::uint64_t total{0};
+
+    template <class Self>
+    void operator()(Self& self)
+    {
+        reader.async_read_chunk(std::move(self));
+    }
+
+    template <class Self>
+    void operator()(Self& self, boost::system::error_code ec, boost::asio::const_buffer chunk)
+    {
+        if (ec)
+            return self.complete(ec, total);
+        if (chunk.size())
+        {
+            total += chunk.size();
+            on_chunk(chunk);
+        }
+        if (reader.done())
+            return self.complete(ec, total);
+        reader.async_read_chunk(std::move(self));
+    }
+};
+
+// Completes with the number of body bytes delivered to on_chunk.
+// The headers must have been read with reader.async_read_header
+template <
+    class AsyncStream,
+    class ChunkHandler,
+    boost::asio::completion_token_for<void(boost::system::error_code, std::uint64_t)> CompletionToken>
+auto async_stream_response_body(
+    streaming_response_reader<AsyncStream>& reader,
+    ChunkHandler on_chunk,
+    CompletionToken&& token
+)
+{
+    return boost::asio::async_compose<CompletionToken, void(boost::system::error_code, std::uint64_t)>(
+        stream_response_body_op<AsyncStream, ChunkHandler>{reader, std::move(on_chunk)},
+        token,
+        reader.stream()
+    );
+}
+
+#endif
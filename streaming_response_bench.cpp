@@ -0,0 +1,166 @@
+
+#include <boost/asio/as_tuple.hpp>
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/beast/http/read.hpp>
+#include <boost/beast/http/string_body.hpp>
+#include <boost/system/error_code.hpp>
+#include <boost/system/system_error.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include <sys/resource.h>
+
+#include "streaming_response.hpp"
+
+// Peak memory use when reading large responses: the whole body into an http::string_body,
+// against streaming it through streaming_response_reader in 64KB chunks.
+// The responses are served over loopback by a coroutine in the same io_context, which writes
+// the body from a single 64KB buffer, so it doesn't add to the memory use.
+//
+// The peak RSS of a process never decreases, so the streaming runs go first. Their peak
+// should stay flat as the responses grow, while the string_body ones grow with the response.
+// Usage: streaming_response_bench [max size in MB]
+
+namespace asio = boost::asio;
+namespace beast = boost::beast;
+namespace http = beast::http;
+using boost::system::error_code;
+using asio::ip::tcp;
+
+// In KB on Linux
+static long peak_rss_kb()
+{
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static asio::awaitable<void> serve_response(tcp::socket sock, std::uint64_t body_size)
+{
+    static const std::string pattern(64 * 1024, 'x');
+    std::string header = "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body_size) + "\r\n\r\n";
+    co_await asio::async_write(sock, asio::buffer(header), asio::deferred);
+    for (std::uint64_t remaining = body_size; remaining > 0;)
+    {
+        std::size_t n = static_cast<std::size_t>(std::min<std::uint64_t>(remaining, pattern.size()));
+        auto [ec, written] = co_await asio::async_write(
+            sock,
+            asio::buffer(pattern, n),
+            asio::as_tuple(asio::deferred)
+        );
+        if (ec)
+            co_return;  // The client gave up, e.g. because of the body limit
+        remaining -= written;
+    }
+}
+
+static asio::awaitable<std::uint64_t> read_string_body(tcp::socket& sock)
+{
+    beast::flat_buffer buff;
+    http::response_parser<http::string_body> parser;
+    parser.body_limit(boost::none);
+    co_await http::async_read(sock, buff, parser, asio::deferred);
+    co_return parser.get().body().size();
+}
+
+static asio::awaitable<std::uint64_t> read_streaming(tcp::socket& sock, std::uint64_t body_limit)
+{
+    streaming_response_reader<tcp::socket> reader(sock, {.body_limit = body_limit});
+    co_await reader.async_read_header(asio::deferred);
+
+    // A trivial consumer, so the chunks are actually touched
+    std::uint64_t checksum = 0;
+    std::uint64_t total = co_await async_stream_response_body(
+        reader,
+        [&checksum](asio::const_buffer chunk) {
+            const auto* p = static_cast<const unsigned char*>(chunk.data());
+            checksum += p[0] + p[chunk.size() - 1];
+        },
+        asio::deferred
+    );
+    co_return checksum ? total : 0;
+}
+
+// Fetches a response of body_size bytes from an in-process server
+template <class ReadFunction>
+static void run(std::string_view name, std::uint64_t body_size, ReadFunction read_fn)
+{
+    asio::io_context ctx;
+    tcp::acceptor acceptor(ctx, tcp::endpoint(asio::ip::make_address("127.0.0.1"), 0));
+
+    asio::co_spawn(
+        ctx,
+        [&]() -> asio::awaitable<void> {
+            tcp::socket server_sock = co_await acceptor.async_accept(asio::deferred);
+            co_await serve_response(std::move(server_sock), body_size);
+        },
+        asio::detached
+    );
+
+    asio::co_spawn(
+        ctx,
+        [&]() -> asio::awaitable<void> {
+            tcp::socket sock(ctx);
+            co_await sock.async_connect(acceptor.local_endpoint(), asio::deferred);
+            auto start = std::chrono::steady_clock::now();
+            std::uint64_t bytes = co_await read_fn(sock);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << "  " << name << ": " << bytes / (1024 * 1024) << "MB body, "
+                      << bytes / elapsed.count() / (1024 * 1024) << " MB/s, peak RSS " << peak_rss_kb() / 1024
+                      << "MB" << std::endl;
+        },
+        [name](std::exception_ptr exc) {
+            try
+            {
+                if (exc)
+                    std::rethrow_exception(exc);
+            }
+            catch (const boost::system::system_error& err)
+            {
+                std::cout << "  " << name << ": " << err.code().message() << std::endl;
+            }
+        }
+    );
+
+    ctx.run();
+}
+
+int main(int argc, char** argv)
+{
+    std::uint64_t max_size_mb = argc > 1 ? std::stoull(argv[1]) : 512;
+    constexpr std::uint64_t mb = 1024 * 1024;
+    std::cout << "Peak RSS at startup: " << peak_rss_kb() / 1024 << "MB\n";
+
+    std::cout << "Streaming:\n";
+    for (std::uint64_t size = 16; size <= max_size_mb; size *= 4)
+    {
+        run("streaming_response_reader", size * mb, [](tcp::socket& sock) {
+            return read_streaming(sock, std::uint64_t(-1));
+        });
+    }
+
+    // Bodies over the limit fail as soon as the Content-Length is known
+    std::cout << "Streaming, with a body limit of 8MB:\n";
+    run("streaming_response_reader", 16 * mb, [](tcp::socket& sock) { return read_streaming(sock, 8 * mb); });
+
+    std::cout << "Whole body:\n";
+    for (std::uint64_t size = 16; size <= max_size_mb; size *= 4)
+        run("http::string_body", size * mb, [](tcp::socket& sock) { return read_string_body(sock); });
+}
@@ -10,10 +10,13 @@
 
 #include <array>
 #include <cstddef>
+#include <cstdlib>
 #include <iostream>
 #include <string>
 #include <string_view>
 
+#include "example_target.hpp"
+
 namespace asio = boost::asio;
 
 // The GET HTTP request to send to the server
@@ -23,13 +26,18 @@ static constexpr std::string_view request =
     "User-Agent: Asio\r\n"
     "Accept: */*\r\n\r\n";
 
-// v1: we connect to the server, attempt to write the request and read the response
+// v1: we connect to the server, attempt to write the request and read the response.
+// v1 and v2 connect to an IP address, so EXAMPLES_HOST must be an IP literal (like 127.0.0.1)
+// for them: a host name like localhost makes from_string throw. v3 shows how to resolve host names
 void handle_request_v1(asio::io_context& ctx)
 {
     asio::ip::tcp::socket sock(ctx);
 
     // Connect to the server
-    sock.connect(asio::ip::tcp::endpoint(asio::ip::address::from_string("18.154.41.87"), 80));
+    sock.connect(asio::ip::tcp::endpoint(
+        asio::ip::address::from_string(example_host("18.154.41.87")),
+        static_cast<unsigned short>(std::atoi(example_port()))
+    ));
 
     // Write the request
     sock.write_some(asio::buffer(request));
@@ -47,7 +55,10 @@ void handle_request_v2(asio::io_context& ctx)
     asio::ip::tcp::socket sock(ctx);
 
     // Connect to the server
-    sock.connect(asio::ip::tcp::endpoint(asio::ip::address::from_string("18.154.41.87"), 80));
+    sock.connect(asio::ip::tcp::endpoint(
+        asio::ip::address::from_string(example_host("18.154.41.87")),
+        static_cast<unsigned short>(std::atoi(example_port()))
+    ));
 
     // Write the request
     asio::write(sock, asio::buffer(request));
@@ -69,7 +80,7 @@ void handle_request_v3(asio::io_context& ctx)
     asio::ip::tcp::resolver resolv(ctx);
 
     // Resolve the hostname and port into a set of endpoints
-    auto endpoints = resolv.resolve("example.com", "80");
+    auto endpoints = resolv.resolve(example_host("example.com"), example_port());
 
     // Connect to the server
     asio::connect(sock, endpoints);
@@ -92,7 +103,7 @@ void handle_request_v4(asio::any_io_executor ex)
     asio::ip::tcp::resolver resolv(ex);
 
     // Resolve the hostname and port into a set of endpoints
-    auto endpoints = resolv.resolve("example.com", "80");
+    auto endpoints = resolv.resolve(example_host("example.com"), example_port());
 
     // Connect to the server
     asio::connect(sock, endpoints);
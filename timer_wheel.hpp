@@ -0,0 +1,379 @@
+#ifndef USINGSTDCPP_2024_TIMER_WHEEL_HPP
+#define USINGSTDCPP_2024_TIMER_WHEEL_HPP
+
+#include <boost/asio/associated_allocator.hpp>
+#include <boost/asio/associated_cancellation_slot.hpp>
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/cancellation_signal.hpp>
+#include <boost/asio/cancellation_type.hpp>
+#include <boost/asio/execution_context.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "io_context_of.hpp"
+
+// A hashed timer wheel shared by all the operations of an io_context, for per-request timeouts at scale.
+// timeouts.cpp races each request against its own steady_timer in a parallel_group. That's one entry
+// in the io_context's heap-ordered timer queue per request, plus the parallel group's state.
+// Here, arming a deadline links a node into a slot of a fixed array (O(1)), and cancelling it
+// unlinks the node (O(1)). A single steady_timer ticks every millisecond while deadlines are pending.
+//
+// with_timeout(token, duration) is a completion token adapter:
+//
+//     co_await sock.async_read_some(buff, with_timeout(asio::deferred, std::chrono::seconds(5)));
+//
+// When the deadline fires, it emits per-operation cancellation (terminal by default)
+// on the operation's cancellation slot. Cancellation requested by the handler's own slot
+// (e.g. a parent coroutine) is still forwarded to the operation.
+//
+// The wheel is an io_context service, found through the handler's associated executor,
+// or the I/O object's executor for handlers without one. Deadlines have millisecond resolution
+// and may fire up to one tick late. The wheel is not thread-safe: each io_context must be run
+// by a single thread, like the ones in io_context_pool.
+
+class timer_wheel : public boost::asio::execution_context::service
+{
+public:
+    using clock = std::chrono::steady_clock;
+
+    static inline boost::asio::execution_context::id id;
+
+    static constexpr clock::duration resolution = std::chrono::milliseconds(1);
+    // A revolution is ~4s. Longer deadlines stay in their slot for several rounds
+    static constexpr std::size_t num_slots = 4096;
+
+    // Intrusive node, so arming a deadline doesn't allocate. Must stay at the same address while armed
+    struct entry
+    {
+        entry* prev{nullptr};
+        entry* next{nullptr};
+        std::uint64_t expiry_tick{0};
+        void (*on_expire)(entry&){nullptr};
+
+        bool armed() const noexcept { return next != nullptr; }
+    };
+
+private:
+    boost::asio::steady_timer ticker_;
+    clock::time_point epoch_;
+    std::array<entry, num_slots> slots_;  // Sentinels of circular lists
+    std::uint64_t processed_tick_{0};     // All slots up to this tick have been processed
+    std::size_t size_{0};
+    bool ticking_{false};
+
+    static void init_list(entry& head) noexcept { head.prev = head.next = &head; }
+
+    static void link(entry& head, entry& e) noexcept
+    {
+        e.next = &head;
+        e.prev = head.prev;
+        head.prev->next = &e;
+        head.prev = &e;
+    }
+
+    static void unlink(entry& e) noexcept
+    {
+        e.prev->next = e.next;
+        e.next->prev = e.prev;
+        e.prev = e.next = nullptr;
+    }
+
+    std::uint64_t to_tick(clock::time_point tp) const noexcept
+    {
+        return static_cast<std::uint64_t>((tp - epoch_) / resolution);
+    }
+
+    void schedule_tick()
+    {
+        ticking_ = true;
+        ticker_.expires_at(epoch_ + resolution * (processed_tick_ + 1));
+        ticker_.async_wait([this](boost::system::error_code ec) {
+            if (!ec)
+                on_tick();
+        });
+    }
+
+    void on_tick()
+    {
+        ticking_ = false;
+        std::uint64_t now_tick = to_tick(clock::now());
+
+        // Move the expired entries to a local list first: firing one may complete
+        // an operation inline, which can remove other entries
+        entry expired;
+        init_list(expired);
+        std::uint64_t last = std::min(now_tick, processed_tick_ + num_slots);
+        for (std::uint64_t tick = processed_tick_ + 1; tick <= last; ++tick)
+        {
+            entry& head = slots_[tick % num_slots];
+            for (entry* e = head.next; e != &head;)
+            {
+                entry* next = e->next;
+                if (e->expiry_tick <= now_tick)
+                {
+                    unlink(*e);
+                    link(expired, *e);
+                }
+                e = next;
+            }
+        }
+        processed_tick_ = std::max(processed_tick_, now_tick);
+
+        while (expired.next != &expired)
+        {
+            entry& e = *expired.next;
+            unlink(e);
+            --size_;
+            e.on_expire(e);
+        }
+
+        if (size_ != 0 && !ticking_)
+            schedule_tick();
+    }
+
+    void shutdown() override { ticker_.cancel(); }
+
+public:
+    explicit timer_wheel(boost::asio::io_context& ctx)
+        : boost::asio::execution_context::service(ctx),
+          ticker_(ctx),
+          epoch_(clock::now() - std::chrono::seconds(1))  // So tick numbers are never 0
+    {
+        for (auto& head : slots_)
+            init_list(head);
+    }
+
+    // The wheel for the io_context running ex. ex must be an io_context executor,
+    // or a polymorphic executor holding one. Throws otherwise
+    template <class Executor>
+    static timer_wheel& use(const Executor& ex)
+    {
+        return boost::asio::use_service<timer_wheel>(io_context_of(ex));
+    }
+
+    // Calls e.on_expire(e) once timeout has elapsed, unless removed before
+    void add(entry& e, clock::duration timeout)
+    {
+        auto now = clock::now();
+        if (size_ == 0 && !ticking_)
+            processed_tick_ = to_tick(now) - 1;  // Nothing to catch up with
+
+        // Round up, so we never fire early
+        std::uint64_t tick = to_tick(now + timeout + resolution - clock::duration(1));
+        e.expiry_tick = std::max(tick, processed_tick_ + 1);
+        link(slots_[e.expiry_tick % num_slots], e);
+        ++size_;
+        if (!ticking_)
+            schedule_tick();
+    }
+
+    void remove(entry& e) noexcept
+    {
+        if (e.armed())
+        {
+            unlink(e);
+            --size_;
+        }
+    }
+
+    // Number of armed deadlines
+    std::size_t size() const noexcept { return size_; }
+};
+
+namespace detail {
+
+struct timeout_state : timer_wheel::entry
+{
+    timer_wheel* wheel;
+    boost::asio::cancellation_signal sig;  // Connected to the operation's cancellation slot
+    boost::asio::cancellation_type type;
+
+    timeout_state(timer_wheel& w, boost::asio::cancellation_type t) : wheel(&w), type(t)
+    {
+        on_expire = [](timer_wheel::entry& e) {
+            auto& self = static_cast<timeout_state&>(e);
+            self.sig.emit(self.type);
+        };
+    }
+};
+
+// Installed in the handler's cancellation slot, if it has one
+struct forward_cancellation
+{
+    boost::asio::cancellation_signal& sig;
+
+    void operator()(boost::asio::cancellation_type type) { sig.emit(type); }
+};
+
+// Wraps the operation's handler. The deadline state is allocated with the handler's allocator,
+// and released before calling the handler
+template <class Handler>
+class timeout_handler
+{
+    using state_allocator = typename std::allocator_traits<
+        boost::asio::associated_allocator_t<Handler>>::template rebind_alloc<timeout_state>;
+
+    Handler handler_;
+    timeout_state* st_;
+
+    void destroy_state() noexcept
+    {
+        if (!st_)
+            return;
+        st_->wheel->remove(*st_);
+        auto slot = boost::asio::get_associated_cancellation_slot(handler_);
+        if (slot.is_connected())
+            slot.clear();
+        state_allocator alloc(boost::asio::get_associated_allocator(handler_));
+        std::allocator_traits<state_allocator>::destroy(alloc, st_);
+        std::allocator_traits<state_allocator>::deallocate(alloc, st_, 1);
+        st_ = nullptr;
+    }
+
+public:
+    using cancellation_slot_type = boost::asio::cancellation_slot;
+
+    timeout_handler(
+        Handler handler,
+        timer_wheel& wheel,
+        timer_wheel::clock::duration timeout,
+        boost::asio::cancellation_type type
+    )
+        : handler_(std::move(handler))
+    {
+        state_allocator alloc(boost::asio::get_associated_allocator(handler_));
+        st_ = std::allocator_traits<state_allocator>::allocate(alloc, 1);
+        std::allocator_traits<state_allocator>::construct(alloc, st_, wheel, type);
+
+        auto slot = boost::asio::get_associated_cancellation_slot(handler_);
+        if (slot.is_connected())
+            slot.template emplace<forward_cancellation>(st_->sig);
+
+        wheel.add(*st_, timeout);
+    }
+
+    timeout_handler(timeout_handler&& other) noexcept
+        : handler_(std::move(other.handler_)), st_(std::exchange(other.st_, nullptr))
+    {
+    }
+
+    timeout_handler& operator=(timeout_handler&&) = delete;
+
+    ~timeout_handler() { destroy_state(); }
+
+    const Handler& handler() const noexcept { return handler_; }
+
+    cancellation_slot_type get_cancellation_slot() const noexcept { return st_->sig.slot(); }
+
+    template <class... Args>
+    void operator()(Args&&... args)
+    {
+        destroy_state();
+        std::move(handler_)(std::forward<Args>(args)...);
+    }
+};
+
+template <class Initiation>
+struct timeout_initiation
+{
+    Initiation initiation;
+    timer_wheel::clock::duration timeout;
+    boost::asio::cancellation_type type;
+
+    template <class Handler, class... Args>
+    void operator()(Handler&& handler, Args&&... args) &&
+    {
+        // Handlers without an associated executor (e.g. plain callbacks) run in the I/O object's one
+        auto ex = [&] {
+            if constexpr (requires { initiation.get_executor(); })
+                return boost::asio::get_associated_executor(handler, initiation.get_executor());
+            else
+                return boost::asio::get_associated_executor(handler);
+        }();
+        timer_wheel& wheel = timer_wheel::use(ex);
+        std::move(initiation)(
+            timeout_handler<std::decay_t<Handler>>(std::forward<Handler>(handler), wheel, timeout, type),
+            std::forward<Args>(args)...
+        );
+    }
+};
+
+}  // namespace detail
+
+template <class CompletionToken>
+struct with_timeout_t
+{
+    CompletionToken token;
+    timer_wheel::clock::duration timeout;
+    boost::asio::cancellation_type type;
+};
+
+// Adapts token so the operation is cancelled if it doesn't complete within timeout
+template <class CompletionToken>
+with_timeout_t<std::decay_t<CompletionToken>> with_timeout(
+    CompletionToken&& token,
+    timer_wheel::clock::duration timeout,
+    boost::asio::cancellation_type type = boost::asio::cancellation_type::terminal
+)
+{
+    return {std::forward<CompletionToken>(token), timeout, type};
+}
+
+template <class CompletionToken, class... Signatures>
+struct boost::asio::async_result<with_timeout_t<CompletionToken>, Signatures...>
+{
+    template <class Initiation, class RawCompletionToken, class... Args>
+    static auto initiate(Initiation&& initiation, RawCompletionToken&& token, Args&&... args)
+    {
+        auto timeout = token.timeout;
+        auto type = token.type;
+        CompletionToken inner = std::forward<RawCompletionToken>(token).token;
+        using initiation_type = detail::timeout_initiation<std::decay_t<Initiation>>;
+        return boost::asio::async_initiate<CompletionToken, Signatures...>(
+            initiation_type{std::forward<Initiation>(initiation), timeout, type},
+            inner,
+            std::forward<Args>(args)...
+        );
+    }
+};
+
+template <class Handler, class DefaultCandidate>
+struct boost::asio::associated_executor<detail::timeout_handler<Handler>, DefaultCandidate>
+{
+    using type = boost::asio::associated_executor_t<Handler, DefaultCandidate>;
+
+    static type get(
+        const detail::timeout_handler<Handler>& h,
+        const DefaultCandidate& candidate = DefaultCandidate()
+    ) noexcept
+    {
+        return boost::asio::get_associated_executor(h.handler(), candidate);
+    }
+};
+
+template <class Handler, class DefaultCandidate>
+struct boost::asio::associated_allocator<detail::timeout_handler<Handler>, DefaultCandidate>
+{
+    using type = boost::asio::associated_allocator_t<Handler, DefaultCandidate>;
+
+    static type get(
+        const detail::timeout_handler<Handler>& h,
+        const DefaultCandidate& candidate = DefaultCandidate()
+    ) noexcept
+    {
+        return boost::asio::get_associated_allocator(h.handler(), candidate);
+    }
+};
+
+#endif
@@ -0,0 +1,154 @@
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string_view>
+#include <vector>
+
+#include "timer_wheel.hpp"
+
+// Compares the cost of per-request deadlines using a steady_timer per request (like timeouts.cpp)
+// against timer_wheel, with 10k, 100k and 1M deadlines pending at the same time:
+//   - arm: time to set up a deadline, and heap bytes used by each pending deadline.
+//   - cancel: time to cancel a pending deadline, including running any handler this causes.
+//     Cancelling a steady_timer runs its handler with operation_aborted. Removing a timer_wheel entry
+//     runs nothing, so its time stops before ctx.run(), which only waits for the ticker to stop.
+//   - post + deadline: end-to-end cost of an operation that completes before its deadline.
+// Usage: timer_wheel_bench
+
+namespace asio = boost::asio;
+using boost::system::error_code;
+using clock_type = std::chrono::steady_clock;
+
+// Count the bytes requested from the global operator new
+static std::atomic<std::uint64_t> bytes_allocated{0};
+
+void* operator new(std::size_t size)
+{
+    bytes_allocated.fetch_add(size, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+constexpr auto deadline = std::chrono::seconds(30);
+
+static double ns_per_op(clock_type::duration elapsed, std::size_t n)
+{
+    return std::chrono::duration<double, std::nano>(elapsed).count() / n;
+}
+
+static void print_results(
+    std::string_view name,
+    std::size_t n,
+    clock_type::duration arm,
+    std::string_view cancel_label,
+    clock_type::duration cancel,
+    std::uint64_t bytes
+)
+{
+    std::cout << "  " << name << ": arm " << ns_per_op(arm, n) << " ns, " << cancel_label << " "
+              << ns_per_op(cancel, n) << " ns, " << static_cast<double>(bytes) / n << " bytes/deadline\n";
+}
+
+static void bench_steady_timer(std::size_t n)
+{
+    asio::io_context ctx;
+    std::size_t fired = 0;
+
+    auto bytes_before = bytes_allocated.load();
+    auto start = clock_type::now();
+    std::vector<asio::steady_timer> timers;
+    timers.reserve(n);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        auto& timer = timers.emplace_back(ctx, deadline);
+        timer.async_wait([&fired](error_code) { ++fired; });
+    }
+    auto arm = clock_type::now() - start;
+    auto bytes = bytes_allocated.load() - bytes_before;
+
+    // Cancelling a timer schedules its handler with operation_aborted, so run them too
+    start = clock_type::now();
+    for (auto& timer : timers)
+        timer.cancel();
+    ctx.run();
+    auto cancel = clock_type::now() - start;
+
+    print_results("steady_timer", n, arm, "cancel + run handlers", cancel, bytes);
+}
+
+static void bench_timer_wheel(std::size_t n)
+{
+    asio::io_context ctx;
+    auto& wheel = asio::use_service<timer_wheel>(ctx);
+
+    auto bytes_before = bytes_allocated.load();
+    auto start = clock_type::now();
+    std::vector<timer_wheel::entry> entries(n);
+    for (auto& e : entries)
+    {
+        e.on_expire = [](timer_wheel::entry&) {};
+        wheel.add(e, deadline);
+    }
+    auto arm = clock_type::now() - start;
+    auto bytes = bytes_allocated.load() - bytes_before;
+
+    start = clock_type::now();
+    for (auto& e : entries)
+        wheel.remove(e);
+    auto cancel = clock_type::now() - start;
+    ctx.run();  // The ticker stops once the wheel is empty. Not timed: it waits for the next tick
+
+    print_results("timer_wheel", n, arm, "remove (no handlers)", cancel, bytes);
+}
+
+// Operations that complete immediately, each protected by a deadline that never fires
+static void bench_post_steady_timer(std::size_t n)
+{
+    asio::io_context ctx;
+    auto start = clock_type::now();
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        auto timer = std::make_shared<asio::steady_timer>(ctx, deadline);
+        timer->async_wait([](error_code) {});
+        asio::post(ctx, [timer] { timer->cancel(); });
+    }
+    ctx.run();
+    std::cout << "  post + steady_timer: " << ns_per_op(clock_type::now() - start, n) << " ns/op\n";
+}
+
+static void bench_post_with_timeout(std::size_t n)
+{
+    asio::io_context ctx;
+    auto start = clock_type::now();
+    for (std::size_t i = 0; i < n; ++i)
+        asio::post(ctx, with_timeout([] {}, deadline));
+    ctx.run();
+    std::cout << "  post + with_timeout: " << ns_per_op(clock_type::now() - start, n) << " ns/op\n";
+}
+
+int main()
+{
+    for (std::size_t n : {10'000, 100'000, 1'000'000})
+    {
+        std::cout << n << " pending deadlines:\n";
+        bench_steady_timer(n);
+        bench_timer_wheel(n);
+        bench_post_steady_timer(n);
+        bench_post_with_timeout(n);
+    }
+}
@@ -0,0 +1,546 @@
+#ifndef USINGSTDCPP_2024_WORK_STEALING_POOL_HPP
+#define USINGSTDCPP_2024_WORK_STEALING_POOL_HPP
+
+#include <boost/asio/execution/blocking.hpp>
+#include <boost/asio/execution/context.hpp>
+#include <boost/asio/execution/mapping.hpp>
+#include <boost/asio/execution/outstanding_work.hpp>
+#include <boost/asio/execution_context.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// A thread pool for CPU-heavy work, like parsing or hashing response bodies, so it doesn't
+// run on the io_context thread and delay the completions of every other socket.
+// Its executor meets Asio's executor requirements, so it works with asio::post, bind_executor,
+// co_spawn and any_io_executor. A coroutine running on an io_context can hop onto the pool
+// and back:
+//
+//     co_await asio::post(cpu_pool, asio::bind_executor(cpu_pool, asio::deferred));
+//     auto digest = hash(body);            // Runs on one of the pool's threads
+//     co_await asio::post(asio::deferred);  // Back on the coroutine's executor (the io_context)
+//
+// Binding the completion token to the pool is what makes the coroutine resume there: without it,
+// post runs an empty task on the pool and the coroutine resumes on its own executor right away.
+// While on the pool, the coroutine must not touch the io_context's sockets and timers.
+//
+// Each worker thread has its own Chase-Lev deque. Tasks submitted from a worker go to the bottom
+// of its deque, and the worker takes them back from the bottom (LIFO, while they're still in its cache),
+// without locks. Idle workers steal from the top of other workers' deques (FIFO, the oldest tasks).
+// Tasks submitted from other threads go to a shared queue protected by a mutex, like in
+// asio::thread_pool, where all tasks do. Workers sleep on a condition variable when there is no work.
+//
+// Like asio::thread_pool, join() waits until there is no outstanding work: submitted tasks
+// that haven't finished, and executors with outstanding_work.tracked (e.g. make_work_guard(cpu_pool)).
+
+namespace detail {
+
+// A type-erased task. Allocated when submitted, and deallocated before running it,
+// so it can submit new tasks without holding its own memory
+struct ws_task
+{
+    ws_task* next{nullptr};  // For the shared queue
+    void (*complete)(ws_task*, bool invoke);
+};
+
+template <class Function>
+struct ws_task_impl final : ws_task
+{
+    Function fn;
+
+    explicit ws_task_impl(Function&& f) : ws_task{nullptr, &do_complete}, fn(std::move(f)) {}
+
+    static void do_complete(ws_task* base, bool invoke)
+    {
+        auto* self = static_cast<ws_task_impl*>(base);
+        Function fn(std::move(self->fn));
+        delete self;
+        if (invoke)
+            std::move(fn)();
+    }
+};
+
+// Chase-Lev work-stealing deque, with the memory orderings from "Correct and Efficient Work-Stealing
+// for Weak Memory Models" (Lê et al., 2013). push and pop may only be called by the owner thread,
+// steal by any thread. Grows when full; old buffers are kept until destruction,
+// since thieves may still be reading from them
+class chase_lev_deque
+{
+    struct ring
+    {
+        std::int64_t capacity;
+        std::unique_ptr<std::atomic<ws_task*>[]> slots;
+
+        explicit ring(std::int64_t cap) : capacity(cap), slots(new std::atomic<ws_task*>[cap]) {}
+
+        ws_task* get(std::int64_t i) const noexcept
+        {
+            return slots[i & (capacity - 1)].load(std::memory_order_relaxed);
+        }
+        void put(std::int64_t i, ws_task* task) noexcept
+        {
+            slots[i & (capacity - 1)].store(task, std::memory_order_relaxed);
+        }
+    };
+
+    alignas(64) std::atomic<std::int64_t> top_{0};
+    alignas(64) std::atomic<std::int64_t> bottom_{0};
+    std::atomic<ring*> ring_;
+    std::vector<std::unique_ptr<ring>> rings_;  // Only accessed by the owner
+
+    ring* grow(ring* old, std::int64_t top, std::int64_t bottom)
+    {
+        auto bigger = std::make_unique<ring>(old->capacity * 2);
+        for (std::int64_t i = top; i < bottom; ++i)
+            bigger->put(i, old->get(i));
+        rings_.push_back(std::move(bigger));
+        return rings_.back().get();
+    }
+
+public:
+    explicit chase_lev_deque(std::int64_t capacity = 256)
+    {
+        rings_.push_back(std::make_unique<ring>(capacity));
+        ring_.store(rings_.back().get(), std::memory_order_relaxed);
+    }
+
+    chase_lev_deque(const chase_lev_deque&) = delete;
+    chase_lev_deque& operator=(const chase_lev_deque&) = delete;
+
+    void push(ws_task* task)
+    {
+        std::int64_t b = bottom_.load(std::memory_order_relaxed);
+        std::int64_t t = top_.load(std::memory_order_acquire);
+        ring* r = ring_.load(std::memory_order_relaxed);
+        if (b - t > r->capacity - 1)
+        {
+            r = grow(r, t, b);
+            ring_.store(r, std::memory_order_release);
+        }
+        r->put(b, task);
+        bottom_.store(b + 1, std::memory_order_release);
+    }
+
+    ws_task* pop() noexcept
+    {
+        std::int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+        ring* r = ring_.load(std::memory_order_relaxed);
+        bottom_.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t t = top_.load(std::memory_order_relaxed);
+        if (t > b)
+        {
+            // Empty
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        ws_task* task = r->get(b);
+        if (t == b)
+        {
+            // The last task: race against thieves for it
+            if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                task = nullptr;
+            bottom_.store(b + 1, std::memory_order_relaxed);
+        }
+        return task;
+    }
+
+    // Returns nullptr if the deque is empty, or if another thread took the task first
+    ws_task* steal() noexcept
+    {
+        std::int64_t t = top_.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        std::int64_t b = bottom_.load(std::memory_order_acquire);
+        if (t >= b)
+            return nullptr;
+        ws_task* task = ring_.load(std::memory_order_acquire)->get(t);
+        if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+        return task;
+    }
+
+    bool empty() const noexcept
+    {
+        return bottom_.load(std::memory_order_relaxed) <= top_.load(std::memory_order_relaxed);
+    }
+};
+
+}  // namespace detail
+
+class work_stealing_pool : public boost::asio::execution_context
+{
+    struct alignas(64) worker
+    {
+        work_stealing_pool* pool;
+        detail::chase_lev_deque deque;
+        std::uint64_t rng;  // xorshift state, to pick victims
+        std::thread thread;
+    };
+
+    // Failed attempts to find work before a worker goes to sleep
+    static constexpr int spin_limit = 64;
+
+    std::vector<std::unique_ptr<worker>> workers_;
+
+    // The shared queue, for tasks submitted from outside the pool. mutex_ also protects sleeping
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    detail::ws_task* injected_head_{nullptr};
+    detail::ws_task* injected_tail_{nullptr};
+    std::atomic<std::size_t> injected_size_{0};  // Read without the lock, to skip taking it when empty
+
+    std::atomic<std::size_t> sleepers_{0};
+    std::atomic<std::size_t> outstanding_work_{0};
+    std::atomic<bool> joining_{false};
+    std::atomic<bool> stopped_{false};
+
+    static inline thread_local worker* current_worker_ = nullptr;
+
+    worker* this_thread_worker() const noexcept
+    {
+        return current_worker_ && current_worker_->pool == this ? current_worker_ : nullptr;
+    }
+
+    void work_started() noexcept { outstanding_work_.fetch_add(1, std::memory_order_relaxed); }
+
+    void work_finished() noexcept
+    {
+        if (outstanding_work_.fetch_sub(1, std::memory_order_acq_rel) == 1 && joining_.load())
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cv_.notify_all();
+        }
+    }
+
+    void submit(detail::ws_task* task)
+    {
+        work_started();
+        if (worker* w = this_thread_worker())
+        {
+            w->deque.push(task);
+
+            // Pairs with the fence in wait_for_work: either a sleeping worker sees the task,
+            // or we see it sleeping and wake it up
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (sleepers_.load(std::memory_order_relaxed) > 0)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                cv_.notify_one();
+            }
+        }
+        else
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (injected_tail_)
+                injected_tail_->next = task;
+            else
+                injected_head_ = task;
+            injected_tail_ = task;
+            injected_size_.fetch_add(1, std::memory_order_relaxed);
+            if (sleepers_.load(std::memory_order_relaxed) > 0)
+                cv_.notify_one();
+        }
+    }
+
+    detail::ws_task* pop_injected() noexcept
+    {
+        detail::ws_task* task = injected_head_;
+        if (task)
+        {
+            injected_head_ = task->next;
+            if (!injected_head_)
+                injected_tail_ = nullptr;
+            task->next = nullptr;
+            injected_size_.fetch_sub(1, std::memory_order_relaxed);
+        }
+        return task;
+    }
+
+    detail::ws_task* find_task(worker& self)
+    {
+        if (detail::ws_task* task = self.deque.pop())
+            return task;
+
+        if (injected_size_.load(std::memory_order_relaxed) > 0)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (detail::ws_task* task = pop_injected())
+                return task;
+        }
+
+        // Try every other worker once, starting at a random one
+        self.rng ^= self.rng << 13;
+        self.rng ^= self.rng >> 7;
+        self.rng ^= self.rng << 17;
+        std::size_t n = workers_.size();
+        std::size_t first = static_cast<std::size_t>(self.rng % n);
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            worker& victim = *workers_[(first + i) % n];
+            if (&victim == &self)
+                continue;
+            if (detail::ws_task* task = victim.deque.steal())
+                return task;
+        }
+        return nullptr;
+    }
+
+    bool should_exit() const noexcept
+    {
+        return stopped_.load() || (joining_.load() && outstanding_work_.load() == 0);
+    }
+
+    bool has_visible_work() const noexcept
+    {
+        return injected_head_ || std::any_of(workers_.begin(), workers_.end(), [](const auto& w) {
+                   return !w->deque.empty();
+               });
+    }
+
+    // Sleeps until there may be work. Returns false if the worker should exit
+    bool wait_for_work()
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        sleepers_.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        while (!should_exit() && !has_visible_work())
+            cv_.wait(lock);
+        sleepers_.fetch_sub(1);
+        return !should_exit();
+    }
+
+    void run_worker(worker& self)
+    {
+        current_worker_ = &self;
+        int spins = 0;
+        while (!stopped_.load(std::memory_order_relaxed))
+        {
+            if (detail::ws_task* task = find_task(self))
+            {
+                task->complete(task, true);
+                work_finished();
+                spins = 0;
+            }
+            else if (++spins < spin_limit)
+            {
+                std::this_thread::yield();
+            }
+            else
+            {
+                spins = 0;
+                if (!wait_for_work())
+                    break;
+            }
+        }
+        current_worker_ = nullptr;
+    }
+
+    void destroy_pending_tasks()
+    {
+        std::vector<detail::ws_task*> tasks;
+        for (auto& w : workers_)
+        {
+            while (detail::ws_task* task = w->deque.steal())
+                tasks.push_back(task);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            while (detail::ws_task* task = pop_injected())
+                tasks.push_back(task);
+        }
+
+        // Destroying a task may release tracked executors, so this must happen outside the lock
+        for (detail::ws_task* task : tasks)
+        {
+            task->complete(task, false);
+            work_finished();
+        }
+    }
+
+public:
+    class executor_type;
+
+    // Launches the worker threads
+    explicit work_stealing_pool(std::size_t num_threads = std::max(1u, std::thread::hardware_concurrency()))
+    {
+        num_threads = std::max<std::size_t>(num_threads, 1u);
+        workers_.reserve(num_threads);
+        for (std::size_t i = 0; i < num_threads; ++i)
+        {
+            auto w = std::make_unique<worker>();
+            w->pool = this;
+            w->rng = 0x9e3779b97f4a7c15ull * (i + 1);
+            workers_.push_back(std::move(w));
+        }
+        for (auto& w : workers_)
+            w->thread = std::thread([this, &self = *w] { run_worker(self); });
+    }
+
+    work_stealing_pool(const work_stealing_pool&) = delete;
+    work_stealing_pool& operator=(const work_stealing_pool&) = delete;
+
+    // Abandons outstanding work, like asio::thread_pool
+    ~work_stealing_pool()
+    {
+        stop();
+        join();
+        destroy_pending_tasks();
+        shutdown();
+    }
+
+    std::size_t size() const noexcept { return workers_.size(); }
+
+    executor_type get_executor() noexcept;
+
+    // Waits for the threads to exit. Unless stop() is called, that happens once there is
+    // no outstanding work. Must not be called from one of the pool's threads
+    void join()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            joining_.store(true);
+        }
+        cv_.notify_all();
+        for (auto& w : workers_)
+        {
+            if (w->thread.joinable())
+                w->thread.join();
+        }
+    }
+
+    // Makes the threads exit as soon as they finish their current task, abandoning the rest
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopped_.store(true);
+        }
+        cv_.notify_all();
+    }
+};
+
+// Executors are cheap to copy: a pointer to the pool and the requested properties.
+// With blocking.possibly (the default), execute() runs the function inline if called
+// from one of the pool's threads; with blocking.never (used by asio::post), it always submits a task
+class work_stealing_pool::executor_type
+{
+    friend class work_stealing_pool;
+
+    static constexpr unsigned blocking_never = 1;
+    static constexpr unsigned outstanding_work_tracked = 2;
+
+    work_stealing_pool* pool_;
+    unsigned bits_;
+
+    executor_type(work_stealing_pool& pool, unsigned bits) noexcept : pool_(&pool), bits_(bits)
+    {
+        if (bits_ & outstanding_work_tracked)
+            pool_->work_started();
+    }
+
+    executor_type with_bits(unsigned bits) const noexcept { return executor_type(*pool_, bits); }
+
+public:
+    executor_type(const executor_type& rhs) noexcept : executor_type(*rhs.pool_, rhs.bits_) {}
+    executor_type(executor_type&& rhs) noexcept : pool_(rhs.pool_), bits_(std::exchange(rhs.bits_, 0)) {}
+    executor_type& operator=(const executor_type& rhs) noexcept
+    {
+        if (this != &rhs)
+            *this = executor_type(rhs);
+        return *this;
+    }
+    executor_type& operator=(executor_type&& rhs) noexcept
+    {
+        if (this != &rhs)
+        {
+            if (bits_ & outstanding_work_tracked)
+                pool_->work_finished();
+            pool_ = rhs.pool_;
+            bits_ = std::exchange(rhs.bits_, 0);
+        }
+        return *this;
+    }
+    ~executor_type()
+    {
+        if (bits_ & outstanding_work_tracked)
+            pool_->work_finished();
+    }
+
+    executor_type require(boost::asio::execution::blocking_t::never_t) const noexcept
+    {
+        return with_bits(bits_ | blocking_never);
+    }
+    executor_type require(boost::asio::execution::blocking_t::possibly_t) const noexcept
+    {
+        return with_bits(bits_ & ~blocking_never);
+    }
+    executor_type require(boost::asio::execution::outstanding_work_t::tracked_t) const noexcept
+    {
+        return with_bits(bits_ | outstanding_work_tracked);
+    }
+    executor_type require(boost::asio::execution::outstanding_work_t::untracked_t) const noexcept
+    {
+        return with_bits(bits_ & ~outstanding_work_tracked);
+    }
+
+    static constexpr boost::asio::execution::mapping_t query(boost::asio::execution::mapping_t) noexcept
+    {
+        return boost::asio::execution::mapping.thread;
+    }
+    work_stealing_pool& query(boost::asio::execution::context_t) const noexcept { return *pool_; }
+    boost::asio::execution::blocking_t query(boost::asio::execution::blocking_t) const noexcept
+    {
+        if (bits_ & blocking_never)
+            return boost::asio::execution::blocking.never;
+        return boost::asio::execution::blocking.possibly;
+    }
+    boost::asio::execution::outstanding_work_t query(
+        boost::asio::execution::outstanding_work_t
+    ) const noexcept
+    {
+        if (bits_ & outstanding_work_tracked)
+            return boost::asio::execution::outstanding_work.tracked;
+        return boost::asio::execution::outstanding_work.untracked;
+    }
+
+    // Whether the calling thread is one of the pool's
+    bool running_in_this_thread() const noexcept { return pool_->this_thread_worker() != nullptr; }
+
+    template <class Function>
+    void execute(Function&& f) const
+    {
+        using function_type = std::decay_t<Function>;
+        if (!(bits_ & blocking_never) && running_in_this_thread())
+        {
+            function_type fn(std::forward<Function>(f));
+            std::move(fn)();
+            return;
+        }
+        pool_->submit(new detail::ws_task_impl<function_type>(function_type(std::forward<Function>(f))));
+    }
+
+    friend bool operator==(const executor_type& lhs, const executor_type& rhs) noexcept
+    {
+        return lhs.pool_ == rhs.pool_ && lhs.bits_ == rhs.bits_;
+    }
+    friend bool operator!=(const executor_type& lhs, const executor_type& rhs) noexcept
+    {
+        return !(lhs == rhs);
+    }
+};
+
+inline work_stealing_pool::executor_type work_stealing_pool::get_executor() noexcept
+{
+    return executor_type(*this, 0);
+}
+
+#endif
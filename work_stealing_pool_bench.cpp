@@ -0,0 +1,328 @@
+#include <boost/asio/awaitable.hpp>
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/co_spawn.hpp>
+#include <boost/asio/deferred.hpp>
+#include <boost/asio/detached.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/redirect_error.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/this_coro.hpp>
+#include <boost/asio/thread_pool.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/crc.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <iostream>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "latency_histogram.hpp"
+#include "work_stealing_pool.hpp"
+
+// Compares work_stealing_pool with asio::thread_pool.
+//
+// Throughput of fine-grained tasks, in millions of tasks per second:
+//   - tree: each task posts two more, down to --depth levels. Tasks are posted from the pool's threads,
+//     so work_stealing_pool pushes them to the worker's own deque, and asio::thread_pool to its shared queue.
+//   - external: the main thread posts --tasks tasks, which go to the shared queue in both pools.
+//
+// Latency of I/O on an io_context while CPU work runs: a coroutine on the io_context sends a small
+// message every millisecond to an echo server running in another thread, and records the round-trip time.
+// Meanwhile, --jobs coroutines on the same io_context compute the CRC-32 of a --body-size body
+// in a loop, like a client checking the bodies it downloads: either on the io_context thread,
+// or hopping onto a pool to compute it and back. Reports bodies per second and the round-trip times.
+// Usage: work_stealing_pool_bench [options]
+//   --threads <n>          Threads in each pool (default: number of cores)
+//   --depth <n>            Depth of the tree of tasks (default: 20, about 2M tasks)
+//   --tasks <n>            Tasks posted from outside the pool (default: 1000000)
+//   --jobs <n>             CPU jobs in flight in the latency benchmark (default: twice --threads)
+//   --body-size <n>        Bytes hashed by each job (default: 262144)
+//   --seconds <n>          Duration of each latency benchmark (default: 3)
+
+namespace asio = boost::asio;
+using boost::system::error_code;
+using asio::ip::tcp;
+
+struct bench_config
+{
+    std::size_t threads{std::max(1u, std::thread::hardware_concurrency())};
+    int depth{20};
+    std::size_t tasks{1000000};
+    std::size_t jobs{0};
+    std::size_t body_size{256 * 1024};
+    int seconds{3};
+};
+
+// Completed tasks. Each thread increments its own counter, so counting doesn't make threads contend
+// for a single cache line, which would hide the difference between the pools
+struct alignas(64) task_counter
+{
+    std::atomic<std::uint64_t> value{0};
+};
+
+static std::array<task_counter, 64> completed_tasks;
+static std::atomic<std::size_t> next_counter{0};
+
+static void count_task()
+{
+    thread_local std::size_t index = next_counter.fetch_add(1) % completed_tasks.size();
+    completed_tasks[index].value.fetch_add(1, std::memory_order_relaxed);
+}
+
+static std::uint64_t take_completed_tasks()
+{
+    std::uint64_t res = 0;
+    for (auto& counter : completed_tasks)
+        res += counter.value.exchange(0);
+    return res;
+}
+
+template <class Executor>
+struct tree_task
+{
+    Executor ex;
+    int depth;
+
+    void operator()() const
+    {
+        if (depth > 0)
+        {
+            asio::post(ex, tree_task{ex, depth - 1});
+            asio::post(ex, tree_task{ex, depth - 1});
+        }
+        count_task();
+    }
+};
+
+// Runs the tasks posted by post_tasks until the pool runs out of work. Returns millions of tasks per second
+template <class Pool, class PostTasks>
+static double run_throughput(std::size_t threads, std::uint64_t expected_tasks, PostTasks post_tasks)
+{
+    Pool pool(threads);
+    auto start = std::chrono::steady_clock::now();
+    post_tasks(pool);
+    pool.join();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+    std::uint64_t tasks = take_completed_tasks();
+    if (tasks != expected_tasks)
+    {
+        std::cerr << "Expected " << expected_tasks << " tasks, but " << tasks << " ran" << std::endl;
+        std::exit(EXIT_FAILURE);
+    }
+    return tasks / elapsed.count() / 1e6;
+}
+
+template <class Pool>
+static void run_throughput_benchmarks(std::string_view name, const bench_config& cfg)
+{
+    std::uint64_t tree_tasks = (std::uint64_t(1) << (cfg.depth + 1)) - 1;
+    double tree = run_throughput<Pool>(cfg.threads, tree_tasks, [&](Pool& pool) {
+        asio::post(pool, tree_task<typename Pool::executor_type>{pool.get_executor(), cfg.depth});
+    });
+    double external = run_throughput<Pool>(cfg.threads, cfg.tasks, [&](Pool& pool) {
+        for (std::size_t i = 0; i < cfg.tasks; ++i)
+            asio::post(pool, count_task);
+    });
+    std::cout << "  " << name << ": tree " << tree << "M tasks/s, external " << external << "M tasks/s"
+              << std::endl;
+}
+
+// Echoes 64 byte messages, on its own thread
+class echo_server
+{
+    asio::io_context ctx_{1};
+    tcp::acceptor acceptor_{ctx_, tcp::endpoint(asio::ip::address_v4::loopback(), 0)};
+    std::thread thread_;
+
+    static asio::awaitable<void> echo(tcp::socket sock)
+    {
+        std::array<char, 64> buff;
+        error_code ec;
+        auto tok = asio::redirect_error(asio::deferred, ec);
+        while (!ec)
+        {
+            co_await asio::async_read(sock, asio::buffer(buff), tok);
+            if (!ec)
+                co_await asio::async_write(sock, asio::buffer(buff), tok);
+        }
+    }
+
+    asio::awaitable<void> serve()
+    {
+        while (true)
+        {
+            tcp::socket sock = co_await acceptor_.async_accept(asio::deferred);
+            sock.set_option(tcp::no_delay(true));
+            asio::co_spawn(ctx_, echo(std::move(sock)), asio::detached);
+        }
+    }
+
+public:
+    echo_server()
+    {
+        asio::co_spawn(ctx_, serve(), asio::detached);
+        thread_ = std::thread([this] { ctx_.run(); });
+    }
+
+    ~echo_server()
+    {
+        ctx_.stop();
+        thread_.join();
+    }
+
+    tcp::endpoint endpoint() const { return acceptor_.local_endpoint(); }
+};
+
+static asio::awaitable<void> measure_echo(
+    tcp::endpoint server,
+    std::chrono::steady_clock::time_point deadline,
+    latency_histogram& hist
+)
+{
+    auto ex = co_await asio::this_coro::executor;
+    tcp::socket sock(ex);
+    co_await sock.async_connect(server, asio::deferred);
+    sock.set_option(tcp::no_delay(true));
+    asio::steady_timer timer(ex);
+    std::array<char, 64> buff{};
+
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        timer.expires_after(std::chrono::milliseconds(1));
+        co_await timer.async_wait(asio::deferred);
+        auto start = std::chrono::steady_clock::now();
+        co_await asio::async_write(sock, asio::buffer(buff), asio::deferred);
+        co_await asio::async_read(sock, asio::buffer(buff), asio::deferred);
+        hist.record(std::chrono::steady_clock::now() - start);
+    }
+}
+
+// No pool: CPU work runs on the io_context thread
+struct no_pool
+{
+    explicit no_pool(std::size_t) {}
+};
+
+template <class Pool>
+static asio::awaitable<void> process_bodies(
+    Pool& pool,
+    std::size_t body_size,
+    std::chrono::steady_clock::time_point deadline,
+    std::uint64_t& bodies
+)
+{
+    std::vector<unsigned char> body(body_size);
+    for (std::size_t i = 0; i < body.size(); ++i)
+        body[i] = static_cast<unsigned char>(i * 31);
+    std::uint32_t checksum = 0;
+
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        // Stands for reading the body from a socket
+        co_await asio::post(asio::deferred);
+
+        if constexpr (!std::is_same_v<Pool, no_pool>)
+            co_await asio::post(pool, asio::bind_executor(pool, asio::deferred));
+        boost::crc_32_type crc;
+        crc.process_bytes(body.data(), body.size());
+        checksum ^= crc.checksum();
+        if constexpr (!std::is_same_v<Pool, no_pool>)
+            co_await asio::post(asio::deferred);
+
+        ++bodies;
+    }
+
+    // So the compiler can't skip computing the checksum
+    if (checksum == 0x12345678)
+        std::cout << "";
+}
+
+template <class Pool>
+static void run_latency(
+    std::string_view name,
+    const bench_config& cfg,
+    tcp::endpoint server,
+    std::size_t jobs
+)
+{
+    Pool pool(cfg.threads);
+    asio::io_context ctx{1};
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(cfg.seconds);
+    latency_histogram hist;
+    std::uint64_t bodies = 0;
+
+    auto on_done = [](std::exception_ptr exc) {
+        if (exc)
+            std::rethrow_exception(exc);
+    };
+    asio::co_spawn(ctx, measure_echo(server, deadline, hist), on_done);
+    for (std::size_t i = 0; i < jobs; ++i)
+        asio::co_spawn(ctx, process_bodies(pool, cfg.body_size, deadline, bodies), on_done);
+    ctx.run();
+
+    std::cout << "  " << name << ": " << static_cast<std::uint64_t>(bodies / static_cast<double>(cfg.seconds))
+              << " bodies/s, round trip " << hist << std::endl;
+}
+
+static void usage(const char* program)
+{
+    std::cerr << "Usage: " << program << " [--threads <n>] [--depth <n>] [--tasks <n>] [--jobs <n>]"
+              << " [--body-size <n>] [--seconds <n>]\n";
+    std::exit(1);
+}
+
+int main(int argc, char** argv)
+{
+    bench_config cfg;
+    for (int i = 1; i < argc; i += 2)
+    {
+        if (i + 1 >= argc)
+            usage(argv[0]);
+        std::string_view opt = argv[i];
+        const char* value = argv[i + 1];
+        if (opt == "--threads")
+            cfg.threads = std::max<std::size_t>(std::stoul(value), 1u);
+        else if (opt == "--depth")
+            cfg.depth = std::clamp(std::stoi(value), 0, 30);
+        else if (opt == "--tasks")
+            cfg.tasks = std::stoul(value);
+        else if (opt == "--jobs")
+            cfg.jobs = std::stoul(value);
+        else if (opt == "--body-size")
+            cfg.body_size = std::stoul(value);
+        else if (opt == "--seconds")
+            cfg.seconds = std::max(std::stoi(value), 1);
+        else
+            usage(argv[0]);
+    }
+    if (cfg.jobs == 0)
+        cfg.jobs = 2 * cfg.threads;
+
+    std::cout << "Fine-grained tasks, " << cfg.threads << " threads:\n";
+    run_throughput_benchmarks<asio::thread_pool>("asio::thread_pool ", cfg);
+    run_throughput_benchmarks<work_stealing_pool>("work_stealing_pool", cfg);
+
+    echo_server server;
+    std::cout << "Round trips on the io_context, " << cfg.jobs << " CPU jobs of " << cfg.body_size
+              << " bytes:\n";
+    run_latency<no_pool>("no CPU work       ", cfg, server.endpoint(), 0);
+    run_latency<no_pool>("on the io_context ", cfg, server.endpoint(), cfg.jobs);
+    run_latency<asio::thread_pool>("asio::thread_pool ", cfg, server.endpoint(), cfg.jobs);
+    run_latency<work_stealing_pool>("work_stealing_pool", cfg, server.endpoint(), cfg.jobs);
+}